@@ -1,5 +1,28 @@
 #include <fstream>
 #include <iostream>
+#include <deque>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <new>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <cxxabi.h>
+#include <dirent.h>
+#include <typeinfo>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
@@ -26,6 +49,259 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Experiment");
 
+/**
+ * \brief Monotonic wall-clock time, for benchmarks and profiling
+ * \return seconds since an arbitrary fixed point
+ */
+static double
+WallClockSeconds ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * \brief Current resident set size of the process, for profiling
+ * \return the resident set size in kB, 0 if unknown
+ */
+static uint64_t
+ResidentSetKb ()
+{
+  std::ifstream statm ("/proc/self/statm");
+  uint64_t pages;
+  if (statm >> pages >> pages)
+    {
+      return pages * (sysconf (_SC_PAGESIZE) / 1024);
+    }
+  return 0;
+}
+
+/**
+ * Heap accounting through a replaced global operator new/delete.  Every
+ * allocation is counted, for the allocation benchmark.  While a memory
+ * report is started, the blocks allocated minus the blocks freed are also
+ * tallied per power-of-two size class; that takes a malloc_usable_size
+ * call per allocation and free, so it is off otherwise.
+ */
+static uint64_t g_heapAllocations = 0;
+static bool g_heapAccounting = false;
+static int64_t g_heapLiveCount[64];
+static int64_t g_heapLiveBytes[64];
+
+/**
+ * \brief Returns the size class of a heap block
+ * \param size the usable size of the block
+ * \return the class c, holding the blocks of 2^(c-1) < size <= 2^c bytes
+ */
+static inline uint32_t
+HeapSizeClass (size_t size)
+{
+  return size <= 1 ? 0 : 64 - __builtin_clzll ((unsigned long long) size - 1);
+}
+
+void *
+operator new (std::size_t size)
+{
+  g_heapAllocations++;
+  void *p = std::malloc (size != 0 ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  if (g_heapAccounting)
+    {
+      size_t usable = malloc_usable_size (p);
+      uint32_t c = HeapSizeClass (usable);
+      g_heapLiveCount[c]++;
+      g_heapLiveBytes[c] += usable;
+    }
+  return p;
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return operator new (size);
+}
+
+void
+operator delete (void *p) noexcept
+{
+  if (p == 0)
+    {
+      return;
+    }
+  if (g_heapAccounting)
+    {
+      size_t usable = malloc_usable_size (p);
+      uint32_t c = HeapSizeClass (usable);
+      g_heapLiveCount[c]--;
+      g_heapLiveBytes[c] -= usable;
+    }
+  std::free (p);
+}
+
+void
+operator delete[] (void *p) noexcept
+{
+  operator delete (p);
+}
+
+/**
+ * Fixed-memory quantile sketch of non-negative integer samples (e.g. delays
+ * in nanoseconds), in the style of an HDR histogram: values below 128 have
+ * a bucket each, larger values fall into 64 linear sub-buckets per power of
+ * two.  Quantiles are therefore within 1/64 (~1.6%) of the exact value
+ * whatever the range, and the 3776 buckets cover all of uint64_t, so memory
+ * does not depend on the number or the magnitude of the samples.
+ */
+class QuantileSketch
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  QuantileSketch ();
+
+  /**
+   * \brief Records one sample
+   * \param value the sample
+   * \return none
+   */
+  void Add (uint64_t value);
+
+  /**
+   * \brief Returns the number of samples
+   * \return the number of samples
+   */
+  uint64_t GetCount () const;
+
+  /**
+   * \brief Returns an estimate of a quantile
+   * \param q the quantile, in [0, 1]
+   * \return the estimate, or 0 if there are no samples
+   */
+  uint64_t GetQuantile (double q) const;
+
+  uint64_t GetMin () const;
+
+  uint64_t GetMax () const;
+
+  void Reset ();
+
+private:
+  static uint32_t GetIndex (uint64_t value);
+
+  static const uint32_t SUB_BUCKET_BITS = 6;
+  static const uint32_t N_BUCKETS = (64 - SUB_BUCKET_BITS) * (1 << SUB_BUCKET_BITS) + (1 << SUB_BUCKET_BITS);
+
+  std::vector<uint64_t> m_counts;
+  uint64_t m_count;
+  uint64_t m_min;
+  uint64_t m_max;
+};
+
+QuantileSketch::QuantileSketch ()
+  : m_counts (N_BUCKETS, 0),
+    m_count (0),
+    m_min (0),
+    m_max (0)
+{
+}
+
+uint32_t
+QuantileSketch::GetIndex (uint64_t value)
+{
+  if (value < (2 << SUB_BUCKET_BITS))
+    {
+      return value;
+    }
+  // value >> shift keeps the SUB_BUCKET_BITS + 1 leading bits, in [64, 128)
+  uint32_t shift = 63 - __builtin_clzll (value) - SUB_BUCKET_BITS;
+  return (shift << SUB_BUCKET_BITS) + (value >> shift);
+}
+
+void
+QuantileSketch::Add (uint64_t value)
+{
+  m_counts[GetIndex (value)]++;
+  if (m_count == 0 || value < m_min)
+    {
+      m_min = value;
+    }
+  if (value > m_max)
+    {
+      m_max = value;
+    }
+  m_count++;
+}
+
+uint64_t
+QuantileSketch::GetCount () const
+{
+  return m_count;
+}
+
+uint64_t
+QuantileSketch::GetQuantile (double q) const
+{
+  if (m_count == 0)
+    {
+      return 0;
+    }
+  uint64_t rank = (uint64_t) std::ceil (std::min (std::max (q, 0.0), 1.0) * m_count);
+  if (rank <= 1)
+    {
+      return m_min;
+    }
+  if (rank >= m_count)
+    {
+      return m_max;
+    }
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < N_BUCKETS; i++)
+    {
+      seen += m_counts[i];
+      if (seen >= rank)
+        {
+          uint64_t lower = i;
+          uint64_t width = 1;
+          if (i >= (2u << SUB_BUCKET_BITS))
+            {
+              uint32_t shift = (i >> SUB_BUCKET_BITS) - 1;
+              lower = (uint64_t) ((i & ((1 << SUB_BUCKET_BITS) - 1)) + (1 << SUB_BUCKET_BITS)) << shift;
+              width = (uint64_t) 1 << shift;
+            }
+          uint64_t estimate = lower + (width - 1) / 2;
+          return std::min (std::max (estimate, m_min), m_max);
+        }
+    }
+  return m_max;
+}
+
+uint64_t
+QuantileSketch::GetMin () const
+{
+  return m_min;
+}
+
+uint64_t
+QuantileSketch::GetMax () const
+{
+  return m_max;
+}
+
+void
+QuantileSketch::Reset ()
+{
+  std::fill (m_counts.begin (), m_counts.end (), 0);
+  m_count = 0;
+  m_min = 0;
+  m_max = 0;
+}
+
 class RoutingStats
 {
 public:
@@ -39,25 +315,25 @@ public:
    * \brief Returns the number of bytes received
    * \return the number of bytes received
    */
-  uint32_t GetRxBytes ();
+  uint64_t GetRxBytes ();
 
   /**
    * \brief Returns the cumulative number of bytes received
    * \return the cumulative number of bytes received
    */
-  uint32_t GetCumulativeRxBytes ();
+  uint64_t GetCumulativeRxBytes ();
 
   /**
    * \brief Returns the count of packets received
    * \return the count of packets received
    */
-  uint32_t GetRxPkts ();
+  uint64_t GetRxPkts ();
 
   /**
    * \brief Returns the cumulative count of packets received
    * \return the cumulative count of packets received
    */
-  uint32_t GetCumulativeRxPkts ();
+  uint64_t GetCumulativeRxPkts ();
 
   /**
    * \brief Increments the number of (application-data)
@@ -78,14 +354,14 @@ public:
    * \param rxBytes the number of bytes received
    * \return none
    */
-  void SetRxBytes (uint32_t rxBytes);
+  void SetRxBytes (uint64_t rxBytes);
 
   /**
    * \brief Sets the number of packets received
    * \param rxPkts the number of packets received
    * \return none
    */
-  void SetRxPkts (uint32_t rxPkts);
+  void SetRxPkts (uint64_t rxPkts);
 
 
   Time GetFirstTxTime();
@@ -102,26 +378,26 @@ public:
    * \brief Returns the number of bytes transmitted
    * \return the number of bytes transmitted
    */
-  uint32_t GetTxBytes ();
+  uint64_t GetTxBytes ();
 
   /**
    * \brief Returns the cumulative number of bytes transmitted
    * \param socket the receiving socket
    * \return none
    */
-  uint32_t GetCumulativeTxBytes ();
+  uint64_t GetCumulativeTxBytes ();
 
   /**
    * \brief Returns the number of packets transmitted
    * \return the number of packets transmitted
    */
-  uint32_t GetTxPkts ();
+  uint64_t GetTxPkts ();
 
   /**
    * \brief Returns the cumulative number of packets transmitted
    * \return the cumulative number of packets transmitted
    */
-  uint32_t GetCumulativeTxPkts ();
+  uint64_t GetCumulativeTxPkts ();
 
   /**
    * \brief Increment the number of bytes transmitted
@@ -141,14 +417,14 @@ public:
    * \param txBytes the number of bytes transmitted
    * \return none
    */
-  void SetTxBytes (uint32_t txBytes);
+  void SetTxBytes (uint64_t txBytes);
 
   /**
    * \brief Sets the number of packets transmitted
    * \param txPkts the number of packets transmitted
    * \return none
    */
-  void SetTxPkts (uint32_t txPkts);
+  void SetTxPkts (uint64_t txPkts);
 
   /*
     Getter  and setter for delay
@@ -162,17 +438,102 @@ public:
 
   void IncDelaySum(double delay);
 
+  /**
+   * \brief Records the delay, jitter and sequence number of a received
+   * packet.  Jitter is the change in delay from the previous packet of the
+   * same source; a sequence number above the next expected one counts the
+   * skipped numbers as a gap, one below it counts as a reordered packet.
+   * \param source the sender (e.g. its IPv4 address)
+   * \param seq the SeqTsHeader sequence number
+   * \param delay the one-way delay
+   * \return none
+   */
+  void RecordReception (uint32_t source, uint32_t seq, Time delay);
+
+  /**
+   * \brief Returns the one-way delay distribution, in nanoseconds
+   * \return the delay sketch
+   */
+  const QuantileSketch & GetDelaySketch () const;
+
+  /**
+   * \brief Returns the jitter distribution, in nanoseconds
+   * \return the jitter sketch
+   */
+  const QuantileSketch & GetJitterSketch () const;
+
+  /**
+   * \brief Returns the number of sequence numbers skipped by receptions
+   * \return the number of missing sequence numbers
+   */
+  uint64_t GetSeqGaps () const;
+
+  /**
+   * \brief Returns the number of packets received after a later one of
+   * the same source
+   * \return the number of reordered packets
+   */
+  uint64_t GetReordered () const;
+
+  /**
+   * \brief Counts a routing control packet sent (or forwarded) by a node
+   * \param bytes the size of the packet, IP header included
+   * \return none
+   */
+  void IncControlTx (uint32_t bytes);
+
+  /**
+   * \brief Returns the number of routing control packets sent
+   * \return the number of control packets
+   */
+  uint64_t GetControlTxPkts () const;
+
+  /**
+   * \brief Returns the number of routing control bytes sent
+   * \return the number of control bytes, IP headers included
+   */
+  uint64_t GetControlTxBytes () const;
+
+  /**
+   * \brief Records the number of hops a received data packet took
+   * \param hops the hop count, 1 for a direct neighbour
+   * \return none
+   */
+  void RecordHops (uint32_t hops);
+
+  /**
+   * \brief Returns the average hop count of the received data packets
+   * \return the average hop count, 0 if the hop counts are unknown
+   */
+  double GetAverageHops () const;
+
 private:
-  uint32_t m_RxBytes;
-  uint32_t m_cumulativeRxBytes;
-  uint32_t m_RxPkts;
-  uint32_t m_cumulativeRxPkts;
-  uint32_t m_TxBytes;
-  uint32_t m_cumulativeTxBytes;
-  uint32_t m_TxPkts;
-  uint32_t m_cumulativeTxPkts;
+  struct SourceState
+  {
+    uint32_t nextSeq;
+    int64_t lastDelay; // nanoseconds
+  };
+
+  uint64_t m_RxBytes;
+  uint64_t m_cumulativeRxBytes;
+  uint64_t m_RxPkts;
+  uint64_t m_cumulativeRxPkts;
+  uint64_t m_TxBytes;
+  uint64_t m_cumulativeTxBytes;
+  uint64_t m_TxPkts;
+  uint64_t m_cumulativeTxPkts;
   double m_delaySum;
   double m_cumulativeDelaySum;
+  QuantileSketch m_delaySketch;
+  QuantileSketch m_jitterSketch;
+  // one entry per sender, so memory does not grow with the run length
+  std::map<uint32_t, SourceState> m_sources;
+  uint64_t m_seqGaps;
+  uint64_t m_reordered;
+  uint64_t m_controlTxPkts;
+  uint64_t m_controlTxBytes;
+  uint64_t m_hopSum;
+  uint64_t m_hopPkts;
 
   Time m_firstTxTime;
   Time m_lastRxTime;
@@ -188,29 +549,35 @@ RoutingStats::RoutingStats ()
     m_TxPkts (0),
     m_cumulativeTxPkts (0),
     m_delaySum(0),
-    m_cumulativeDelaySum(0)
+    m_cumulativeDelaySum(0),
+    m_seqGaps(0),
+    m_reordered(0),
+    m_controlTxPkts(0),
+    m_controlTxBytes(0),
+    m_hopSum(0),
+    m_hopPkts(0)
 {
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetRxBytes ()
 {
   return m_RxBytes;
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetCumulativeRxBytes ()
 {
   return m_cumulativeRxBytes;
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetRxPkts ()
 {
   return m_RxPkts;
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetCumulativeRxPkts ()
 {
   return m_cumulativeRxPkts;
@@ -231,36 +598,36 @@ RoutingStats::IncRxPkts ()
 }
 
 void
-RoutingStats::SetRxBytes (uint32_t rxBytes)
+RoutingStats::SetRxBytes (uint64_t rxBytes)
 {
   m_RxBytes = rxBytes;
 }
 
 void
-RoutingStats::SetRxPkts (uint32_t rxPkts)
+RoutingStats::SetRxPkts (uint64_t rxPkts)
 {
   m_RxPkts = rxPkts;
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetTxBytes ()
 {
   return m_TxBytes;
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetCumulativeTxBytes ()
 {
   return m_cumulativeTxBytes;
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetTxPkts ()
 {
   return m_TxPkts;
 }
 
-uint32_t
+uint64_t
 RoutingStats::GetCumulativeTxPkts ()
 {
   return m_cumulativeTxPkts;
@@ -281,13 +648,13 @@ RoutingStats::IncTxPkts ()
 }
 
 void
-RoutingStats::SetTxBytes (uint32_t txBytes)
+RoutingStats::SetTxBytes (uint64_t txBytes)
 {
   m_TxBytes = txBytes;
 }
 
 void
-RoutingStats::SetTxPkts (uint32_t txPkts)
+RoutingStats::SetTxPkts (uint64_t txPkts)
 {
   m_TxPkts = txPkts;
 }
@@ -313,6 +680,91 @@ RoutingStats::IncDelaySum(double delay){
   m_cumulativeDelaySum += delay;
 }
 
+void
+RoutingStats::RecordReception (uint32_t source, uint32_t seq, Time delay)
+{
+  int64_t delayNs = std::max (delay.GetNanoSeconds (), (int64_t) 0);
+  m_delaySketch.Add (delayNs);
+
+  std::map<uint32_t, SourceState>::iterator it = m_sources.find (source);
+  if (it == m_sources.end ())
+    {
+      SourceState state;
+      state.nextSeq = seq + 1;
+      state.lastDelay = delayNs;
+      m_sources.insert (std::make_pair (source, state));
+      return;
+    }
+  SourceState &state = it->second;
+  m_jitterSketch.Add (std::abs (delayNs - state.lastDelay));
+  state.lastDelay = delayNs;
+  if (seq >= state.nextSeq)
+    {
+      m_seqGaps += seq - state.nextSeq;
+      state.nextSeq = seq + 1;
+    }
+  else
+    {
+      m_reordered++;
+    }
+}
+
+const QuantileSketch &
+RoutingStats::GetDelaySketch () const
+{
+  return m_delaySketch;
+}
+
+const QuantileSketch &
+RoutingStats::GetJitterSketch () const
+{
+  return m_jitterSketch;
+}
+
+uint64_t
+RoutingStats::GetSeqGaps () const
+{
+  return m_seqGaps;
+}
+
+uint64_t
+RoutingStats::GetReordered () const
+{
+  return m_reordered;
+}
+
+void
+RoutingStats::IncControlTx (uint32_t bytes)
+{
+  m_controlTxPkts++;
+  m_controlTxBytes += bytes;
+}
+
+uint64_t
+RoutingStats::GetControlTxPkts () const
+{
+  return m_controlTxPkts;
+}
+
+uint64_t
+RoutingStats::GetControlTxBytes () const
+{
+  return m_controlTxBytes;
+}
+
+void
+RoutingStats::RecordHops (uint32_t hops)
+{
+  m_hopSum += hops;
+  m_hopPkts++;
+}
+
+double
+RoutingStats::GetAverageHops () const
+{
+  return m_hopPkts > 0 ? (double) m_hopSum / m_hopPkts : 0.0;
+}
+
 Time RoutingStats::GetFirstTxTime(){
   return m_firstTxTime;
 }
@@ -330,898 +782,5099 @@ void RoutingStats::SetLastRxTime(Time t){
 
 }
 
-class RoutingHelper : public Object
+/**
+ * Records wall time, CPU time, resident set growth and simulator events of
+ * the phases of a run.  Phases nest (Begin/End pairs); code that has no
+ * access to the profiler of the current run can use BeginActive/EndActive.
+ * Each phase costs a few clock_gettime calls and two reads of
+ * /proc/self/statm, so it can stay enabled.
+ *
+ * The event count is read from the simulator only while the destroy hook
+ * is scheduled on it; after Simulator::Destroy the count the hook kept is
+ * used, so the phases that follow (ProcessOutputs) do not create a new
+ * simulator.  Only an outermost Begin, i.e. the start of a run, schedules
+ * the hook.
+ */
+class PhaseProfiler
 {
 public:
-  /**
-   * \brief Get class TypeId
-   * \return the TypeId for the class
-   */
-  static TypeId GetTypeId (void);
+  struct Phase
+  {
+    std::string name;
+    uint32_t depth;
+    double wallSeconds;
+    double cpuSeconds;
+    int64_t rssDeltaKb;     // growth of the resident set size (statm)
+    uint64_t events;        // simulator events executed
+  };
 
   /**
    * \brief Constructor
    * \return none
    */
-  RoutingHelper ();
+  PhaseProfiler ();
 
   /**
-   * \brief Destructor
+   * \brief Starts a phase, nested in the current one if any
+   * \param name the phase name
    * \return none
    */
-  virtual ~RoutingHelper ();
+  void Begin (std::string name);
 
   /**
-   * \brief Installs routing funcationality on nodes and their
-   * devices and interfaces.
-   * \param c node container
-   * \param d net device container
-   * \param i IPv4 interface container
-   * \param totalTime the total time that nodes should attempt to
-   * route data
-   * \param protocol the routing protocol (1=OLSR;2=AODV;3=DSDV;4=DSR)
-   * \param nSinks the number of nodes which will act as data sinks
-   * \param routingTables dump routing tables at t=5 seconds (0=no;1=yes)
+   * \brief Ends the innermost phase
    * \return none
    */
-  void Install (NodeContainer & c,
-                NetDeviceContainer & d,
-                Ipv4InterfaceContainer & i,
-                double totalTime,
-                int protocol,
-                uint32_t nSinks,
-                int routingTables);
+  void End ();
 
   /**
-   * \brief Trace the receipt of an on-off-application generated packet
-   * \param context this object
-   * \param packet a received packet
-   * \return none
+   * \brief Returns the number of completed phases
+   * \return the number of phases
    */
-  void OnOffTrace (std::string context, Ptr<const Packet> packet);
+  uint32_t GetN () const;
 
   /**
-   * \brief Returns the RoutingStats instance
-   * \return the RoutingStats instance
+   * \brief Returns a completed phase, in order of completion
+   * \param i the phase index
+   * \return the phase
    */
-  RoutingStats & GetRoutingStats ();
+  const Phase & Get (uint32_t i) const;
 
   /**
-   * \brief Enable/disable logging
-   * \param log non-zero to enable logging
+   * \brief Makes this profiler the target of BeginActive/EndActive
+   * \param profiler the profiler, or 0
    * \return none
    */
-  void SetLogging (int log);
+  static void SetActive (PhaseProfiler *profiler);
+
+  static void BeginActive (std::string name);
+
+  static void EndActive ();
 
 private:
-  /**
-   * \brief Sets up the protocol protocol on the nodes
-   * \param c node container
-   * \return none
-   */
-  void SetupRoutingProtocol (NodeContainer & c);
+  struct Sample
+  {
+    double wall;
+    double cpu;
+    int64_t rssKb;
+    uint64_t events;
+    uint32_t destroyGeneration;
+  };
 
-  /**
-   * \brief Assigns IPv4 addresses to net devices and their interfaces
-   * \param d net device container
-   * \param adhocTxInterfaces IPv4 interface container
-   * \return none
-   */
-  void AssignIpAddresses (NetDeviceContainer & d,
-                          Ipv4InterfaceContainer & adhocTxInterfaces);
+  Sample Now () const;
 
   /**
-   * \brief Sets up routing messages on the nodes and their interfaces
-   * \param c node container
-   * \param adhocTxInterfaces IPv4 interface container
+   * \brief Simulator destroy hook: keeps the event count of the simulator
+   * being destroyed, since it is lost with it
    * \return none
    */
-  void SetupRoutingMessages (NodeContainer & c,
-                             Ipv4InterfaceContainer & adhocTxInterfaces);
+  static void CaptureEventCount ();
 
-  /**
-   * \brief Sets up a routing packet for tranmission
-   * \param addr destination address
-   * \parm node source node
-   * \return Socket to be used for sending/receiving a routed data packet
-   */
-  Ptr<Socket> SetupRoutingPacketReceive (Ipv4Address addr, Ptr<Node> node);
+  std::vector<Phase> m_phases;
+  std::vector<std::pair<std::string, Sample> > m_open;
 
-  /**
-   * \brief Process a received routing packet
-   * \param socket the receiving socket
-   * \return none
-   */
-  void ReceiveRoutingPacket (Ptr<Socket> socket);
+  static PhaseProfiler *s_active;
+  static bool s_hookScheduled;
+  static uint32_t s_destroyGeneration;
+  static uint64_t s_eventsAtDestroy;
+};
 
-  double m_TotalSimTime;        // seconds
-  uint32_t m_protocol;       // routing protocol; 0=NONE, 1=OLSR, 2=AODV, 3=DSDV, 4=DSR
-  uint32_t m_port;
-  uint32_t m_nSinks;              // number of sink nodes (< all nodes)
-  int m_routingTables;      // dump routing table (at t=5 sec).  0=No, 1=Yes
-  RoutingStats routingStats;
-  std::string m_protocolName;
-  int m_log;
-  uint32_t m_packetSize;
-  uint32_t m_nNodes;
-};
+PhaseProfiler *PhaseProfiler::s_active = 0;
+bool PhaseProfiler::s_hookScheduled = false;
+uint32_t PhaseProfiler::s_destroyGeneration = 0;
+uint64_t PhaseProfiler::s_eventsAtDestroy = 0;
 
-NS_OBJECT_ENSURE_REGISTERED (RoutingHelper);
+PhaseProfiler::PhaseProfiler ()
+{
+}
 
-TypeId
-RoutingHelper::GetTypeId (void)
+PhaseProfiler::Sample
+PhaseProfiler::Now () const
 {
-  static TypeId tid = TypeId ("ns3::RoutingHelper")
-    .SetParent<Object> ()
-    .AddConstructor<RoutingHelper> ();
-  return tid;
+  Sample sample;
+  struct timespec ts;
+  clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts);
+  sample.cpu = ts.tv_sec + ts.tv_nsec * 1e-9;
+  sample.wall = WallClockSeconds ();
+  sample.rssKb = ResidentSetKb ();
+  sample.events = s_hookScheduled ? Simulator::GetEventCount () : s_eventsAtDestroy;
+  sample.destroyGeneration = s_destroyGeneration;
+  return sample;
 }
 
-RoutingHelper::RoutingHelper ()
-  : m_TotalSimTime (300.01),
-    m_protocol (0),
-    m_port (9),
-    m_nSinks (0),
-    m_routingTables (0),
-    m_log (0),
-    m_packetSize(64)
+void
+PhaseProfiler::CaptureEventCount ()
 {
+  s_eventsAtDestroy = Simulator::GetEventCount ();
+  s_destroyGeneration++;
+  s_hookScheduled = false;
 }
 
-RoutingHelper::~RoutingHelper ()
+void
+PhaseProfiler::Begin (std::string name)
 {
+  if (!s_hookScheduled && m_open.empty ())
+    {
+      // a static hook, so a profiler may go away before the simulator does
+      Simulator::ScheduleDestroy (&PhaseProfiler::CaptureEventCount);
+      s_hookScheduled = true;
+    }
+  m_open.push_back (std::make_pair (name, Now ()));
 }
 
 void
-RoutingHelper::Install (NodeContainer & c,
-                        NetDeviceContainer & d,
-                        Ipv4InterfaceContainer & i,
-                        double totalTime,
-                        int protocol,
-                        uint32_t nSinks,
-                        int routingTables)
+PhaseProfiler::End ()
 {
-  m_TotalSimTime = totalTime;
-  m_protocol = protocol;
-  m_nSinks = nSinks;
-  m_routingTables = routingTables;
-  m_nNodes = i.GetN();
+  NS_ASSERT (!m_open.empty ());
+  Sample end = Now ();
+  const Sample &start = m_open.back ().second;
+  Phase phase;
+  phase.name = m_open.back ().first;
+  phase.depth = m_open.size () - 1;
+  phase.wallSeconds = end.wall - start.wall;
+  phase.cpuSeconds = end.cpu - start.cpu;
+  phase.rssDeltaKb = end.rssKb - start.rssKb;
+  // Simulator::Destroy during the phase resets the count
+  uint64_t endEvents = end.destroyGeneration != start.destroyGeneration ? s_eventsAtDestroy : end.events;
+  phase.events = endEvents >= start.events ? endEvents - start.events : endEvents;
+  m_phases.push_back (phase);
+  m_open.pop_back ();
+}
 
-  SetupRoutingProtocol (c);
-  AssignIpAddresses (d, i);
-  SetupRoutingMessages (c, i);
+uint32_t
+PhaseProfiler::GetN () const
+{
+  return m_phases.size ();
 }
 
-Ptr<Socket>
-RoutingHelper::SetupRoutingPacketReceive (Ipv4Address addr, Ptr<Node> node)
+const PhaseProfiler::Phase &
+PhaseProfiler::Get (uint32_t i) const
 {
-  TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
-  Ptr<Socket> sink = Socket::CreateSocket (node, tid);
-  InetSocketAddress local = InetSocketAddress (addr, m_port);
-  sink->Bind (local);
-  sink->SetRecvCallback (MakeCallback (&RoutingHelper::ReceiveRoutingPacket, this));
+  return m_phases[i];
+}
 
-  return sink;
+void
+PhaseProfiler::SetActive (PhaseProfiler *profiler)
+{
+  s_active = profiler;
 }
 
 void
-RoutingHelper::SetupRoutingProtocol (NodeContainer & c)
+PhaseProfiler::BeginActive (std::string name)
 {
-  InternetStackHelper stack;
-  stack.Install(c);
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
-  if (m_log != 0)
+  if (s_active != 0)
     {
-      NS_LOG_UNCOND ("Routing Setup for " << m_protocolName);
+      s_active->Begin (name);
     }
 }
 
 void
-RoutingHelper::AssignIpAddresses (NetDeviceContainer & d,
-                                  Ipv4InterfaceContainer & adhocTxInterfaces)
+PhaseProfiler::EndActive ()
 {
-  NS_LOG_INFO ("Assigning IP addresses");
-  Ipv4AddressHelper addressAdhoc;
-  // we may have a lot of nodes, and want them all
-  // in same subnet, to support broadcast
-  addressAdhoc.SetBase ("10.1.0.0", "255.255.0.0");
-  adhocTxInterfaces = addressAdhoc.Assign (d);
+  if (s_active != 0)
+    {
+      s_active->End ();
+    }
 }
 
-void
-RoutingHelper::SetupRoutingMessages (NodeContainer & c,
-                                     Ipv4InterfaceContainer & adhocTxInterfaces)
+/**
+ * Per-node traffic statistics, stored as one contiguous 64-bit array per
+ * counter indexed by node id, so an update is an indexed add like the
+ * RoutingStats counters.  Deliveries are credited to the sending node.
+ */
+class NodeStatsTable
 {
-  // Setup routing transmissions
-  OnOffHelper onoff1 ("ns3::UdpSocketFactory",Address ());
-  onoff1.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
-  onoff1.SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"));
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  NodeStatsTable ();
 
-  Ptr<UniformRandomVariable> var = CreateObject<UniformRandomVariable> ();
-  int64_t stream = 2;
-  var->SetStream (stream);
+  /**
+   * \brief Sizes the table and clears all counters
+   * \param nNodes the number of node ids
+   * \return none
+   */
+  void Reset (uint32_t nNodes);
 
-  //Use Base Station as Sink
-  Ptr<Socket> sink = SetupRoutingPacketReceive (adhocTxInterfaces.GetAddress (0), c.Get (0));
-  // AddressValue remoteAddress (InetSocketAddress ("10.1.255.255", m_port));
-  // onoff1.SetAttribute("Remote",remoteAddress);
-  // ApplicationContainer baseApp = onoff1.Install (c.Get (0));
-  // baseApp.Start (Seconds (var->GetValue (1.0,2.0)));
-  // baseApp.Stop(Seconds(m_TotalSimTime));
-  AddressValue remoteAddress(InetSocketAddress(adhocTxInterfaces.GetAddress(0),m_port));
-  for (uint32_t i = 1; i < adhocTxInterfaces.GetN(); i++)
-    {
-   
- 
-      Ptr<Socket> nodeSink = SetupRoutingPacketReceive (adhocTxInterfaces.GetAddress (i), c.Get (i));
-      onoff1.SetAttribute ("Remote", remoteAddress);
+  uint32_t GetN () const;
 
-      ApplicationContainer temp = onoff1.Install (c.Get (i));
-      temp.Start (Seconds (var->GetValue (1.0,2.0)));
-      temp.Stop (Seconds (m_TotalSimTime));
-    }
-}
+  /**
+   * \brief Counts a packet sent by a node
+   * \param node the sender's node id
+   * \param bytes the packet size
+   * \return none
+   */
+  void RecordTx (uint32_t node, uint32_t bytes);
 
-static inline std::string
-PrintReceivedRoutingPacket (Ptr<Socket> socket, Ptr<Packet> packet)
-{
-  SocketAddressTag tag;
-  bool found;
-  found = packet->PeekPacketTag (tag);
-  std::ostringstream oss;
+  /**
+   * \brief Counts a delivered packet
+   * \param node the sender's node id
+   * \param bytes the packet size
+   * \param delayNs the one-way delay in nanoseconds
+   * \return none
+   */
+  void RecordRx (uint32_t node, uint32_t bytes, int64_t delayNs);
 
-  oss << Simulator::Now ().GetSeconds () << " " << socket->GetNode ()->GetId ();
+  uint64_t GetTxPkts (uint32_t node) const;
 
-  if (found)
-    {
-      InetSocketAddress addr = InetSocketAddress::ConvertFrom (tag.GetAddress ());
-      oss << " received one packet from " << addr.GetIpv4 ();
-    }
-  else
-    {
-      oss << " received one packet!";
-    }
-  return oss.str ();
-}
+  uint64_t GetTxBytes (uint32_t node) const;
 
-void
-RoutingHelper::ReceiveRoutingPacket (Ptr<Socket> socket)
-{
-  Ptr<Packet> packet;
-  while ((packet = socket->Recv ()))
-    {
-      // application data, for goodput
-      SeqTsHeader seqTs;
-      uint32_t RxRoutingBytes = packet->GetSize ();
-      GetRoutingStats ().IncRxBytes (RxRoutingBytes);
-      packet->RemoveHeader (seqTs);
-      GetRoutingStats ().IncRxPkts ();
-      GetRoutingStats().IncDelaySum((Simulator::Now() - seqTs.GetTs()).GetSeconds()); //Transmission Time
-      if (m_log != 0)
-        {
-          NS_LOG_UNCOND (m_protocolName + " " + PrintReceivedRoutingPacket (socket, packet));
-        }
+  uint64_t GetRxPkts (uint32_t node) const;
 
-      GetRoutingStats().SetLastRxTime(Simulator::Now());
-    }
+  uint64_t GetRxBytes (uint32_t node) const;
+
+  /**
+   * \brief Returns the summed delay of a node's delivered packets
+   * \param node the node id
+   * \return the delay sum in nanoseconds
+   */
+  int64_t GetDelaySum (uint32_t node) const;
+
+  /**
+   * \brief Returns the percentage of a node's packets that were delivered
+   * \param node the node id
+   * \return the delivery ratio in percent (0 if the node sent nothing)
+   */
+  double GetDeliveryRatio (uint32_t node) const;
+
+  /**
+   * \brief Returns Jain's fairness index of the delivered bytes of the
+   * nodes that sent traffic: 1 when all get the same, 1/n when one gets all
+   * \return the index, or 0 if no node sent traffic
+   */
+  double GetJainIndex () const;
+
+  /**
+   * \brief Returns the lowest and highest delivery ratio of the nodes
+   * that sent traffic
+   * \param min set to the lowest ratio, in percent
+   * \param max set to the highest ratio, in percent
+   * \return none
+   */
+  void GetDeliveryRange (double &min, double &max) const;
+
+private:
+  std::vector<uint64_t> m_txPkts;
+  std::vector<uint64_t> m_txBytes;
+  std::vector<uint64_t> m_rxPkts;
+  std::vector<uint64_t> m_rxBytes;
+  std::vector<int64_t> m_delaySum; // nanoseconds
+};
+
+NodeStatsTable::NodeStatsTable ()
+{
 }
 
 void
-RoutingHelper::OnOffTrace (std::string context, Ptr<const Packet> packet)
+NodeStatsTable::Reset (uint32_t nNodes)
 {
-  uint32_t pktBytes = packet->GetSize ();
-  Ptr<Packet> copy = packet->Copy();
-  // Ipv4Header iph;
-  // copy->RemoveHeader(iph);
-  // std::cout<<iph.GetDestination()<<"\n";
-  // Ipv4Mask mask = Ipv4Mask("255.255.0.0");
-  // if(iph.GetDestination().IsSubnetDirectedBroadcast(mask)){
-  //   routingStats.IncTxBytes(pktBytes*(m_nNodes - 1));
-  //   if(routingStats.GetTxPkts() == 0){
-  //   routingStats.SetFirstTxTime(Simulator::Now());
-  //   }
-  //   for(int i=0;i<m_nNodes-1;i++){
-  //     routingStats.IncTxPkts();
-  //   }
-  // }
-  // else{
-  //   if(routingStats.GetTxPkts() == 0){
-  //     routingStats.SetFirstTxTime(Simulator::Now());
-  //   }
-  //   routingStats.IncTxBytes (pktBytes);
-  //   routingStats.IncTxPkts();
-  // }
-
-    if(routingStats.GetTxPkts() == 0){
-      routingStats.SetFirstTxTime(Simulator::Now());
-    }
-    routingStats.IncTxBytes (pktBytes);
-    routingStats.IncTxPkts();
-    
+  m_txPkts.assign (nNodes, 0);
+  m_txBytes.assign (nNodes, 0);
+  m_rxPkts.assign (nNodes, 0);
+  m_rxBytes.assign (nNodes, 0);
+  m_delaySum.assign (nNodes, 0);
 }
 
-RoutingStats &
-RoutingHelper::GetRoutingStats ()
+uint32_t
+NodeStatsTable::GetN () const
 {
-  return routingStats;
+  return m_txPkts.size ();
 }
 
 void
-RoutingHelper::SetLogging (int log)
+NodeStatsTable::RecordTx (uint32_t node, uint32_t bytes)
 {
-  m_log = log;
+  NS_ASSERT (node < m_txPkts.size ());
+  m_txPkts[node]++;
+  m_txBytes[node] += bytes;
 }
 
+void
+NodeStatsTable::RecordRx (uint32_t node, uint32_t bytes, int64_t delayNs)
+{
+  NS_ASSERT (node < m_rxPkts.size ());
+  m_rxPkts[node]++;
+  m_rxBytes[node] += bytes;
+  m_delaySum[node] += delayNs;
+}
 
-class FileHandle{
-  public:
-    std::string m_filename;
-    std::ofstream m_outFile;
-
-    FileHandle(std::string filename);
-
-    void WriteHeader(std::string string);
-
-    void WriteData(std::string string);
-    
-    void Close();
+uint64_t
+NodeStatsTable::GetTxPkts (uint32_t node) const
+{
+  return m_txPkts[node];
+}
 
-};
+uint64_t
+NodeStatsTable::GetTxBytes (uint32_t node) const
+{
+  return m_txBytes[node];
+}
 
-FileHandle::FileHandle(std::string filename){
-  m_filename = filename;
+uint64_t
+NodeStatsTable::GetRxPkts (uint32_t node) const
+{
+  return m_rxPkts[node];
 }
 
-void FileHandle::WriteHeader(std::string string){
-  m_outFile = std::ofstream(m_filename.c_str());
-  m_outFile << string << std::endl;
-  m_outFile.close();
+uint64_t
+NodeStatsTable::GetRxBytes (uint32_t node) const
+{
+  return m_rxBytes[node];
 }
 
-void FileHandle::WriteData(std::string string){
-  m_outFile = std::ofstream(m_filename.c_str(),std::ios::app);
-  m_outFile << string << std::endl;
-  Close();
+int64_t
+NodeStatsTable::GetDelaySum (uint32_t node) const
+{
+  return m_delaySum[node];
 }
 
-void FileHandle::Close(){
-  m_outFile.close();
+double
+NodeStatsTable::GetDeliveryRatio (uint32_t node) const
+{
+  return m_txPkts[node] > 0 ? m_rxPkts[node] * 100.0 / m_txPkts[node] : 0.0;
 }
 
+double
+NodeStatsTable::GetJainIndex () const
+{
+  double sum = 0;
+  double sumSquares = 0;
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < m_txPkts.size (); i++)
+    {
+      if (m_txPkts[i] == 0)
+        {
+          continue;
+        }
+      double x = m_rxBytes[i];
+      sum += x;
+      sumSquares += x * x;
+      n++;
+    }
+  if (n == 0)
+    {
+      return 0.0;
+    }
+  // all senders starved: equally (un)served
+  return sumSquares > 0 ? sum * sum / (n * sumSquares) : 1.0;
+}
 
+void
+NodeStatsTable::GetDeliveryRange (double &min, double &max) const
+{
+  bool found = false;
+  min = 0;
+  max = 0;
+  for (uint32_t i = 0; i < m_txPkts.size (); i++)
+    {
+      if (m_txPkts[i] == 0)
+        {
+          continue;
+        }
+      double ratio = GetDeliveryRatio (i);
+      min = found ? std::min (min, ratio) : ratio;
+      max = found ? std::max (max, ratio) : ratio;
+      found = true;
+    }
+}
 
-class WifiApp
+/**
+ * Binary log of per-event records (packet received, packet sent, course
+ * change) of one run.  Records are fixed-size and go into a preallocated
+ * buffer that is written out in large blocks, so a long run does not
+ * format and flush a text line per event.  Decode turns a log back into
+ * the text lines the run would otherwise have written.
+ *
+ * The file is a header ("NS3EVLOG", the record size, the length and text
+ * of a label, i.e. the routing protocol name) followed by the records in
+ * host byte order.
+ */
+class EventLog
 {
 public:
-  /**
-   * \brief Constructor
-   * \return none
-   */
-  WifiApp ();
+  enum Type
+  {
+    PACKET_RX = 1, // arg: IPv4 source address, 0 if unknown
+    PACKET_TX = 2, // arg: packet size in bytes
+    COURSE_CHANGE = 3 // value: x, y, velocity x, velocity y
+  };
 
   /**
-   * \brief Destructor
-   * \return none
+   * One event; the meaning of arg and value depends on the type
    */
-  virtual ~WifiApp ();
+  struct Record
+  {
+    uint32_t type;
+    uint32_t node;
+    int64_t time; // Time::GetTimeStep
+    uint64_t arg;
+    double value[4];
+  };
 
   /**
-   * \brief Enacts simulation of an ns-3 wifi application
-   * \param argc program arguments count
-   * \param argv program arguments
+   * \brief Constructor
+   * \param capacity number of records buffered between writes, allocated
+   * when the log is opened
    * \return none
    */
-  void Simulate (int argc, char **argv);
+  EventLog (uint32_t capacity = 16384);
 
-protected:
   /**
-   * \brief Sets default attribute values
+   * \brief Destructor; closes the log
    * \return none
    */
-  virtual void SetDefaultAttributeValues ();
+  ~EventLog ();
 
   /**
-   * \brief Process command line arguments
-   * \param argc program arguments count
-   * \param argv program arguments
-   * \return none
+   * \brief Starts a new log file
+   * \param filename the log file
+   * \param label text stored in the header (e.g. the protocol name)
+   * \return false if the file cannot be created
    */
-  virtual void ParseCommandLineArguments (int argc, char **argv);
+  bool Open (std::string filename, std::string label);
 
   /**
-   * \brief Configure nodes
-   * \return none
+   * \brief Returns whether the log is open
+   * \return true if events are being logged
    */
-  virtual void ConfigureNodes ();
+  bool IsOpen () const;
 
   /**
-   * \brief Configure channels
+   * \brief Writes out the buffered records and closes the log
    * \return none
    */
-  virtual void ConfigureChannels ();
+  void Close ();
 
   /**
-   * \brief Configure devices
+   * \brief Logs an event at the current simulation time
+   * \param type the event type
+   * \param node the node id
+   * \param arg integer argument of the event
+   * \param v0 first value
+   * \param v1 second value
+   * \param v2 third value
+   * \param v3 fourth value
    * \return none
    */
-  virtual void ConfigureDevices ();
+  void Append (Type type, uint32_t node, uint64_t arg,
+               double v0 = 0, double v1 = 0, double v2 = 0, double v3 = 0);
 
   /**
-   * \brief Configure mobility
-   * \return none
+   * \brief Prints a log as the text lines of the run: the receive lines of
+   * RoutingHelper's logging, the course change lines of the mobility log
+   * and a line per packet sent
+   * \param filename the log file
+   * \param os the stream to print to
+   * \return false if the file is not a complete event log
    */
-  virtual void ConfigureMobility ();
+  static bool Decode (std::string filename, std::ostream &os);
 
+private:
   /**
-   * \brief Configure applications
+   * \brief Writes out the buffered records
    * \return none
    */
-  virtual void ConfigureApplications ();
+  void Flush ();
 
-  /**
-   * \brief Configure tracing
-   * \return none
-   */
-  virtual void ConfigureTracing ();
-
-  /**
-   * \brief Run the simulation
-   * \return none
-   */
-  virtual void RunSimulation ();
-
-  /**
-   * \brief Process outputs
-   * \return none
-   */
-  virtual void ProcessOutputs ();
+  int m_fd;
+  uint32_t m_capacity;
+  std::vector<Record> m_buffer;
+  uint32_t m_used;
 };
 
-WifiApp::WifiApp ()
-{
-}
-
-WifiApp::~WifiApp ()
-{
-}
-
-void
-WifiApp::Simulate (int argc, char **argv)
-{
-  // Simulator Program Flow:
-  // (source:  NS-3 Annual Meeting, May, 2014, session 2 slides 6, 28)
-  //   (HandleProgramInputs:)
-  //   SetDefaultAttributeValues
-  //   ParseCommandLineArguments
-  //   (ConfigureTopology:)
-  //   ConfigureNodes
-  //   ConfigureChannels
-  //   ConfigureDevices
-  //   ConfigureMobility
-  //   ConfigureApplications
-  //     e.g AddInternetStackToNodes
-  //         ConfigureIpAddressingAndRouting
-  //         configureSendMessages
-  //   ConfigureTracing
-  //   RunSimulation
-  //   ProcessOutputs
-
-  SetDefaultAttributeValues ();
-  ParseCommandLineArguments (argc, argv);
-  ConfigureNodes ();
-  ConfigureChannels ();
-  ConfigureDevices ();
-  ConfigureMobility ();
-  ConfigureApplications ();
-  ConfigureTracing ();
-  RunSimulation ();
-  ProcessOutputs ();
-}
-
-void
-WifiApp::SetDefaultAttributeValues ()
-{
-}
-
-void
-WifiApp::ParseCommandLineArguments (int argc, char **argv)
-{
-}
-
-void
-WifiApp::ConfigureNodes ()
+EventLog::EventLog (uint32_t capacity)
+  : m_fd (-1),
+    m_capacity (std::max (capacity, (uint32_t) 1)),
+    m_used (0)
 {
 }
 
-void
-WifiApp::ConfigureChannels ()
+EventLog::~EventLog ()
 {
+  Close ();
 }
 
-void
-WifiApp::ConfigureDevices ()
+bool
+EventLog::Open (std::string filename, std::string label)
 {
+  Close ();
+  m_fd = open (filename.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (m_fd < 0)
+    {
+      NS_LOG_ERROR ("EventLog: cannot create " << filename << ": " << std::strerror (errno));
+      return false;
+    }
+  std::string header ("NS3EVLOG", 8);
+  uint32_t sizes[2] = { sizeof (Record), (uint32_t) label.size () };
+  header.append ((const char *) sizes, sizeof (sizes));
+  header += label;
+  if (write (m_fd, header.data (), header.size ()) != (ssize_t) header.size ())
+    {
+      NS_LOG_ERROR ("EventLog: cannot write " << filename);
+    }
+  m_buffer.resize (m_capacity);
+  m_used = 0;
+  return true;
 }
 
-void
-WifiApp::ConfigureMobility ()
+bool
+EventLog::IsOpen () const
 {
+  return m_fd >= 0;
 }
 
 void
-WifiApp::ConfigureApplications ()
+EventLog::Flush ()
 {
+  size_t size = m_used * sizeof (Record);
+  const char *data = (const char *) &m_buffer[0];
+  while (size > 0)
+    {
+      ssize_t n = write (m_fd, data, size);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n <= 0)
+        {
+          NS_LOG_ERROR ("EventLog: write failed: " << std::strerror (errno));
+          break;
+        }
+      data += n;
+      size -= n;
+    }
+  m_used = 0;
 }
 
 void
-WifiApp::ConfigureTracing ()
+EventLog::Close ()
 {
+  if (m_fd < 0)
+    {
+      return;
+    }
+  Flush ();
+  close (m_fd);
+  m_fd = -1;
 }
 
 void
-WifiApp::RunSimulation ()
+EventLog::Append (Type type, uint32_t node, uint64_t arg, double v0, double v1, double v2, double v3)
 {
+  Record &record = m_buffer[m_used];
+  record.type = type;
+  record.node = node;
+  record.time = Simulator::Now ().GetTimeStep ();
+  record.arg = arg;
+  record.value[0] = v0;
+  record.value[1] = v1;
+  record.value[2] = v2;
+  record.value[3] = v3;
+  if (++m_used == m_buffer.size ())
+    {
+      Flush ();
+    }
 }
 
-void
-WifiApp::ProcessOutputs ()
+bool
+EventLog::Decode (std::string filename, std::ostream &os)
 {
+  std::ifstream in (filename.c_str (), std::ios::binary);
+  char magic[8];
+  uint32_t sizes[2];
+  if (!in.read (magic, sizeof (magic)) || std::string (magic, 8) != "NS3EVLOG"
+      || !in.read ((char *) sizes, sizeof (sizes)) || sizes[0] != sizeof (Record))
+    {
+      std::cerr << "EventLog: " << filename << " is not an event log of this build\n";
+      return false;
+    }
+  std::string label (sizes[1], ' ');
+  if (sizes[1] > 0 && !in.read (&label[0], sizes[1]))
+    {
+      return false;
+    }
+  Record record;
+  while (in.read ((char *) &record, sizeof (record)))
+    {
+      Time time (record.time);
+      switch (record.type)
+        {
+        case PACKET_RX:
+          os << label << " " << time.GetSeconds () << " " << record.node;
+          if (record.arg != 0)
+            {
+              os << " received one packet from " << Ipv4Address ((uint32_t) record.arg) << "\n";
+            }
+          else
+            {
+              os << " received one packet!\n";
+            }
+          break;
+        case PACKET_TX:
+          os << label << " " << time.GetSeconds () << " " << record.node
+             << " sent one packet of " << record.arg << " bytes\n";
+          break;
+        case COURSE_CHANGE:
+          os << time << " POS: x=" << record.value[0] << ", y=" << record.value[1]
+             << "; VEL:" << record.value[2] << ", y=" << record.value[3] << "\n";
+          break;
+        default:
+          std::cerr << "EventLog: unknown record type " << record.type << "\n";
+          return false;
+        }
+    }
+  if (in.gcount () != 0)
+    {
+      std::cerr << "EventLog: " << filename << " ends with a partial record\n";
+      return false;
+    }
+  return true;
 }
 
-class Experiment : public WifiApp
+class RoutingHelper : public Object
 {
 public:
   /**
-   * \brief Constructor
-   * \return none
+   * \brief Get class TypeId
+   * \return the TypeId for the class
    */
-  Experiment ();
-  Experiment(double yDist,uint32_t mobility,uint32_t nodes,uint32_t macMode,uint32_t lossmodel,double txp,FileHandle* fh);
-  Experiment(FileHandle* fh,std::string rate,uint32_t nodes);
-  Experiment(FileHandle* fh,int slot,int guard);
-  Experiment(FileHandle* fh,uint32_t size,int slot);
-  ~Experiment();
+  static TypeId GetTypeId (void);
 
-protected:
   /**
-   * \brief Sets default attribute values
+   * \brief Constructor
    * \return none
    */
-  virtual void SetDefaultAttributeValues ();
+  RoutingHelper ();
 
   /**
-   * \brief Process command line arguments
-   * \param argc program arguments count
-   * \param argv program arguments
+   * \brief Destructor
    * \return none
    */
-  virtual void ParseCommandLineArguments (int argc, char **argv);
+  virtual ~RoutingHelper ();
 
   /**
-   * \brief Configure nodes
+   * \brief Installs routing funcationality on nodes and their
+   * devices and interfaces.
+   * \param c node container
+   * \param d net device container
+   * \param i IPv4 interface container
+   * \param totalTime the total time that nodes should attempt to
+   * route data
+   * \param protocol the routing protocol (0=global routing;1=OLSR;2=AODV;3=DSDV;4=DSR;
+   * 5=static single-hop cell)
+   * \param nSinks the number of nodes which will act as data sinks
+   * \param routingTables dump routing tables at t=5 seconds (0=no;1=yes)
    * \return none
    */
-  virtual void ConfigureNodes ();
+  void Install (NodeContainer & c,
+                NetDeviceContainer & d,
+                Ipv4InterfaceContainer & i,
+                double totalTime,
+                int protocol,
+                uint32_t nSinks,
+                int routingTables);
 
   /**
-   * \brief Configure channels
+   * \brief Trace the transmission of an on-off-application generated
+   * packet.  The application index bound by TraceHookup is not used
+   * \param node the id of the sending node
+   * \param packet the packet sent
    * \return none
    */
-  virtual void ConfigureChannels ();
+  void OnOffTrace (uint32_t node, uint32_t, Ptr<const Packet> packet);
 
   /**
-   * \brief Configure devices
+   * \brief Trace of the IPv4 packets a node sends or forwards; counts
+   * the routing control packets: UDP packets to another port than the
+   * data's (AODV, OLSR and DSDV messages) and DSR control messages
+   * \param packet the packet, IPv4 header included
    * \return none
    */
-  virtual void ConfigureDevices ();
+  void Ipv4TxTrace (Ptr<const Packet> packet, Ptr<Ipv4>, uint32_t);
 
   /**
-   * \brief Configure mobility
-   * \return none
+   * \brief Returns the name of the routing protocol installed
+   * \return e.g. AODV
    */
-  virtual void ConfigureMobility ();
+  std::string GetProtocolName () const;
 
   /**
-   * \brief Configure applications
-   * \return none
+   * \brief Returns the RoutingStats instance
+   * \return the RoutingStats instance
    */
-  virtual void ConfigureApplications ();
+  RoutingStats & GetRoutingStats ();
 
   /**
-   * \brief Configure tracing
-   * \return none
+   * \brief Returns the per-node statistics
+   * \return reference to the per-node statistics table
    */
-  virtual void ConfigureTracing ();
+  NodeStatsTable & GetNodeStats ();
 
   /**
-   * \brief Run the simulation
+   * \brief Enable/disable logging
+   * \param log non-zero to enable logging
    * \return none
    */
-  virtual void RunSimulation ();
+  void SetLogging (int log);
 
   /**
-   * \brief Process outputs
+   * \brief Logs the packets sent and received to a binary event log, which
+   * replaces the text logging while it is open
+   * \param log the event log (0 for none); must outlive the helper's use
    * \return none
    */
-  virtual void ProcessOutputs ();
+  void SetEventLog (EventLog *log);
 
 private:
   /**
-   * \brief Run the simulation
-   * \return none
-   */
-  void Run ();
-
-  /**
-   * \brief Run the simulation
+   * \brief Sets up the protocol protocol on the nodes
+   * \param c node container
    * \return none
    */
-  void CommandSetup (int argc, char **argv);
+  void SetupRoutingProtocol (NodeContainer & c);
 
   /**
-   * \brief Checks the throughput and outputs summary to CSV file1.
-   * This is scheduled and called once per second
+   * \brief Assigns IPv4 addresses to net devices and their interfaces
+   * \param d net device container
+   * \param adhocTxInterfaces IPv4 interface container
    * \return none
    */
-  void CheckThroughput ();
+  void AssignIpAddresses (NetDeviceContainer & d,
+                          Ipv4InterfaceContainer & adhocTxInterfaces);
 
   /**
-   * \brief Set up log file
+   * \brief Sets up routing messages on the nodes and their interfaces
+   * \param c node container
+   * \param adhocTxInterfaces IPv4 interface container
    * \return none
    */
-  void SetupLogFile ();
+  void SetupRoutingMessages (NodeContainer & c,
+                             Ipv4InterfaceContainer & adhocTxInterfaces);
 
   /**
-   * \brief Set up logging
-   * \return none
+   * \brief Sets up a routing packet for tranmission
+   * \param addr destination address
+   * \parm node source node
+   * \return Socket to be used for sending/receiving a routed data packet
    */
-  void SetupLogging ();
+  Ptr<Socket> SetupRoutingPacketReceive (Ipv4Address addr, Ptr<Node> node);
 
   /**
-   * \brief Configure default attributes
+   * \brief Process a received routing packet
+   * \param socket the receiving socket
    * \return none
    */
-  void ConfigureDefaults ();
+  void ReceiveRoutingPacket (Ptr<Socket> socket);
 
-  /**CommandLine cmd;
-   * \brief Set up the adhoc mobility nodes
-   * \return none
-   */
-//   void SetupAdhocMobilityNodes ();
+  double m_TotalSimTime;        // seconds
+  uint32_t m_protocol;       // routing protocol; 0=global routing, 1=OLSR, 2=AODV, 3=DSDV, 4=DSR, 5=static cell
+  uint32_t m_port;
+  uint32_t m_nSinks;              // number of sink nodes (< all nodes)
+  int m_routingTables;      // dump routing table (at t=5 sec).  0=No, 1=Yes
+  RoutingStats routingStats;
+  NodeStatsTable m_nodeStats;
+  // node id of each IPv4 address, indexed from m_addressBase
+  std::vector<uint32_t> m_addressNode;
+  uint32_t m_addressBase;
+  std::string m_protocolName;
+  int m_log;
+  EventLog *m_eventLog;
+  uint32_t m_initialTtl; // TTL of the packets sent, for hop counts
+  uint32_t m_packetSize;
+  uint32_t m_nNodes;
+};
 
-  /**
-   * \brief Set up the adhoc devices
-   * \return none
-   */
-//   void SetupAdhocDevices ();
+NS_OBJECT_ENSURE_REGISTERED (RoutingHelper);
 
-  /**
-   * \brief Set up generation of IEEE 1609 WAVE messages,
-   * as a Basic Safety Message (BSM).  The BSM is typically
-   * a ~200-byte packets broadcast by all vehicles at a nominal
-   * rate of 10 Hz
-   * \return none
-   */
-//   void SetupWaveMessages ();
+TypeId
+RoutingHelper::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RoutingHelper")
+    .SetParent<Object> ()
+    .AddConstructor<RoutingHelper> ();
+  return tid;
+}
 
-  /**
-   * \brief Set up generation of packets to be routed
-   * through the vehicular network
-   * \return none
-   */
-  void SetupRoutingMessages ();
+RoutingHelper::RoutingHelper ()
+  : m_TotalSimTime (300.01),
+    m_protocol (0),
+    m_port (9),
+    m_nSinks (0),
+    m_routingTables (0),
+    m_addressBase (0),
+    m_log (0),
+    m_eventLog (0),
+    m_initialTtl (64),
+    m_packetSize(64)
+{
+}
 
-  /**
-   * \brief Set up a prescribed scenario
-   * \return none
-   */
-  void SetupScenario ();
+RoutingHelper::~RoutingHelper ()
+{
+}
 
-  /**
-   * \brief Write the header line to the CSV file1
-   * \return none
-   */
-  void WriteCsvHeader ();
+void
+RoutingHelper::Install (NodeContainer & c,
+                        NetDeviceContainer & d,
+                        Ipv4InterfaceContainer & i,
+                        double totalTime,
+                        int protocol,
+                        uint32_t nSinks,
+                        int routingTables)
+{
+  m_TotalSimTime = totalTime;
+  m_protocol = protocol;
+  m_nSinks = nSinks;
+  m_routingTables = routingTables;
+  m_nNodes = i.GetN();
 
-  /**
-   * \brief Set up configuration parameter from the global variables
-   * \return none
-   */
-//   void SetConfigFromGlobals ();
+  uint32_t nIds = 0;
+  for (uint32_t n = 0; n < c.GetN (); n++)
+    {
+      nIds = std::max (nIds, c.Get (n)->GetId () + 1);
+    }
+  m_nodeStats.Reset (nIds);
 
-//   /**
-//    * \brief Set up the global variables from the configuration parameters
-//    * \return none
-//    */
-//   void SetGlobalsFromConfig ();
+  SetupRoutingProtocol (c);
+  AssignIpAddresses (d, i);
+  if (m_protocol == 0)
+    {
+      // after the addresses, or the link-state database has no links
+      PhaseProfiler::BeginActive ("PopulateRoutingTables");
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+      PhaseProfiler::EndActive ();
+    }
+  SetupRoutingMessages (c, i);
+}
 
-  static void
-  CourseChange (std::ostream *os, std::string foo, Ptr<const MobilityModel> mobility);
+Ptr<Socket>
+RoutingHelper::SetupRoutingPacketReceive (Ipv4Address addr, Ptr<Node> node)
+{
+  TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+  Ptr<Socket> sink = Socket::CreateSocket (node, tid);
+  InetSocketAddress local = InetSocketAddress (addr, m_port);
+  sink->Bind (local);
+  // the TTL of a received packet gives the number of hops it took
+  sink->SetIpRecvTtl (true);
+  sink->SetRecvCallback (MakeCallback (&RoutingHelper::ReceiveRoutingPacket, this));
 
-  uint32_t m_port;
-  std::string m_CSVfileName;
-  std::string m_CSVfileName2;
-  uint32_t m_nSinks;
-  std::string m_protocolName;
-  double m_txp;
-  bool m_traceMobility;
-  uint32_t m_protocol;
+  return sink;
+}
 
-  uint32_t m_lossModel;
-  uint32_t m_fading;
-  std::string m_lossModelName;
+void
+RoutingHelper::SetupRoutingProtocol (NodeContainer & c)
+{
+  AodvHelper aodv;
+  OlsrHelper olsr;
+  DsdvHelper dsdv;
+  DsrHelper dsr;
+  DsrMainHelper dsrMain;
+  Ipv4ListRoutingHelper list;
+  Ipv4StaticRoutingHelper staticRouting;
+  InternetStackHelper stack;
 
-  std::string m_logFile;
-  uint32_t m_mobility;
-  uint32_t m_nNodes;
-  uint32_t m_nBase; //no of Base stations
-  double m_TotalSimTime;
-  std::string m_rate;
-  std::string m_trName;
-  int m_nodeSpeed; //in m/s
-  int m_nodePause; //in s
-  int m_verbose;
-  std::ofstream m_os;
-  NetDeviceContainer m_TxDevices;
-  NetDeviceContainer m_baseDevices;
-  NetDeviceContainer m_allDevices;
-  Ipv4InterfaceContainer m_TxInterfaces;
-  Ipv4InterfaceContainer m_baseInterfaces;
-  Ipv4InterfaceContainer m_allInterfaces;
-  uint32_t m_macMode;
-  int m_routingTables;
-  int m_asciiTrace;
-  int m_pcap;
-  double m_freq; //0 5.8Ghz 1 2.4Ghz
-  double m_baseAntennaHeight; //Base station Height 
-  double m_baseAntennaGain;
-  double m_nodeAntennaGain;
-  double m_nodeAntennaHeight;
-  int m_guardTime;
-  int m_slotTime;
-  int m_interFrameTime;
-  uint32_t m_packetSize;
-  Ptr<RoutingHelper> m_routingHelper;
-  // Ptr<FlowMonitor> m_monitor;
-  int m_log;
-  // used to get consistent random numbers across scenarios
-  int64_t m_streamIndex;
-  NodeContainer m_TxNodes;
-  NodeContainer m_baseNodes;
-  NodeContainer m_allNodes;
-  std::string m_exp;
-  int m_cumulativeCaptureStart;
-  uint32_t m_scenario;
-  // FlowMonitorHelper m_flowmon;
-  double m_yPos;
+  switch (m_protocol)
+    {
+    case 0:
+      m_protocolName = "GLOBAL";
+      break;
+    case 1:
+      list.Add (olsr, 100);
+      m_protocolName = "OLSR";
+      break;
+    case 2:
+      list.Add (aodv, 100);
+      m_protocolName = "AODV";
+      break;
+    case 3:
+      list.Add (dsdv, 100);
+      m_protocolName = "DSDV";
+      break;
+    case 4:
+      // setup is after the stack installation
+      m_protocolName = "DSR";
+      break;
+    case 5:
+      // every node sends to the base on the one /16 subnet: the on-link
+      // route address assignment installs is all the routing needed
+      m_protocolName = "STATIC";
+      break;
+    default:
+      NS_FATAL_ERROR ("No such protocol:" << m_protocol);
+      break;
+    }
 
-  FileHandle* m_fh;
-};
+  if (m_protocol >= 1 && m_protocol <= 3)
+    {
+      stack.SetRoutingHelper (list);
+    }
+  else if (m_protocol == 5)
+    {
+      stack.SetRoutingHelper (staticRouting);
+    }
+  stack.Install (c);
+  if (m_protocol == 4)
+    {
+      dsrMain.Install (dsr, c);
+    }
 
-Experiment::Experiment()
- :m_port (9),
-    m_CSVfileName ("experiment.output.csv"),
-    m_CSVfileName2 ("experiment.output2.csv"),
-    m_nSinks (5),
-    m_protocolName ("protocol"),
-    m_traceMobility (false),
-    // Differnt Routing Protocls
-    m_protocol (2),
-    // Different Loss models
-    m_lossModel (4),
-    m_fading (0),
-    m_lossModelName (""),
-    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
-    m_mobility (2),
-    m_nNodes (10),
-    m_nBase(1),
-    m_TotalSimTime (300),
-    //OnoffApplication frequency
-    m_rate ("2048bps"),
-    m_trName ("experiment-compare"),
-    m_nodeSpeed (50),
-    m_nodePause (0),
-    m_verbose (0),
-    m_macMode (1),
-    m_routingTables (0),
-    m_asciiTrace (0),
-    m_pcap (0),
-    m_log (1),
-    m_streamIndex (0),
-    m_TxNodes (),
-    m_exp (""),
-    m_cumulativeCaptureStart (0),
-    m_freq(5.8e9),
-    m_baseAntennaHeight(50),
-    m_nodeAntennaHeight(9),
-    m_baseAntennaGain(18.6),
-    m_nodeAntennaGain(14.6),
-    m_allNodes(),
-    m_txp(40000),
-    m_guardTime(100),
-    m_interFrameTime(0),
-    m_slotTime(1100),
-    m_packetSize(64),
-    m_yPos(30000),
-    m_scenario(0)  
-{
-  m_routingHelper = CreateObject<RoutingHelper> ();
-  m_log = 1;
+  if (m_protocol != 0 && m_protocol != 5)
+    {
+      // global and static routing send no control packets
+      for (uint32_t n = 0; n < c.GetN (); n++)
+        {
+          c.Get (n)->GetObject<Ipv4L3Protocol> ()->TraceConnectWithoutContext (
+            "Tx", MakeCallback (&RoutingHelper::Ipv4TxTrace, this));
+        }
+    }
+  if (c.GetN () > 0)
+    {
+      UintegerValue ttl;
+      c.Get (0)->GetObject<Ipv4L3Protocol> ()->GetAttribute ("DefaultTtl", ttl);
+      m_initialTtl = ttl.Get ();
+    }
+  if (m_log != 0)
+    {
+      NS_LOG_UNCOND ("Routing Setup for " << m_protocolName);
+    }
 }
 
-Experiment::Experiment(double yDist,uint32_t mobility,uint32_t nodes,uint32_t macMode,uint32_t lossmodel,double txp,FileHandle* fh)
-:m_port (9),
-    m_CSVfileName ("experiment.output.csv"),
-    m_CSVfileName2 ("experiment.output2.csv"),
-    m_nSinks (5),
-    m_protocolName ("protocol"),
-    m_traceMobility (false),
-    // Differnt Routing Protocls
-    m_protocol (2),
-    // Different Loss models
-    m_lossModel (1),
-    m_fading (0),
-    m_lossModelName (""),
-    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
-    m_mobility (2),
-    m_nNodes (50),
-    m_nBase(1),
-    m_TotalSimTime (300),
-    //OnoffApplication frequency
-    m_rate ("2048bps"),
-    m_trName ("experiment-compare"),
-    m_nodeSpeed (50),
-    m_nodePause (0),
-    m_verbose (0),
-    m_macMode (0),
-    m_routingTables (0),
-    m_asciiTrace (0),
-    m_pcap (0),
-    m_log (1),
-    m_streamIndex (0),
-    m_TxNodes (),
-    m_exp (""),
-    m_cumulativeCaptureStart (0),
-    m_freq(5.8e9),
-    m_baseAntennaHeight(50),
-    m_nodeAntennaHeight(9),
-    m_baseAntennaGain(18.6),
-    m_nodeAntennaGain(14.6),
-    m_allNodes(),
-    m_txp(4),
-    m_guardTime(100),
-    m_interFrameTime(0),
-    m_slotTime(1100),
-    m_packetSize(64),
-    m_yPos(0)     
+void
+RoutingHelper::AssignIpAddresses (NetDeviceContainer & d,
+                                  Ipv4InterfaceContainer & adhocTxInterfaces)
 {
-  m_yPos = yDist;
-  m_mobility = mobility;
-  m_nNodes = nodes;
-  m_macMode = macMode;
-  m_lossModel = m_lossModel;
-  m_txp = txp;
-  m_routingHelper = CreateObject<RoutingHelper> ();
-  m_log = 1;
-  m_fh = fh;
+  NS_LOG_INFO ("Assigning IP addresses");
+  Ipv4AddressHelper addressAdhoc;
+  // we may have a lot of nodes, and want them all
+  // in same subnet, to support broadcast
+  addressAdhoc.SetBase ("10.1.0.0", "255.255.0.0");
+  adhocTxInterfaces = addressAdhoc.Assign (d);
 }
 
-Experiment::Experiment(FileHandle* fh,std::string rate,uint32_t nodes)
-:m_port (9),
-    m_CSVfileName ("experiment.output.csv"),
-    m_CSVfileName2 ("experiment.output2.csv"),
-    m_nSinks (5),
-    m_protocolName ("protocol"),
-    m_traceMobility (false),
-    // Differnt Routing Protocls
-    m_protocol (2),
-    // Different Loss models
-    m_lossModel (4),
-    m_fading (0),
-    m_lossModelName (""),
-    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
-    m_mobility (2),
-    m_nNodes (10),
+void
+RoutingHelper::SetupRoutingMessages (NodeContainer & c,
+                                     Ipv4InterfaceContainer & adhocTxInterfaces)
+{
+  // Setup routing transmissions
+  OnOffHelper onoff1 ("ns3::UdpSocketFactory",Address ());
+  onoff1.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
+  onoff1.SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"));
+
+  Ptr<UniformRandomVariable> var = CreateObject<UniformRandomVariable> ();
+  int64_t stream = 2;
+  var->SetStream (stream);
+
+  // map sender addresses back to node ids for the per-node statistics
+  m_addressBase = adhocTxInterfaces.GetAddress (0).Get ();
+  m_addressNode.clear ();
+  for (uint32_t i = 0; i < adhocTxInterfaces.GetN (); i++)
+    {
+      if (adhocTxInterfaces.GetAddress (i).Get () < m_addressBase)
+        {
+          continue;
+        }
+      uint32_t offset = adhocTxInterfaces.GetAddress (i).Get () - m_addressBase;
+      if (offset >= m_addressNode.size ())
+        {
+          m_addressNode.resize (offset + 1, c.Get (i)->GetId ());
+        }
+      m_addressNode[offset] = c.Get (i)->GetId ();
+    }
+
+  //Use Base Station as Sink
+  Ptr<Socket> sink = SetupRoutingPacketReceive (adhocTxInterfaces.GetAddress (0), c.Get (0));
+  // AddressValue remoteAddress (InetSocketAddress ("10.1.255.255", m_port));
+  // onoff1.SetAttribute("Remote",remoteAddress);
+  // ApplicationContainer baseApp = onoff1.Install (c.Get (0));
+  // baseApp.Start (Seconds (var->GetValue (1.0,2.0)));
+  // baseApp.Stop(Seconds(m_TotalSimTime));
+  AddressValue remoteAddress(InetSocketAddress(adhocTxInterfaces.GetAddress(0),m_port));
+  for (uint32_t i = 1; i < adhocTxInterfaces.GetN(); i++)
+    {
+   
+ 
+      Ptr<Socket> nodeSink = SetupRoutingPacketReceive (adhocTxInterfaces.GetAddress (i), c.Get (i));
+      onoff1.SetAttribute ("Remote", remoteAddress);
+
+      ApplicationContainer temp = onoff1.Install (c.Get (i));
+      temp.Start (Seconds (var->GetValue (1.0,2.0)));
+      temp.Stop (Seconds (m_TotalSimTime));
+    }
+}
+
+static inline void
+PrintReceivedRoutingPacket (std::ostream &os, Ptr<Socket> socket, Ptr<Packet> packet)
+{
+  SocketAddressTag tag;
+  bool found;
+  found = packet->PeekPacketTag (tag);
+
+  os << Simulator::Now ().GetSeconds () << " " << socket->GetNode ()->GetId ();
+
+  if (found)
+    {
+      InetSocketAddress addr = InetSocketAddress::ConvertFrom (tag.GetAddress ());
+      os << " received one packet from " << addr.GetIpv4 ();
+    }
+  else
+    {
+      os << " received one packet!";
+    }
+}
+
+void
+RoutingHelper::ReceiveRoutingPacket (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      // application data, for goodput
+      SeqTsHeader seqTs;
+      uint32_t RxRoutingBytes = packet->GetSize ();
+      GetRoutingStats ().IncRxBytes (RxRoutingBytes);
+      packet->RemoveHeader (seqTs);
+      GetRoutingStats ().IncRxPkts ();
+      Time delay = Simulator::Now () - seqTs.GetTs ();
+      GetRoutingStats().IncDelaySum(delay.GetSeconds()); //Transmission Time
+      uint32_t source = InetSocketAddress::ConvertFrom (from).GetIpv4 ().Get ();
+      GetRoutingStats ().RecordReception (source, seqTs.GetSeq (), delay);
+      SocketIpTtlTag ttl;
+      if (packet->PeekPacketTag (ttl) && ttl.GetTtl () <= m_initialTtl)
+        {
+          GetRoutingStats ().RecordHops (m_initialTtl - ttl.GetTtl () + 1);
+        }
+      if (source - m_addressBase < m_addressNode.size ())
+        {
+          m_nodeStats.RecordRx (m_addressNode[source - m_addressBase], RxRoutingBytes,
+                                delay.GetNanoSeconds ());
+        }
+      if (m_eventLog != 0 && m_eventLog->IsOpen ())
+        {
+          SocketAddressTag tag;
+          uint32_t sender = packet->PeekPacketTag (tag)
+            ? InetSocketAddress::ConvertFrom (tag.GetAddress ()).GetIpv4 ().Get () : 0;
+          m_eventLog->Append (EventLog::PACKET_RX, socket->GetNode ()->GetId (), sender);
+        }
+      else if (m_log != 0)
+        {
+          // straight into the log stream, without building a string per packet
+          std::clog << m_protocolName << " ";
+          PrintReceivedRoutingPacket (std::clog, socket, packet);
+          std::clog << '\n';
+        }
+
+      GetRoutingStats().SetLastRxTime(Simulator::Now());
+    }
+}
+
+void
+RoutingHelper::OnOffTrace (uint32_t node, uint32_t, Ptr<const Packet> packet)
+{
+  uint32_t pktBytes = packet->GetSize ();
+
+    // the interval counters are reset by the throughput sampler
+    if(routingStats.GetCumulativeTxPkts() == 0){
+      routingStats.SetFirstTxTime(Simulator::Now());
+    }
+    routingStats.IncTxBytes (pktBytes);
+    routingStats.IncTxPkts();
+    m_nodeStats.RecordTx (node, pktBytes);
+    if (m_eventLog != 0 && m_eventLog->IsOpen ())
+      {
+        m_eventLog->Append (EventLog::PACKET_TX, node, pktBytes);
+      }
+    
+}
+
+void
+RoutingHelper::Ipv4TxTrace (Ptr<const Packet> packet, Ptr<Ipv4>, uint32_t)
+{
+  Ipv4Header ipHeader;
+  packet->PeekHeader (ipHeader);
+  // the first bytes after the IPv4 header, read in place: no packet copy
+  // and no header objects per packet
+  uint32_t offset = ipHeader.GetSerializedSize ();
+  uint8_t bytes[64];
+  if (packet->GetSize () < offset + 4 || offset + 4 > sizeof (bytes))
+    {
+      return;
+    }
+  packet->CopyData (bytes, offset + 4);
+  const uint8_t *payload = bytes + offset;
+  bool control = false;
+  if (ipHeader.GetProtocol () == UdpL4Protocol::PROT_NUMBER)
+    {
+      // the UDP destination port
+      control = (uint32_t) ((payload[2] << 8) | payload[3]) != m_port;
+    }
+  else if (ipHeader.GetProtocol () == dsr::DsrRouting::PROT_NUMBER)
+    {
+      // DSR carries data and control alike; the message type of its fixed
+      // header (after the next-header byte) tells them apart
+      control = payload[1] == 1;
+    }
+  if (control)
+    {
+      routingStats.IncControlTx (packet->GetSize ());
+    }
+}
+
+std::string
+RoutingHelper::GetProtocolName () const
+{
+  return m_protocolName;
+}
+
+RoutingStats &
+RoutingHelper::GetRoutingStats ()
+{
+  return routingStats;
+}
+
+NodeStatsTable &
+RoutingHelper::GetNodeStats ()
+{
+  return m_nodeStats;
+}
+
+void
+RoutingHelper::SetLogging (int log)
+{
+  m_log = log;
+}
+
+void
+RoutingHelper::SetEventLog (EventLog *log)
+{
+  m_eventLog = log;
+}
+
+
+/**
+ * Typed column layout of the rows an Experiment scenario (m_scenario 0-3)
+ * reports.  The CSV header, the columnar binary files and the CSV parser
+ * used to merge worker output are all derived from it.
+ */
+class ResultSchema
+{
+public:
+  enum ColumnType
+  {
+    UINTEGER = 0, // uint64_t
+    INTEGER = 1,  // int64_t
+    DOUBLE = 2,   // double
+    DATARATE = 3  // uint64_t bit/s, written as "<n>bps" in CSV
+  };
+
+  /**
+   * \brief Constructor
+   * \param name schema name stored in binary files
+   * \return none
+   */
+  ResultSchema (std::string name = "");
+
+  /**
+   * \brief Appends a column
+   * \param name column name, also the CSV header field
+   * \param type value type
+   * \return none
+   */
+  void AddColumn (std::string name, ColumnType type);
+
+  /**
+   * \brief Returns the number of columns
+   * \return the number of columns
+   */
+  uint32_t GetN () const;
+
+  /**
+   * \brief Returns the index of a column
+   * \param name the column name
+   * \return the column index, or -1 if there is no such column
+   */
+  int32_t GetIndex (std::string name) const;
+
+  std::string GetName () const;
+
+  std::string GetColumnName (uint32_t i) const;
+
+  ColumnType GetColumnType (uint32_t i) const;
+
+  /**
+   * \brief Returns the CSV header line
+   * \return the comma separated column names
+   */
+  std::string GetCsvHeader () const;
+
+  /**
+   * \brief Returns the row layout of an Experiment scenario
+   * \param scenario the m_scenario value
+   * \return the schema
+   */
+  static ResultSchema ForScenario (uint32_t scenario);
+
+  /**
+   * \brief Returns whether a column holds a parameter of the run (n_nodes,
+   * rate, ...) rather than a measurement
+   * \param name the column name
+   * \return true for a parameter column
+   */
+  static bool IsParameter (std::string name);
+
+  /**
+   * \brief Returns the layout of rows summarizing replications of runs
+   * with another layout: parameter columns are copied through, every
+   * measured column holds the mean over the replications and gains
+   * <name>_sd and <name>_ci95 (standard deviation and 95% confidence
+   * interval half-width) columns, followed by the number of replications
+   * \param schema the layout of the replications
+   * \return the schema
+   */
+  static ResultSchema WithReplications (const ResultSchema &schema);
+
+private:
+  std::string m_name;
+  std::vector<std::string> m_columns;
+  std::vector<ColumnType> m_types;
+};
+
+ResultSchema::ResultSchema (std::string name)
+  : m_name (name)
+{
+}
+
+void
+ResultSchema::AddColumn (std::string name, ColumnType type)
+{
+  m_columns.push_back (name);
+  m_types.push_back (type);
+}
+
+uint32_t
+ResultSchema::GetN () const
+{
+  return m_columns.size ();
+}
+
+int32_t
+ResultSchema::GetIndex (std::string name) const
+{
+  for (uint32_t i = 0; i < m_columns.size (); i++)
+    {
+      if (m_columns[i] == name)
+        {
+          return i;
+        }
+    }
+  return -1;
+}
+
+std::string
+ResultSchema::GetName () const
+{
+  return m_name;
+}
+
+std::string
+ResultSchema::GetColumnName (uint32_t i) const
+{
+  return m_columns[i];
+}
+
+ResultSchema::ColumnType
+ResultSchema::GetColumnType (uint32_t i) const
+{
+  return m_types[i];
+}
+
+std::string
+ResultSchema::GetCsvHeader () const
+{
+  std::ostringstream oss;
+  for (uint32_t i = 0; i < m_columns.size (); i++)
+    {
+      oss << (i > 0 ? "," : "") << m_columns[i];
+    }
+  return oss.str ();
+}
+
+ResultSchema
+ResultSchema::ForScenario (uint32_t scenario)
+{
+  std::ostringstream name;
+  name << "scenario" << scenario;
+  ResultSchema schema (name.str ());
+  schema.AddColumn ("n_nodes", UINTEGER);
+  schema.AddColumn ("throughput", DOUBLE);
+  schema.AddColumn ("delay", DOUBLE);
+  if (scenario == 1)
+    {
+      // node count vs. offered rate
+      schema.AddColumn ("packetRx", UINTEGER);
+      schema.AddColumn ("rate", DATARATE);
+    }
+  else if (scenario == 2)
+    {
+      // TDMA slot/guard time
+      schema.AddColumn ("packetLoss", INTEGER);
+      schema.AddColumn ("slotTime", INTEGER);
+      schema.AddColumn ("guardTime", INTEGER);
+    }
+  else if (scenario == 3)
+    {
+      // TDMA slot time vs. packet size
+      schema.AddColumn ("slotTime", INTEGER);
+      schema.AddColumn ("packetSize", UINTEGER);
+    }
+  else
+    {
+      schema.AddColumn ("packetRx", UINTEGER);
+      schema.AddColumn ("packetLoss", INTEGER);
+    }
+  schema.AddColumn ("pdr", DOUBLE);
+  // delay/jitter distribution (seconds) and sequence number accounting
+  schema.AddColumn ("delayP50", DOUBLE);
+  schema.AddColumn ("delayP95", DOUBLE);
+  schema.AddColumn ("delayP99", DOUBLE);
+  schema.AddColumn ("delayMax", DOUBLE);
+  schema.AddColumn ("jitterP50", DOUBLE);
+  schema.AddColumn ("jitterP95", DOUBLE);
+  schema.AddColumn ("jitterP99", DOUBLE);
+  schema.AddColumn ("jitterMax", DOUBLE);
+  schema.AddColumn ("seqGaps", UINTEGER);
+  schema.AddColumn ("reordered", UINTEGER);
+  // per-node fairness: Jain's index and the range of delivery ratios (%)
+  schema.AddColumn ("jainIndex", DOUBLE);
+  schema.AddColumn ("minDelivery", DOUBLE);
+  schema.AddColumn ("maxDelivery", DOUBLE);
+  // the warm-up (WarmupTrim, with a SampleWindow) and throughput, delay
+  // and pdr after it, when the run stopped (seconds) and the batch-means
+  // 95% CI half-widths of the *Steady columns.  Only the *Steady columns
+  // are trimmed; every other column covers the whole run
+  schema.AddColumn ("warmupTime", DOUBLE);
+  schema.AddColumn ("throughputSteady", DOUBLE);
+  schema.AddColumn ("delaySteady", DOUBLE);
+  schema.AddColumn ("pdrSteady", DOUBLE);
+  schema.AddColumn ("stopTime", DOUBLE);
+  schema.AddColumn ("throughputCi", DOUBLE);
+  schema.AddColumn ("delayCi", DOUBLE);
+  schema.AddColumn ("pdrCi", DOUBLE);
+  // routing protocol (0=global, 1=OLSR, 2=AODV, 3=DSDV, 4=DSR, 5=static), control
+  // packets/bytes sent, control bytes per data byte delivered, and the
+  // average hop count of the data packets delivered
+  schema.AddColumn ("protocol", UINTEGER);
+  schema.AddColumn ("controlPkts", UINTEGER);
+  schema.AddColumn ("controlBytes", UINTEGER);
+  schema.AddColumn ("overheadRatio", DOUBLE);
+  schema.AddColumn ("avgHops", DOUBLE);
+  return schema;
+}
+
+bool
+ResultSchema::IsParameter (std::string name)
+{
+  return name == "n_nodes" || name == "rate" || name == "slotTime" || name == "guardTime"
+         || name == "packetSize" || name == "protocol";
+}
+
+ResultSchema
+ResultSchema::WithReplications (const ResultSchema &schema)
+{
+  ResultSchema summary (schema.GetName () + "-replicated");
+  for (uint32_t i = 0; i < schema.GetN (); i++)
+    {
+      // means of counters are fractional; rates stay rates
+      bool keepType = IsParameter (schema.GetColumnName (i)) || schema.GetColumnType (i) == DATARATE;
+      summary.AddColumn (schema.GetColumnName (i), keepType ? schema.GetColumnType (i) : DOUBLE);
+    }
+  for (uint32_t i = 0; i < schema.GetN (); i++)
+    {
+      if (IsParameter (schema.GetColumnName (i)))
+        {
+          continue;
+        }
+      summary.AddColumn (schema.GetColumnName (i) + "_sd", DOUBLE);
+      summary.AddColumn (schema.GetColumnName (i) + "_ci95", DOUBLE);
+    }
+  summary.AddColumn ("replications", UINTEGER);
+  return summary;
+}
+
+/**
+ * One output row, with its values stored in schema order.  Setting a column
+ * the schema does not have is a no-op, so ProcessOutputs can set every
+ * metric and let the scenario's schema pick the ones it reports.
+ */
+class ResultRow
+{
+public:
+  union Value
+  {
+    uint64_t u;
+    int64_t i;
+    double d;
+  };
+
+  /**
+   * \brief Constructor; all values start at zero
+   * \param schema the row layout
+   * \return none
+   */
+  ResultRow (const ResultSchema &schema);
+
+  bool SetUinteger (std::string name, uint64_t value);
+
+  bool SetInteger (std::string name, int64_t value);
+
+  bool SetDouble (std::string name, double value);
+
+  /**
+   * \brief Sets a DATARATE column from an ns-3 data rate string
+   * \param name the column name
+   * \param rate the data rate, e.g. "2048bps"
+   * \return true if the schema has the column
+   */
+  bool SetDataRate (std::string name, std::string rate);
+
+  const ResultSchema & GetSchema () const;
+
+  Value Get (uint32_t i) const;
+
+  /**
+   * \brief Formats the row as a CSV line (without newline)
+   * \return the CSV line
+   */
+  std::string ToCsv () const;
+
+  /**
+   * \brief Parses a CSV line written by ToCsv
+   * \param line the CSV line
+   * \return true if the line has one valid field per column
+   */
+  bool FromCsv (std::string line);
+
+private:
+  ResultSchema m_schema;
+  std::vector<Value> m_values;
+};
+
+ResultRow::ResultRow (const ResultSchema &schema)
+  : m_schema (schema)
+{
+  Value zero;
+  zero.u = 0;
+  m_values.assign (schema.GetN (), zero);
+}
+
+bool
+ResultRow::SetUinteger (std::string name, uint64_t value)
+{
+  int32_t i = m_schema.GetIndex (name);
+  if (i < 0)
+    {
+      return false;
+    }
+  NS_ASSERT (m_schema.GetColumnType (i) == ResultSchema::UINTEGER);
+  m_values[i].u = value;
+  return true;
+}
+
+bool
+ResultRow::SetInteger (std::string name, int64_t value)
+{
+  int32_t i = m_schema.GetIndex (name);
+  if (i < 0)
+    {
+      return false;
+    }
+  NS_ASSERT (m_schema.GetColumnType (i) == ResultSchema::INTEGER);
+  m_values[i].i = value;
+  return true;
+}
+
+bool
+ResultRow::SetDouble (std::string name, double value)
+{
+  int32_t i = m_schema.GetIndex (name);
+  if (i < 0)
+    {
+      return false;
+    }
+  NS_ASSERT (m_schema.GetColumnType (i) == ResultSchema::DOUBLE);
+  m_values[i].d = value;
+  return true;
+}
+
+bool
+ResultRow::SetDataRate (std::string name, std::string rate)
+{
+  int32_t i = m_schema.GetIndex (name);
+  if (i < 0)
+    {
+      return false;
+    }
+  NS_ASSERT (m_schema.GetColumnType (i) == ResultSchema::DATARATE);
+  m_values[i].u = DataRate (rate).GetBitRate ();
+  return true;
+}
+
+const ResultSchema &
+ResultRow::GetSchema () const
+{
+  return m_schema;
+}
+
+ResultRow::Value
+ResultRow::Get (uint32_t i) const
+{
+  return m_values[i];
+}
+
+std::string
+ResultRow::ToCsv () const
+{
+  std::ostringstream oss;
+  // round-trips through FromCsv: rows reach the columnar files, the sweep
+  // summaries and the result cache by way of this text
+  oss.precision (std::numeric_limits<double>::max_digits10);
+  for (uint32_t i = 0; i < m_values.size (); i++)
+    {
+      if (i > 0)
+        {
+          oss << ",";
+        }
+      switch (m_schema.GetColumnType (i))
+        {
+        case ResultSchema::UINTEGER:
+          oss << m_values[i].u;
+          break;
+        case ResultSchema::INTEGER:
+          oss << m_values[i].i;
+          break;
+        case ResultSchema::DOUBLE:
+          oss << m_values[i].d;
+          break;
+        case ResultSchema::DATARATE:
+          oss << m_values[i].u << "bps";
+          break;
+        }
+    }
+  return oss.str ();
+}
+
+bool
+ResultRow::FromCsv (std::string line)
+{
+  std::istringstream iss (line);
+  std::string field;
+  uint32_t i = 0;
+  while (std::getline (iss, field, ','))
+    {
+      if (i >= m_values.size () || field.empty ())
+        {
+          return false;
+        }
+      char *end = 0;
+      switch (m_schema.GetColumnType (i))
+        {
+        case ResultSchema::UINTEGER:
+        case ResultSchema::DATARATE:
+          m_values[i].u = std::strtoull (field.c_str (), &end, 10);
+          break;
+        case ResultSchema::INTEGER:
+          m_values[i].i = std::strtoll (field.c_str (), &end, 10);
+          break;
+        case ResultSchema::DOUBLE:
+          m_values[i].d = std::strtod (field.c_str (), &end);
+          break;
+        }
+      if (end == field.c_str ())
+        {
+          return false;
+        }
+      i++;
+    }
+  return i == m_values.size ();
+}
+
+/**
+ * Columnar binary result file.  Layout (host byte order):
+ *
+ *   64-byte header: magic "NS3SWPC\0", uint32 version, uint32 column
+ *     count, uint64 row count, uint64 row capacity, char[32] schema name
+ *   one 64-byte descriptor per column: char[48] name, uint32 type
+ *     (ResultSchema::ColumnType), uint32 value width (8), uint64 offset
+ *   the columns, each an array of `capacity` 8-byte values starting at
+ *     its (64-byte aligned) offset
+ *
+ * A reader mmaps the file and reads the first `row count` values of each
+ * column.  The writer works on a shared mapping, stores the values of a row
+ * before bumping the row count, and doubles the capacity (moving the
+ * columns in place) when the file is full.
+ */
+class ColumnarWriter
+{
+public:
+  /**
+   * \brief Creates (truncates) a columnar file
+   * \param filename the file name
+   * \param schema the row layout
+   * \return none
+   */
+  ColumnarWriter (std::string filename, const ResultSchema &schema);
+
+  /**
+   * \brief Destructor; closes the file
+   * \return none
+   */
+  ~ColumnarWriter ();
+
+  /**
+   * \brief Appends a row, which must use the writer's schema
+   * \param row the row
+   * \return none
+   */
+  void Append (const ResultRow &row);
+
+  void Close ();
+
+  /**
+   * \brief Converts a columnar file to CSV
+   * \param filename the columnar file
+   * \param csvFilename the CSV file to write
+   * \return true on success
+   */
+  static bool ConvertToCsv (std::string filename, std::string csvFilename);
+
+private:
+  struct FileHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t nColumns;
+    uint64_t nRows;
+    uint64_t capacity;
+    char schema[32];
+  };
+
+  struct ColumnDescriptor
+  {
+    char name[48];
+    uint32_t type;
+    uint32_t width;
+    uint64_t offset;
+  };
+
+  static uint64_t GetColumnOffset (uint32_t nColumns, uint64_t capacity, uint32_t column);
+
+  void Map (uint64_t capacity);
+
+  void Grow ();
+
+  FileHeader * GetHeader ();
+
+  ColumnDescriptor * GetColumn (uint32_t i);
+
+  std::string m_filename;
+  ResultSchema m_schema;
+  int m_fd;
+  char *m_map;
+  size_t m_mapSize;
+
+  static const char MAGIC[8];
+  static const uint32_t VERSION = 1;
+  static const uint64_t INITIAL_CAPACITY = 1024;
+};
+
+const char ColumnarWriter::MAGIC[8] = { 'N', 'S', '3', 'S', 'W', 'P', 'C', '\0' };
+
+ColumnarWriter::ColumnarWriter (std::string filename, const ResultSchema &schema)
+  : m_filename (filename),
+    m_schema (schema),
+    m_fd (-1),
+    m_map (0),
+    m_mapSize (0)
+{
+  m_fd = open (filename.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (m_fd < 0)
+    {
+      NS_FATAL_ERROR ("Cannot create " << filename << ": " << std::strerror (errno));
+    }
+  Map (INITIAL_CAPACITY);
+  FileHeader *header = GetHeader ();
+  std::memcpy (header->magic, MAGIC, sizeof (header->magic));
+  header->version = VERSION;
+  header->nColumns = schema.GetN ();
+  header->nRows = 0;
+  header->capacity = INITIAL_CAPACITY;
+  std::strncpy (header->schema, schema.GetName ().c_str (), sizeof (header->schema) - 1);
+  for (uint32_t i = 0; i < schema.GetN (); i++)
+    {
+      ColumnDescriptor *column = GetColumn (i);
+      std::strncpy (column->name, schema.GetColumnName (i).c_str (), sizeof (column->name) - 1);
+      column->type = schema.GetColumnType (i);
+      column->width = sizeof (ResultRow::Value);
+      column->offset = GetColumnOffset (schema.GetN (), INITIAL_CAPACITY, i);
+    }
+}
+
+ColumnarWriter::~ColumnarWriter ()
+{
+  Close ();
+}
+
+uint64_t
+ColumnarWriter::GetColumnOffset (uint32_t nColumns, uint64_t capacity, uint32_t column)
+{
+  uint64_t dataStart = sizeof (FileHeader) + nColumns * sizeof (ColumnDescriptor);
+  dataStart = (dataStart + 63) & ~(uint64_t) 63;
+  return dataStart + column * capacity * sizeof (ResultRow::Value);
+}
+
+void
+ColumnarWriter::Map (uint64_t capacity)
+{
+  if (m_map != 0)
+    {
+      munmap (m_map, m_mapSize);
+      m_map = 0;
+    }
+  m_mapSize = GetColumnOffset (m_schema.GetN (), capacity, m_schema.GetN ());
+  if (ftruncate (m_fd, m_mapSize) != 0)
+    {
+      NS_FATAL_ERROR ("Cannot grow " << m_filename << ": " << std::strerror (errno));
+    }
+  void *map = mmap (0, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (map == MAP_FAILED)
+    {
+      NS_FATAL_ERROR ("Cannot map " << m_filename << ": " << std::strerror (errno));
+    }
+  m_map = (char *) map;
+}
+
+ColumnarWriter::FileHeader *
+ColumnarWriter::GetHeader ()
+{
+  return (FileHeader *) m_map;
+}
+
+ColumnarWriter::ColumnDescriptor *
+ColumnarWriter::GetColumn (uint32_t i)
+{
+  return (ColumnDescriptor *)(m_map + sizeof (FileHeader)) + i;
+}
+
+void
+ColumnarWriter::Grow ()
+{
+  uint64_t nRows = GetHeader ()->nRows;
+  uint64_t capacity = GetHeader ()->capacity * 2;
+  Map (capacity);
+  // columns only move towards the end of the file, so moving the last one
+  // first never overwrites data that has not been moved yet
+  for (uint32_t i = m_schema.GetN (); i-- > 0; )
+    {
+      ColumnDescriptor *column = GetColumn (i);
+      uint64_t offset = GetColumnOffset (m_schema.GetN (), capacity, i);
+      std::memmove (m_map + offset, m_map + column->offset, nRows * column->width);
+      column->offset = offset;
+    }
+  GetHeader ()->capacity = capacity;
+}
+
+void
+ColumnarWriter::Append (const ResultRow &row)
+{
+  NS_ASSERT (m_map != 0);
+  NS_ASSERT (row.GetSchema ().GetCsvHeader () == m_schema.GetCsvHeader ());
+  FileHeader *header = GetHeader ();
+  if (header->nRows == header->capacity)
+    {
+      Grow ();
+      header = GetHeader ();
+    }
+  for (uint32_t i = 0; i < m_schema.GetN (); i++)
+    {
+      ResultRow::Value value = row.Get (i);
+      std::memcpy (m_map + GetColumn (i)->offset + header->nRows * sizeof (value),
+                   &value, sizeof (value));
+    }
+  header->nRows++;
+}
+
+void
+ColumnarWriter::Close ()
+{
+  if (m_map != 0)
+    {
+      msync (m_map, m_mapSize, MS_SYNC);
+      munmap (m_map, m_mapSize);
+      m_map = 0;
+    }
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+      m_fd = -1;
+    }
+}
+
+bool
+ColumnarWriter::ConvertToCsv (std::string filename, std::string csvFilename)
+{
+  int fd = open (filename.c_str (), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (FileHeader))
+    {
+      NS_LOG_ERROR ("Cannot read " << filename);
+      if (fd >= 0)
+        {
+          close (fd);
+        }
+      return false;
+    }
+  void *map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      NS_LOG_ERROR ("Cannot map " << filename);
+      return false;
+    }
+  const char *base = (const char *) map;
+  const FileHeader *header = (const FileHeader *) base;
+  bool ok = std::memcmp (header->magic, MAGIC, sizeof (MAGIC)) == 0
+    && header->version == VERSION
+    && (uint64_t) st.st_size >= GetColumnOffset (header->nColumns, header->capacity, header->nColumns);
+  if (!ok)
+    {
+      NS_LOG_ERROR (filename << " is not a columnar result file");
+      munmap (map, st.st_size);
+      return false;
+    }
+
+  ResultSchema schema (std::string (header->schema, strnlen (header->schema, sizeof (header->schema))));
+  const ColumnDescriptor *columns = (const ColumnDescriptor *)(base + sizeof (FileHeader));
+  for (uint32_t i = 0; i < header->nColumns; i++)
+    {
+      schema.AddColumn (std::string (columns[i].name, strnlen (columns[i].name, sizeof (columns[i].name))),
+                        (ResultSchema::ColumnType) columns[i].type);
+    }
+
+  std::ofstream csv (csvFilename.c_str ());
+  csv << schema.GetCsvHeader () << "\n";
+  ResultRow row (schema);
+  for (uint64_t r = 0; r < header->nRows; r++)
+    {
+      for (uint32_t i = 0; i < header->nColumns; i++)
+        {
+          ResultRow::Value value;
+          std::memcpy (&value, base + columns[i].offset + r * sizeof (value), sizeof (value));
+          switch (schema.GetColumnType (i))
+            {
+            case ResultSchema::UINTEGER:
+              row.SetUinteger (schema.GetColumnName (i), value.u);
+              break;
+            case ResultSchema::INTEGER:
+              row.SetInteger (schema.GetColumnName (i), value.i);
+              break;
+            case ResultSchema::DOUBLE:
+              row.SetDouble (schema.GetColumnName (i), value.d);
+              break;
+            case ResultSchema::DATARATE:
+              {
+                std::ostringstream rate;
+                rate << value.u << "bps";
+                row.SetDataRate (schema.GetColumnName (i), rate.str ());
+              }
+              break;
+            }
+        }
+      csv << row.ToCsv () << "\n";
+    }
+  munmap (map, st.st_size);
+  return csv.good ();
+}
+
+/**
+ * Long-lived, buffered CSV sink.  The file is opened once (truncated by
+ * WriteHeader, appended to otherwise) and rows are collected in a
+ * fixed-size buffer that is written out when it fills, on Flush(), on
+ * Close() and on destruction.  Open handles are also flushed at exit and
+ * when the process dies from SIGINT, SIGTERM, SIGHUP or SIGABRT, so an
+ * interrupted sweep keeps every completed row.
+ *
+ * With EnableColumnar, every row written through WriteRow or merged with
+ * AppendFile is also stored in a columnar binary file.
+ */
+class FileHandle{
+  public:
+    std::string m_filename;
+
+    FileHandle(std::string filename, size_t bufferSize = 64 * 1024);
+
+    ~FileHandle();
+
+    void WriteHeader(std::string string);
+
+    void WriteData(std::string string);
+
+    /**
+     * \brief Writes a typed row as CSV, and to the columnar file if enabled
+     * \param row the row
+     * \return none
+     */
+    void WriteRow(const ResultRow& row);
+
+    /**
+     * \brief Also stores the rows of this file in a columnar binary file
+     * \param schema the layout of the rows
+     * \param filename the columnar file, truncated
+     * \return none
+     */
+    void EnableColumnar(const ResultSchema& schema, std::string filename);
+
+    /**
+     * \brief Appends the raw contents of another file (e.g. the rows a
+     * sweep worker wrote for one point) to this file
+     * \param filename the file to copy from
+     * \return true if the file exists and is not empty
+     */
+    bool AppendFile(std::string filename);
+
+    /**
+     * \brief Writes buffered rows to the file (a checkpoint)
+     * \return none
+     */
+    void Flush();
+
+    /**
+     * \brief Changes the buffer size; buffered rows are flushed first
+     * \param bufferSize the buffer size in bytes (0 writes through)
+     * \return none
+     */
+    void SetBufferSize(size_t bufferSize);
+
+    void Close();
+
+    /**
+     * \brief Flushes every open handle.  Only uses write(2), so it may be
+     * called from a signal handler.
+     * \return none
+     */
+    static void FlushAll();
+
+  private:
+    FileHandle(const FileHandle &);
+    FileHandle & operator=(const FileHandle &);
+
+    void Open(int flags);
+
+    void Buffer(const char* data, size_t size);
+
+    void WriteThrough(const char* data, size_t size);
+
+    static void HandleSignal(int signum);
+
+    static void HandleExit();
+
+    int m_fd;
+    std::vector<char> m_buffer;
+    // only advanced once a whole row has been copied in, so a flush from a
+    // signal handler never writes half a row
+    volatile size_t m_used;
+    FileHandle* m_nextOpen;
+    ResultSchema m_schema;
+    ColumnarWriter* m_columnar;
+
+    static FileHandle* s_openHandles;
+    static bool s_handlersInstalled;
+};
+
+FileHandle* FileHandle::s_openHandles = 0;
+bool FileHandle::s_handlersInstalled = false;
+
+FileHandle::FileHandle(std::string filename, size_t bufferSize)
+  : m_filename(filename),
+    m_fd(-1),
+    m_buffer(bufferSize),
+    m_used(0),
+    m_nextOpen(0),
+    m_columnar(0)
+{
+}
+
+FileHandle::~FileHandle(){
+  Close();
+  delete m_columnar;
+}
+
+void FileHandle::Open(int flags){
+  Close();
+  m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | flags, 0644);
+  if(m_fd < 0){
+    NS_LOG_ERROR("Cannot open " << m_filename << ": " << std::strerror(errno));
+    return;
+  }
+  if(!s_handlersInstalled){
+    s_handlersInstalled = true;
+    std::atexit(&FileHandle::HandleExit);
+    signal(SIGINT, &FileHandle::HandleSignal);
+    signal(SIGTERM, &FileHandle::HandleSignal);
+    signal(SIGHUP, &FileHandle::HandleSignal);
+    signal(SIGABRT, &FileHandle::HandleSignal);
+  }
+  m_nextOpen = s_openHandles;
+  s_openHandles = this;
+}
+
+void FileHandle::WriteHeader(std::string string){
+  Open(O_TRUNC);
+  Buffer(string.c_str(), string.size());
+}
+
+void FileHandle::WriteData(std::string string){
+  if(m_fd < 0){
+    Open(0);
+  }
+  Buffer(string.c_str(), string.size());
+}
+
+void FileHandle::WriteRow(const ResultRow& row){
+  WriteData(row.ToCsv());
+  if(m_columnar != 0){
+    m_columnar->Append(row);
+  }
+}
+
+void FileHandle::EnableColumnar(const ResultSchema& schema, std::string filename){
+  delete m_columnar;
+  m_schema = schema;
+  m_columnar = new ColumnarWriter(filename, schema);
+}
+
+bool FileHandle::AppendFile(std::string filename){
+  std::ifstream in(filename.c_str(),std::ios::binary);
+  if(!in.is_open() || in.peek() == std::ifstream::traits_type::eof()){
+    return false;
+  }
+  if(m_fd < 0){
+    Open(0);
+  }
+  Flush();
+  char chunk[8192];
+  while(in.read(chunk, sizeof(chunk)) || in.gcount() > 0){
+    WriteThrough(chunk, in.gcount());
+  }
+  if(m_columnar != 0){
+    // the appended rows were written by WriteRow in another process
+    in.clear();
+    in.seekg(0);
+    std::string line;
+    ResultRow row(m_schema);
+    while(std::getline(in, line)){
+      if(row.FromCsv(line)){
+        m_columnar->Append(row);
+      }
+      else if(!line.empty()){
+        NS_LOG_ERROR("Cannot parse row \"" << line << "\" of " << filename);
+      }
+    }
+  }
+  return true;
+}
+
+void FileHandle::Buffer(const char* data, size_t size){
+  // every row ends with a newline, as std::endl used to add
+  if(m_used + size + 1 > m_buffer.size()){
+    Flush();
+    if(size + 1 > m_buffer.size()){
+      WriteThrough(data, size);
+      WriteThrough("\n", 1);
+      return;
+    }
+  }
+  std::memcpy(&m_buffer[m_used], data, size);
+  m_buffer[m_used + size] = '\n';
+  m_used = m_used + size + 1;
+}
+
+void FileHandle::WriteThrough(const char* data, size_t size){
+  while(size > 0 && m_fd >= 0){
+    ssize_t n = write(m_fd, data, size);
+    if(n < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      return;
+    }
+    data += n;
+    size -= n;
+  }
+}
+
+void FileHandle::Flush(){
+  if(m_used > 0){
+    WriteThrough(&m_buffer[0], m_used);
+    m_used = 0;
+  }
+}
+
+void FileHandle::SetBufferSize(size_t bufferSize){
+  Flush();
+  m_buffer.resize(bufferSize);
+}
+
+void FileHandle::Close(){
+  if(m_fd < 0){
+    return;
+  }
+  Flush();
+  close(m_fd);
+  m_fd = -1;
+  for(FileHandle** h = &s_openHandles; *h != 0; h = &(*h)->m_nextOpen){
+    if(*h == this){
+      *h = m_nextOpen;
+      break;
+    }
+  }
+  m_nextOpen = 0;
+}
+
+void FileHandle::FlushAll(){
+  for(FileHandle* h = s_openHandles; h != 0; h = h->m_nextOpen){
+    h->Flush();
+  }
+}
+
+void FileHandle::HandleSignal(int signum){
+  FlushAll();
+  signal(signum, SIG_DFL);
+  raise(signum);
+}
+
+void FileHandle::HandleExit(){
+  FlushAll();
+}
+
+
+
+/**
+ * One throughput sample: the interval counters of RoutingStats over one
+ * sampling window.
+ */
+struct ThroughputSample
+{
+  double time; // end of the window, in seconds
+  double window; // length of the window, in seconds; the last may be partial
+  uint64_t rxBytes;
+  uint64_t rxPkts;
+  uint64_t txBytes;
+  uint64_t txPkts;
+  double delaySum; // seconds
+};
+
+/**
+ * Fixed-capacity ring buffer of throughput samples.  The storage is
+ * allocated up front, so sampling during the run never allocates; once
+ * full, the oldest samples are overwritten.
+ */
+class ThroughputSeries
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  ThroughputSeries ();
+
+  /**
+   * \brief Preallocates the buffer and drops all samples
+   * \param capacity the number of samples kept
+   * \return none
+   */
+  void Reserve (uint32_t capacity);
+
+  /**
+   * \brief Records a sample
+   * \param sample the sample
+   * \return none
+   */
+  void Add (const ThroughputSample &sample);
+
+  /**
+   * \brief Returns the number of samples kept
+   * \return the number of samples
+   */
+  uint32_t GetN () const;
+
+  /**
+   * \brief Returns a sample, oldest first
+   * \param i the sample index
+   * \return the sample
+   */
+  const ThroughputSample & Get (uint32_t i) const;
+
+  /**
+   * \brief Writes the samples as a CSV time series
+   * \param filename the file to (over)write
+   * \return none
+   */
+  void WriteCsv (std::string filename) const;
+
+private:
+  std::vector<ThroughputSample> m_samples;
+  uint32_t m_first;
+  uint32_t m_n;
+};
+
+ThroughputSeries::ThroughputSeries ()
+  : m_first (0),
+    m_n (0)
+{
+}
+
+void
+ThroughputSeries::Reserve (uint32_t capacity)
+{
+  m_samples.resize (std::max (capacity, (uint32_t) 1));
+  m_first = 0;
+  m_n = 0;
+}
+
+void
+ThroughputSeries::Add (const ThroughputSample &sample)
+{
+  NS_ASSERT (!m_samples.empty ());
+  if (m_n < m_samples.size ())
+    {
+      m_samples[(m_first + m_n) % m_samples.size ()] = sample;
+      m_n++;
+    }
+  else
+    {
+      m_samples[m_first] = sample;
+      m_first = (m_first + 1) % m_samples.size ();
+    }
+}
+
+uint32_t
+ThroughputSeries::GetN () const
+{
+  return m_n;
+}
+
+const ThroughputSample &
+ThroughputSeries::Get (uint32_t i) const
+{
+  return m_samples[(m_first + i) % m_samples.size ()];
+}
+
+void
+ThroughputSeries::WriteCsv (std::string filename) const
+{
+  FileHandle fh (filename);
+  fh.WriteHeader ("time,throughput,delay,rxBytes,rxPkts,txBytes,txPkts,pdr");
+  for (uint32_t i = 0; i < m_n; i++)
+    {
+      const ThroughputSample &sample = Get (i);
+      std::ostringstream oss;
+      oss << sample.time << ","
+          << sample.rxBytes * 8.0 / sample.window / 1000 << ","
+          << (sample.rxPkts > 0 ? sample.delaySum / sample.rxPkts : 0.0) << ","
+          << sample.rxBytes << "," << sample.rxPkts << ","
+          << sample.txBytes << "," << sample.txPkts << ","
+          << (sample.txPkts > 0 ? sample.rxPkts * 100.0 / sample.txPkts : 0.0);
+      fh.WriteData (oss.str ());
+    }
+}
+
+/**
+ * Batch-means estimate of a ratio metric (e.g. throughput, mean delay or
+ * PDR over sampling windows) and of the 95% confidence interval of its
+ * mean.  Each sample adds a numerator and a denominator to the current
+ * batch; a batch's mean is the ratio of its sums.  The number of batches is
+ * kept between k and 2k by merging neighbouring batches and doubling the
+ * batch size whenever 2k batches are complete, so the batches grow with the
+ * run and their means become less correlated.
+ */
+class BatchMeans
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  BatchMeans ();
+
+  /**
+   * \brief Drops all samples
+   * \param batches the minimum number of batches k (at least 2)
+   * \return none
+   */
+  void Reset (uint32_t batches);
+
+  /**
+   * \brief Adds a sample
+   * \param numerator the numerator of the sample
+   * \param denominator the denominator of the sample
+   * \return none
+   */
+  void Add (double numerator, double denominator);
+
+  /**
+   * \brief Returns the number of complete batches
+   * \return the number of batches
+   */
+  uint32_t GetNBatches () const;
+
+  /**
+   * \brief Returns the mean of the batch means
+   * \return the mean, NaN without complete batches
+   */
+  double GetMean () const;
+
+  /**
+   * \brief Returns the half-width of the 95% confidence interval of the mean
+   * \return the half-width, NaN with fewer than two batches
+   */
+  double GetHalfWidth () const;
+
+  /**
+   * \brief Returns the half-width relative to the mean
+   * \return the relative half-width, NaN if undefined
+   */
+  double GetRelativeHalfWidth () const;
+
+  /**
+   * \brief Returns the 97.5% quantile of Student's t distribution
+   * \param df degrees of freedom
+   * \return the quantile
+   */
+  static double GetStudentT (uint32_t df);
+
+private:
+  std::vector<double> m_numerator; // of each complete batch
+  std::vector<double> m_denominator;
+  uint32_t m_batches;
+  uint32_t m_batchSize; // samples per batch
+  uint32_t m_count; // samples in the current batch
+  double m_partialNumerator;
+  double m_partialDenominator;
+};
+
+BatchMeans::BatchMeans ()
+{
+  Reset (10);
+}
+
+void
+BatchMeans::Reset (uint32_t batches)
+{
+  m_batches = std::max (batches, (uint32_t) 2);
+  m_numerator.clear ();
+  m_denominator.clear ();
+  m_numerator.reserve (2 * m_batches);
+  m_denominator.reserve (2 * m_batches);
+  m_batchSize = 1;
+  m_count = 0;
+  m_partialNumerator = 0;
+  m_partialDenominator = 0;
+}
+
+void
+BatchMeans::Add (double numerator, double denominator)
+{
+  m_partialNumerator += numerator;
+  m_partialDenominator += denominator;
+  if (++m_count < m_batchSize)
+    {
+      return;
+    }
+  m_numerator.push_back (m_partialNumerator);
+  m_denominator.push_back (m_partialDenominator);
+  m_count = 0;
+  m_partialNumerator = 0;
+  m_partialDenominator = 0;
+  if (m_numerator.size () == 2 * m_batches)
+    {
+      for (uint32_t i = 0; i < m_batches; i++)
+        {
+          m_numerator[i] = m_numerator[2 * i] + m_numerator[2 * i + 1];
+          m_denominator[i] = m_denominator[2 * i] + m_denominator[2 * i + 1];
+        }
+      m_numerator.resize (m_batches);
+      m_denominator.resize (m_batches);
+      m_batchSize *= 2;
+    }
+}
+
+uint32_t
+BatchMeans::GetNBatches () const
+{
+  return m_numerator.size ();
+}
+
+double
+BatchMeans::GetMean () const
+{
+  if (m_numerator.empty ())
+    {
+      return std::numeric_limits<double>::quiet_NaN ();
+    }
+  double sum = 0;
+  for (uint32_t i = 0; i < m_numerator.size (); i++)
+    {
+      // an empty batch (e.g. no packet received) yields NaN
+      sum += m_numerator[i] / m_denominator[i];
+    }
+  return sum / m_numerator.size ();
+}
+
+double
+BatchMeans::GetHalfWidth () const
+{
+  uint32_t n = m_numerator.size ();
+  if (n < 2)
+    {
+      return std::numeric_limits<double>::quiet_NaN ();
+    }
+  double mean = GetMean ();
+  double sumSquares = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double d = m_numerator[i] / m_denominator[i] - mean;
+      sumSquares += d * d;
+    }
+  return GetStudentT (n - 1) * std::sqrt (sumSquares / (n - 1) / n);
+}
+
+double
+BatchMeans::GetRelativeHalfWidth () const
+{
+  double mean = GetMean ();
+  if (mean == 0)
+    {
+      return std::numeric_limits<double>::quiet_NaN ();
+    }
+  return GetHalfWidth () / std::fabs (mean);
+}
+
+double
+BatchMeans::GetStudentT (uint32_t df)
+{
+  static const double t[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    2.040, 2.037, 2.035, 2.032, 2.030, 2.028, 2.026, 2.024, 2.023, 2.021,
+    2.020, 2.018, 2.017, 2.015, 2.014, 2.013, 2.012, 2.011, 2.010, 2.009,
+    2.008, 2.007, 2.006, 2.005, 2.004, 2.003, 2.002, 2.002, 2.001, 2.000
+  };
+  if (df == 0)
+    {
+      return std::numeric_limits<double>::quiet_NaN ();
+    }
+  if (df <= 60)
+    {
+      return t[df - 1];
+    }
+  // within 0.0003 of the exact quantile above 60 degrees of freedom
+  return 1.96 + 2.4 / df;
+}
+
+/**
+ * MSER-k warm-up detection: the series is averaged in batches of k samples
+ * and truncated at the batch d (at most half of the batches) that minimizes
+ * the marginal standard error of the remaining batches,
+ * sum((y_i - mean)^2) / (n - d)^2.  Dropping more of an initial transient
+ * shrinks the squared deviations faster than the shrinking sample count
+ * inflates the statistic.
+ */
+class Mser
+{
+public:
+  /**
+   * \brief Returns the length of the warm-up period of a series
+   * \param series the samples, oldest first
+   * \param batchSize the number of samples per batch (5 for MSER-5)
+   * \return the number of leading samples to discard
+   */
+  static uint32_t Truncate (const std::vector<double> &series, uint32_t batchSize);
+};
+
+uint32_t
+Mser::Truncate (const std::vector<double> &series, uint32_t batchSize)
+{
+  uint32_t n = series.size () / batchSize;
+  if (n < 2)
+    {
+      return 0;
+    }
+  std::vector<double> batches (n, 0.0);
+  for (uint32_t i = 0; i < n * batchSize; i++)
+    {
+      batches[i / batchSize] += series[i] / batchSize;
+    }
+  // suffix sums give the statistic of every truncation point in O(n)
+  double sum = 0;
+  double sumSquares = 0;
+  for (uint32_t i = n / 2; i < n; i++)
+    {
+      sum += batches[i];
+      sumSquares += batches[i] * batches[i];
+    }
+  uint32_t best = n / 2;
+  double bestStatistic = std::numeric_limits<double>::max ();
+  for (uint32_t d = n / 2 + 1; d-- > 0; )
+    {
+      if (d < n / 2)
+        {
+          sum += batches[d];
+          sumSquares += batches[d] * batches[d];
+        }
+      double k = n - d;
+      double statistic = std::max (sumSquares - sum * sum / k, 0.0) / (k * k);
+      // ties go to the shorter warm-up
+      if (statistic <= bestStatistic)
+        {
+          bestStatistic = statistic;
+          best = d;
+        }
+    }
+  return best * batchSize;
+}
+
+static GlobalValue g_sampleWindow ("SampleWindow",
+                                   "Throughput sampling window of each run; 0 disables the time series",
+                                   TimeValue (Seconds (1.0)),
+                                   MakeTimeChecker ());
+
+static GlobalValue g_nodeReport ("NodeReport",
+                                 "Write the per-node statistics of each run to a CSV file",
+                                 BooleanValue (true),
+                                 MakeBooleanChecker ());
+
+static GlobalValue g_eventLog ("EventLog",
+                               "Log the packets and course changes of each run to a binary event log "
+                               "instead of the text logs (decode with --decodeLog)",
+                               BooleanValue (false),
+                               MakeBooleanChecker ());
+
+static GlobalValue g_profileReport ("ProfileReport",
+                                    "Write the phase timing profile of each run to a CSV file",
+                                    BooleanValue (true),
+                                    MakeBooleanChecker ());
+
+static GlobalValue g_warmupTrim ("WarmupTrim",
+                                 "Detect the warm-up of each run on the sampled throughput and delay "
+                                 "(MSER-5) and report throughput, delay and pdr after it in the *Steady columns (needs SampleWindow > 0)",
+                                 BooleanValue (true),
+                                 MakeBooleanChecker ());
+
+static GlobalValue g_stopPrecision ("StopPrecision",
+                                    "Stop a run once the relative 95% CI half-width of throughput, delay "
+                                    "and PDR is below this (needs SampleWindow > 0); 0 always runs to totaltime",
+                                    DoubleValue (0.0),
+                                    MakeDoubleChecker<double> (0.0));
+
+static GlobalValue g_stopBatches ("StopBatches",
+                                  "Minimum number of batches of sampling windows the confidence intervals use",
+                                  UintegerValue (10),
+                                  MakeUintegerChecker<uint32_t> (2, 1000));
+
+static GlobalValue g_resultCache ("ResultCache",
+                                  "Directory caching the output row of every run; empty disables the cache",
+                                  StringValue (""),
+                                  MakeStringChecker ());
+
+static GlobalValue g_resultCacheVerify ("ResultCacheVerify",
+                                        "Fraction of cache hits that are run anyway and compared with the cached row",
+                                        DoubleValue (0.0),
+                                        MakeDoubleChecker<double> (0.0, 1.0));
+
+/**
+ * On-disk cache of output rows.  A run is described by text lines
+ * (name=value) covering its parameters, every GlobalValue (RngRun, the
+ * sampling and stopping knobs, ...) and the build (see GetBuildId); the
+ * FNV-1a hash of the description names the entry, and the entry stores the
+ * description in full, so a hash collision is a miss rather than a wrong
+ * row.  Entries are written to a temporary file and renamed, so concurrent
+ * sweep workers can share the directory.
+ */
+class ResultCache
+{
+public:
+  /**
+   * \brief Returns the cache configured by the ResultCache global value
+   * \return the cache, or 0 if caching is disabled
+   */
+  static ResultCache * Get ();
+
+  /**
+   * \brief Looks a run up
+   * \param description the description of the run
+   * \param row set to the cached row
+   * \return true on a hit
+   */
+  bool Lookup (std::string description, std::string &row) const;
+
+  /**
+   * \brief Stores the row of a run, replacing an existing entry
+   * \param description the description of the run
+   * \param row the row, as CSV
+   * \return none
+   */
+  void Store (std::string description, std::string row) const;
+
+  /**
+   * \brief Removes the entries whose description contains some text
+   * \param match the text, e.g. "m_scenario=2"; "*" removes every entry
+   * \return the number of entries removed
+   */
+  uint32_t Invalidate (std::string match) const;
+
+  /**
+   * \brief Decides whether a cache hit is verified by running it anyway
+   * \return true for a random ResultCacheVerify fraction of the calls
+   */
+  bool ShouldVerify ();
+
+  /**
+   * \brief Returns the description lines shared by every run of this
+   * process: the build and the settings
+   * \return the description lines
+   */
+  static std::string GetCommonDescription ();
+
+  /**
+   * \brief Returns the global values and the changed attribute defaults
+   * \return the description lines
+   */
+  static std::string GetSettingsDescription ();
+
+  /**
+   * \brief Returns a 64-bit FNV-1a hash
+   * \param data the data
+   * \param size the size of the data
+   * \param hash the hash to continue from
+   * \return the hash
+   */
+  static uint64_t Hash (const char *data, size_t size, uint64_t hash = 14695981039346656037ULL);
+
+private:
+  /**
+   * \brief Constructor
+   * \param directory the cache directory, created if needed
+   * \param verifyFraction the fraction of hits that are verified
+   * \return none
+   */
+  ResultCache (std::string directory, double verifyFraction);
+
+  /**
+   * \brief Identifies the build: the path, size and modification time of
+   * the executable and of every mapped ns-3 library
+   * \return the description lines of the build
+   */
+  static std::string GetBuildId ();
+
+  /**
+   * \brief Returns the entry file of a run
+   * \param description the description of the run
+   * \return the file name
+   */
+  std::string GetEntryFileName (std::string description) const;
+
+  std::string m_directory;
+  double m_verifyFraction;
+  unsigned int m_seed;
+  pid_t m_pid; // process m_seed was seeded in
+};
+
+ResultCache *
+ResultCache::Get ()
+{
+  static ResultCache *cache = 0;
+  static std::string directory;
+  StringValue value;
+  g_resultCache.GetValue (value);
+  if (value.Get () == "")
+    {
+      return 0;
+    }
+  if (cache == 0 || directory != value.Get ())
+    {
+      DoubleValue verify;
+      g_resultCacheVerify.GetValue (verify);
+      delete cache;
+      directory = value.Get ();
+      cache = new ResultCache (directory, verify.Get ());
+    }
+  return cache;
+}
+
+ResultCache::ResultCache (std::string directory, double verifyFraction)
+  : m_directory (directory),
+    m_verifyFraction (verifyFraction),
+    m_seed (time (0) ^ getpid ()),
+    m_pid (getpid ())
+{
+  if (mkdir (m_directory.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      NS_FATAL_ERROR ("ResultCache: cannot create " << m_directory << ": " << std::strerror (errno));
+    }
+}
+
+uint64_t
+ResultCache::Hash (const char *data, size_t size, uint64_t hash)
+{
+  for (size_t i = 0; i < size; i++)
+    {
+      hash ^= (unsigned char) data[i];
+      hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+std::string
+ResultCache::GetBuildId ()
+{
+  static std::string id;
+  if (id != "")
+    {
+      return id;
+    }
+  std::vector<std::string> files;
+  char exe[4096];
+  ssize_t n = readlink ("/proc/self/exe", exe, sizeof (exe) - 1);
+  if (n > 0)
+    {
+      files.push_back (std::string (exe, n));
+    }
+  std::ifstream maps ("/proc/self/maps");
+  std::string line;
+  while (std::getline (maps, line))
+    {
+      std::string::size_type slash = line.find ('/');
+      if (slash != std::string::npos && line.find ("libns3", slash) != std::string::npos)
+        {
+          std::string file = line.substr (slash);
+          if (std::find (files.begin (), files.end (), file) == files.end ())
+            {
+              files.push_back (file);
+            }
+        }
+    }
+  std::ostringstream oss;
+  for (uint32_t i = 0; i < files.size (); i++)
+    {
+      struct stat st;
+      if (stat (files[i].c_str (), &st) == 0)
+        {
+          oss << "build=" << files[i] << ":" << st.st_size << ":" << st.st_mtime << "\n";
+        }
+    }
+  id = oss.str ();
+  return id;
+}
+
+std::string
+ResultCache::GetCommonDescription ()
+{
+  return GetBuildId () + GetSettingsDescription ();
+}
+
+std::string
+ResultCache::GetSettingsDescription ()
+{
+  std::ostringstream oss;
+  for (GlobalValue::Iterator i = GlobalValue::Begin (); i != GlobalValue::End (); ++i)
+    {
+      if ((*i)->GetName () == "ResultCache" || (*i)->GetName () == "ResultCacheVerify")
+        {
+          continue;
+        }
+      StringValue value;
+      (*i)->GetValue (value);
+      oss << (*i)->GetName () << "=" << value.Get () << "\n";
+    }
+  // attribute defaults changed by Config::SetDefault or --ns3::...; the
+  // ones SetDefaultAttributeValues and SetApplicationVariant set from the
+  // run's own parameters are left out, as they hold the previous run's
+  // values until the run is set up
+  std::set<std::string> derived;
+  derived.insert ("ns3::OnOffApplication::PacketSize");
+  derived.insert ("ns3::OnOffApplication::DataRate");
+  derived.insert ("ns3::SimpleWirelessChannel::MaxRange");
+  for (uint32_t i = 0; i < TypeId::GetRegisteredN (); i++)
+    {
+      TypeId tid = TypeId::GetRegistered (i);
+      for (uint32_t j = 0; j < tid.GetAttributeN (); j++)
+        {
+          struct TypeId::AttributeInformation info = tid.GetAttribute (j);
+          if (derived.count (tid.GetName () + "::" + info.name))
+            {
+              continue;
+            }
+          std::string value = info.initialValue->SerializeToString (info.checker);
+          if (value != info.originalInitialValue->SerializeToString (info.checker))
+            {
+              oss << tid.GetName () << "::" << info.name << "=" << value << "\n";
+            }
+        }
+    }
+  return oss.str ();
+}
+
+std::string
+ResultCache::GetEntryFileName (std::string description) const
+{
+  char name[32];
+  std::snprintf (name, sizeof (name), "%016llx.row",
+                 (unsigned long long) Hash (description.data (), description.size ()));
+  return m_directory + "/" + name;
+}
+
+bool
+ResultCache::Lookup (std::string description, std::string &row) const
+{
+  std::ifstream in (GetEntryFileName (description).c_str ());
+  if (!in)
+    {
+      return false;
+    }
+  // the description, an empty line and the row
+  std::string stored;
+  std::string line;
+  while (std::getline (in, line) && line != "")
+    {
+      stored += line + "\n";
+    }
+  if (stored != description || !std::getline (in, row))
+    {
+      return false;
+    }
+  return row != "";
+}
+
+void
+ResultCache::Store (std::string description, std::string row) const
+{
+  std::string file = GetEntryFileName (description);
+  std::ostringstream tmp;
+  tmp << file << ".tmp" << getpid ();
+  std::ofstream out (tmp.str ().c_str ());
+  out << description << "\n" << row << "\n";
+  out.close ();
+  if (!out || std::rename (tmp.str ().c_str (), file.c_str ()) != 0)
+    {
+      NS_LOG_ERROR ("ResultCache: cannot write " << file);
+      std::remove (tmp.str ().c_str ());
+    }
+}
+
+uint32_t
+ResultCache::Invalidate (std::string match) const
+{
+  uint32_t removed = 0;
+  DIR *dir = opendir (m_directory.c_str ());
+  if (dir == 0)
+    {
+      return 0;
+    }
+  struct dirent *entry;
+  while ((entry = readdir (dir)) != 0)
+    {
+      std::string name = entry->d_name;
+      if (name.size () < 4 || name.compare (name.size () - 4, 4, ".row") != 0)
+        {
+          continue;
+        }
+      std::string file = m_directory + "/" + name;
+      bool matches = match == "*";
+      if (!matches)
+        {
+          std::ifstream in (file.c_str ());
+          std::string line;
+          while (!matches && std::getline (in, line) && line != "")
+            {
+              matches = line.find (match) != std::string::npos;
+            }
+        }
+      if (matches && std::remove (file.c_str ()) == 0)
+        {
+          removed++;
+        }
+    }
+  closedir (dir);
+  return removed;
+}
+
+bool
+ResultCache::ShouldVerify ()
+{
+  if (m_pid != getpid ())
+    {
+      // forked sweep workers must not all draw the same sample
+      m_pid = getpid ();
+      m_seed ^= m_pid;
+    }
+  return m_verifyFraction > 0 && rand_r (&m_seed) < m_verifyFraction * ((double) RAND_MAX + 1);
+}
+
+static GlobalValue g_costHistory ("CostHistory",
+                                  "File every run appends its parameters, wall time, event count and memory to "
+                                  "(the history the cost model is fitted on); empty disables it",
+                                  StringValue ("cost-history.csv"),
+                                  MakeStringChecker ());
+
+/**
+ * The parameters of a run that its cost depends on.
+ */
+struct RunFeatures
+{
+  double nodes; // including base stations
+  double macMode;
+  double mobility;
+  double rateBps; // OnOff rate of each node
+  double packetSize;
+  double slotTime;
+  double simTime; // seconds
+};
+
+/**
+ * Predicts the wall time and memory of a run from the runs in the cost
+ * history: two least-squares regressions of log(wall seconds) and
+ * log(resident set size) on log-features of the run (node count,
+ * simulated time, packets per second per node, TDMA slot time) and on the
+ * MAC and mobility modes.  A small ridge term keeps the fit defined when
+ * the history does not vary some feature (e.g. only TDMA runs); such a
+ * feature then simply does not contribute.
+ */
+class CostModel
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  CostModel ();
+
+  /**
+   * \brief Fits the model to a cost history
+   * \param filename the history, as written by Append
+   * \return true if the history holds enough runs for a fit
+   */
+  bool Load (std::string filename);
+
+  /**
+   * \brief Returns whether the model has been fitted
+   * \return true after a successful Load
+   */
+  bool IsFitted () const;
+
+  /**
+   * \brief Returns the number of runs the model was fitted on
+   * \return the number of runs
+   */
+  uint32_t GetNRuns () const;
+
+  /**
+   * \brief Returns the root mean square error of the wall time fit
+   * \return the error, as a factor (e.g. 1.3 for +-30%)
+   */
+  double GetWallErrorFactor () const;
+
+  /**
+   * \brief Predicts the wall time of a run
+   * \param features the run
+   * \return the wall time in seconds
+   */
+  double PredictWallSeconds (const RunFeatures &features) const;
+
+  /**
+   * \brief Predicts the resident set size of a run
+   * \param features the run
+   * \return the resident set size in kB
+   */
+  double PredictRssKb (const RunFeatures &features) const;
+
+  /**
+   * \brief Appends a finished run to a cost history.  A single write(2)
+   * on an O_APPEND descriptor, so concurrent sweep workers do not
+   * interleave their lines
+   * \param filename the history
+   * \param features the run
+   * \param wallSeconds wall time of the run
+   * \param events simulator events executed
+   * \param rssKb resident set size at the end of the run
+   * \param peakRssKb peak resident set size of the process
+   * \return none
+   */
+  static void Append (std::string filename, const RunFeatures &features, double wallSeconds,
+                      uint64_t events, uint64_t rssKb, uint64_t peakRssKb);
+
+private:
+  enum
+  {
+    N_REGRESSORS = 7
+  };
+
+  /**
+   * \brief Computes the regressors of a run
+   * \param features the run
+   * \param x filled with N_REGRESSORS values
+   * \return none
+   */
+  static void GetRegressors (const RunFeatures &features, double *x);
+
+  /**
+   * \brief Ridge least-squares fit
+   * \param x the regressors of the runs, N_REGRESSORS per run
+   * \param y the responses
+   * \param beta filled with the coefficients
+   * \return the root mean square residual
+   */
+  static double Fit (const std::vector<double> &x, const std::vector<double> &y, std::vector<double> &beta);
+
+  std::vector<double> m_wallBeta;
+  std::vector<double> m_rssBeta;
+  double m_wallRmse;
+  uint32_t m_nRuns;
+};
+
+CostModel::CostModel ()
+  : m_wallRmse (0),
+    m_nRuns (0)
+{
+}
+
+void
+CostModel::GetRegressors (const RunFeatures &features, double *x)
+{
+  double packetsPerSecond = features.rateBps / (8.0 * std::max (features.packetSize, 1.0));
+  x[0] = 1;
+  x[1] = std::log (std::max (features.nodes, 1.0));
+  x[2] = std::log (std::max (features.simTime, 1e-3));
+  x[3] = std::log (1 + packetsPerSecond);
+  x[4] = std::log (std::max (features.slotTime, 1.0));
+  x[5] = features.macMode;
+  x[6] = features.mobility == 2 ? 1 : 0;
+}
+
+double
+CostModel::Fit (const std::vector<double> &x, const std::vector<double> &y, std::vector<double> &beta)
+{
+  const uint32_t k = N_REGRESSORS;
+  uint32_t n = y.size ();
+  // normal equations (X'X + lambda I) beta = X'y, solved by Gaussian
+  // elimination with partial pivoting
+  std::vector<double> a (k * (k + 1), 0.0);
+  for (uint32_t r = 0; r < n; r++)
+    {
+      for (uint32_t i = 0; i < k; i++)
+        {
+          for (uint32_t j = 0; j < k; j++)
+            {
+              a[i * (k + 1) + j] += x[r * k + i] * x[r * k + j];
+            }
+          a[i * (k + 1) + k] += x[r * k + i] * y[r];
+        }
+    }
+  for (uint32_t i = 0; i < k; i++)
+    {
+      a[i * (k + 1) + i] += 1e-6 * (1 + a[i * (k + 1) + i]);
+    }
+  for (uint32_t c = 0; c < k; c++)
+    {
+      uint32_t pivot = c;
+      for (uint32_t i = c + 1; i < k; i++)
+        {
+          if (std::fabs (a[i * (k + 1) + c]) > std::fabs (a[pivot * (k + 1) + c]))
+            {
+              pivot = i;
+            }
+        }
+      for (uint32_t j = 0; j <= k; j++)
+        {
+          std::swap (a[c * (k + 1) + j], a[pivot * (k + 1) + j]);
+        }
+      for (uint32_t i = c + 1; i < k; i++)
+        {
+          double f = a[i * (k + 1) + c] / a[c * (k + 1) + c];
+          for (uint32_t j = c; j <= k; j++)
+            {
+              a[i * (k + 1) + j] -= f * a[c * (k + 1) + j];
+            }
+        }
+    }
+  beta.assign (k, 0.0);
+  for (uint32_t i = k; i-- > 0; )
+    {
+      double sum = a[i * (k + 1) + k];
+      for (uint32_t j = i + 1; j < k; j++)
+        {
+          sum -= a[i * (k + 1) + j] * beta[j];
+        }
+      beta[i] = sum / a[i * (k + 1) + i];
+    }
+
+  double sumSquares = 0;
+  for (uint32_t r = 0; r < n; r++)
+    {
+      double prediction = 0;
+      for (uint32_t i = 0; i < k; i++)
+        {
+          prediction += beta[i] * x[r * k + i];
+        }
+      sumSquares += (y[r] - prediction) * (y[r] - prediction);
+    }
+  return std::sqrt (sumSquares / std::max (n, (uint32_t) 1));
+}
+
+bool
+CostModel::Load (std::string filename)
+{
+  std::ifstream in (filename.c_str ());
+  std::string line;
+  std::vector<double> x;
+  std::vector<double> wall;
+  std::vector<double> rss;
+  m_nRuns = 0;
+  while (std::getline (in, line))
+    {
+      // nodes,macMode,mobility,rate,packetSize,slotTime,simTime,wallSeconds,events,rssKb,peakRssKb
+      std::istringstream iss (line);
+      RunFeatures features;
+      double wallSeconds;
+      double events;
+      double rssKb;
+      char c[10];
+      if (!(iss >> features.nodes >> c[0] >> features.macMode >> c[1] >> features.mobility >> c[2]
+            >> features.rateBps >> c[3] >> features.packetSize >> c[4] >> features.slotTime >> c[5]
+            >> features.simTime >> c[6] >> wallSeconds >> c[7] >> events >> c[8] >> rssKb)
+          || wallSeconds <= 0 || rssKb <= 0)
+        {
+          // the header, or a damaged line
+          continue;
+        }
+      double regressors[N_REGRESSORS];
+      GetRegressors (features, regressors);
+      x.insert (x.end (), regressors, regressors + N_REGRESSORS);
+      wall.push_back (std::log (wallSeconds));
+      rss.push_back (std::log (rssKb));
+      m_nRuns++;
+    }
+  if (m_nRuns < N_REGRESSORS)
+    {
+      m_wallBeta.clear ();
+      m_rssBeta.clear ();
+      return false;
+    }
+  m_wallRmse = Fit (x, wall, m_wallBeta);
+  Fit (x, rss, m_rssBeta);
+  return true;
+}
+
+bool
+CostModel::IsFitted () const
+{
+  return !m_wallBeta.empty ();
+}
+
+uint32_t
+CostModel::GetNRuns () const
+{
+  return m_nRuns;
+}
+
+double
+CostModel::GetWallErrorFactor () const
+{
+  return std::exp (m_wallRmse);
+}
+
+double
+CostModel::PredictWallSeconds (const RunFeatures &features) const
+{
+  double x[N_REGRESSORS];
+  GetRegressors (features, x);
+  double y = 0;
+  for (uint32_t i = 0; i < N_REGRESSORS; i++)
+    {
+      y += m_wallBeta[i] * x[i];
+    }
+  return std::exp (y);
+}
+
+double
+CostModel::PredictRssKb (const RunFeatures &features) const
+{
+  double x[N_REGRESSORS];
+  GetRegressors (features, x);
+  double y = 0;
+  for (uint32_t i = 0; i < N_REGRESSORS; i++)
+    {
+      y += m_rssBeta[i] * x[i];
+    }
+  return std::exp (y);
+}
+
+void
+CostModel::Append (std::string filename, const RunFeatures &features, double wallSeconds,
+                   uint64_t events, uint64_t rssKb, uint64_t peakRssKb)
+{
+  int fd = open (filename.c_str (), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    {
+      NS_LOG_ERROR ("CostModel: cannot open " << filename << ": " << std::strerror (errno));
+      return;
+    }
+  std::ostringstream oss;
+  struct stat st;
+  if (fstat (fd, &st) == 0 && st.st_size == 0)
+    {
+      oss << "nodes,macMode,mobility,rate,packetSize,slotTime,simTime,wallSeconds,events,rssKb,peakRssKb\n";
+    }
+  oss << features.nodes << "," << features.macMode << "," << features.mobility << ","
+      << features.rateBps << "," << features.packetSize << "," << features.slotTime << ","
+      << features.simTime << "," << wallSeconds << "," << events << "," << rssKb << ","
+      << peakRssKb << "\n";
+  std::string data = oss.str ();
+  if (write (fd, data.data (), data.size ()) != (ssize_t) data.size ())
+    {
+      NS_LOG_ERROR ("CostModel: cannot append to " << filename);
+    }
+  close (fd);
+}
+
+static GlobalValue g_memoryReport ("MemoryReport",
+                                   "Interval at which each run samples its live ns-3 objects (per TypeId) and heap "
+                                   "blocks (per size class) to a CSV file; 0 disables it",
+                                   TimeValue (Seconds (0)),
+                                   MakeTimeChecker ());
+
+/**
+ * Opt-in memory accounting of a run.  A sample walks the object graph
+ * reachable from the nodes and channels (aggregated objects and the
+ * objects behind Pointer and ObjectVector attributes, as Config paths do)
+ * and counts the live instances of every TypeId, with their approximate
+ * size (the heap block of the object itself, not what it points to).
+ * Packets and their buffers are not ns-3 Objects; they only show in the
+ * heap rows, the blocks and bytes per power-of-two size class allocated
+ * and not freed since the report started, as tallied by the replaced
+ * operator new.  These rows do not separate Packet and Buffer memory from
+ * any other allocation of the same size.  A class goes negative when more
+ * blocks allocated before the start are freed than new ones stay live.
+ *
+ * Samples are taken periodically during Simulator::Run and once at the end
+ * of the run.  RecordRunEnd tracks the resident set size after every run,
+ * so memory a sweep point leaves behind shows as growth at the next one.
+ */
+class MemoryReport
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  MemoryReport ();
+
+  /**
+   * \brief Starts a report and the heap accounting
+   * \param filename the CSV file to (over)write
+   * \param interval the sampling interval; if it is not positive, only
+   * Stop takes a sample (the MemoryReport global value never passes 0, as
+   * 0 disables the report)
+   * \return none
+   */
+  void Start (std::string filename, Time interval);
+
+  /**
+   * \brief Returns whether a report has been started
+   * \return true between Start and Stop
+   */
+  bool IsStarted () const;
+
+  /**
+   * \brief Writes a sample at the current simulation time
+   * \return none
+   */
+  void Sample ();
+
+  /**
+   * \brief Takes the final sample, closes the report and stops the heap
+   * accounting
+   * \return none
+   */
+  void Stop ();
+
+  /**
+   * \brief Records the resident set size after a run and prints its growth
+   * since the previous run of this process
+   * \param tag the run
+   * \return the growth in kB
+   */
+  static int64_t RecordRunEnd (std::string tag);
+
+  /**
+   * \brief Returns the current resident set size of the process
+   * \return the resident set size in kB, 0 if unknown
+   */
+  static uint64_t GetRssKb ();
+
+private:
+  struct Count
+  {
+    uint64_t instances;
+    uint64_t bytes;
+  };
+
+  /**
+   * \brief Counts an object and the objects reachable from it
+   * \param object the object
+   * \param visited the objects counted so far
+   * \param types the counts per TypeId name
+   * \return none
+   */
+  static void Walk (Ptr<const Object> object, std::set<const Object *> &visited,
+                    std::map<std::string, Count> &types);
+
+  /**
+   * \brief Takes a sample and schedules the next one
+   * \return none
+   */
+  void PeriodicSample ();
+
+  std::ofstream m_out;
+  Time m_interval;
+  EventId m_event;
+  static uint64_t s_lastRunRssKb;
+};
+
+uint64_t MemoryReport::s_lastRunRssKb = 0;
+
+MemoryReport::MemoryReport ()
+{
+}
+
+void
+MemoryReport::Start (std::string filename, Time interval)
+{
+  m_out.open (filename.c_str ());
+  m_out << "time,kind,name,instances,bytes\n";
+  std::fill (g_heapLiveCount, g_heapLiveCount + 64, 0);
+  std::fill (g_heapLiveBytes, g_heapLiveBytes + 64, 0);
+  g_heapAccounting = true;
+  m_interval = interval;
+  if (m_interval.IsStrictlyPositive ())
+    {
+      m_event = Simulator::Schedule (m_interval, &MemoryReport::PeriodicSample, this);
+    }
+}
+
+bool
+MemoryReport::IsStarted () const
+{
+  return m_out.is_open ();
+}
+
+void
+MemoryReport::PeriodicSample ()
+{
+  Sample ();
+  m_event = Simulator::Schedule (m_interval, &MemoryReport::PeriodicSample, this);
+}
+
+void
+MemoryReport::Walk (Ptr<const Object> object, std::set<const Object *> &visited,
+                    std::map<std::string, Count> &types)
+{
+  if (object == 0 || !visited.insert (PeekPointer (object)).second)
+    {
+      return;
+    }
+  TypeId tid = object->GetInstanceTypeId ();
+  Count &count = types[tid.GetName ()];
+  count.instances++;
+  // the start of the most derived object is the start of its heap block
+  count.bytes += malloc_usable_size (const_cast<void *> (dynamic_cast<const void *> (PeekPointer (object))));
+
+  Object::AggregateIterator aggregates = object->GetAggregateIterator ();
+  while (aggregates.HasNext ())
+    {
+      Walk (aggregates.Next (), visited, types);
+    }
+  for (TypeId t = tid; ; t = t.GetParent ())
+    {
+      for (uint32_t i = 0; i < t.GetAttributeN (); i++)
+        {
+          TypeId::AttributeInformation info = t.GetAttribute (i);
+          if (!(info.flags & TypeId::ATTR_GET) || !info.accessor->HasGetter ())
+            {
+              continue;
+            }
+          if (dynamic_cast<const PointerChecker *> (PeekPointer (info.checker)) != 0)
+            {
+              PointerValue value;
+              object->GetAttribute (info.name, value);
+              Walk (value.GetObject (), visited, types);
+            }
+          else if (dynamic_cast<const ObjectPtrContainerChecker *> (PeekPointer (info.checker)) != 0)
+            {
+              ObjectPtrContainerValue value;
+              object->GetAttribute (info.name, value);
+              for (ObjectPtrContainerValue::Iterator it = value.Begin (); it != value.End (); ++it)
+                {
+                  Walk (it->second, visited, types);
+                }
+            }
+        }
+      if (!t.HasParent () || t.GetParent () == t)
+        {
+          break;
+        }
+    }
+}
+
+void
+MemoryReport::Sample ()
+{
+  if (!m_out.is_open ())
+    {
+      return;
+    }
+  std::set<const Object *> visited;
+  std::map<std::string, Count> types;
+  for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
+    {
+      Walk (*it, visited, types);
+    }
+  for (uint32_t i = 0; i < ChannelList::GetNChannels (); i++)
+    {
+      Walk (ChannelList::GetChannel (i), visited, types);
+    }
+
+  double now = Simulator::Now ().GetSeconds ();
+  for (std::map<std::string, Count>::const_iterator it = types.begin (); it != types.end (); ++it)
+    {
+      m_out << now << ",type," << it->first << "," << it->second.instances << ","
+            << it->second.bytes << "\n";
+    }
+  int64_t liveCount = 0;
+  int64_t liveBytes = 0;
+  for (uint32_t c = 0; c < 64; c++)
+    {
+      liveCount += g_heapLiveCount[c];
+      liveBytes += g_heapLiveBytes[c];
+      if (g_heapLiveCount[c] == 0)
+        {
+          continue;
+        }
+      m_out << now << ",heap,<=" << (1ULL << c) << "B,"
+            << g_heapLiveCount[c] << "," << g_heapLiveBytes[c] << "\n";
+    }
+  m_out << now << ",total,heap," << liveCount << "," << liveBytes << "\n"
+        << now << ",total,rss,," << GetRssKb () * 1024 << "\n";
+}
+
+void
+MemoryReport::Stop ()
+{
+  if (!m_out.is_open ())
+    {
+      return;
+    }
+  Simulator::Cancel (m_event);
+  Sample ();
+  m_out.close ();
+  g_heapAccounting = false;
+}
+
+uint64_t
+MemoryReport::GetRssKb ()
+{
+  return ResidentSetKb ();
+}
+
+int64_t
+MemoryReport::RecordRunEnd (std::string tag)
+{
+  uint64_t rssKb = GetRssKb ();
+  int64_t growthKb = s_lastRunRssKb > 0 ? (int64_t) rssKb - (int64_t) s_lastRunRssKb : 0;
+  std::cout << "Memory: RSS after " << tag << ": " << rssKb << " kB";
+  if (s_lastRunRssKb > 0)
+    {
+      std::cout << " (" << (growthKb >= 0 ? "+" : "") << growthKb << " kB since the previous run)";
+    }
+  std::cout << "\n";
+  s_lastRunRssKb = rssKb;
+  return growthKb;
+}
+
+/**
+ * Simulator implementation that wraps another one (DefaultSimulatorImpl by
+ * default) and profiles its event loop.  Select it with
+ * --SimulatorImplementationType=ns3::ProfilingSimulatorImpl (or --profileEvents).
+ *
+ * Every scheduled event is wrapped in a ProfiledEvent that times its
+ * execution.  Events are attributed to their source, i.e. the C++ type of
+ * the event, which MakeEvent derives from the target class and member
+ * function (or function) signature.  The number of pending events is
+ * tracked exactly (cancellation is handled here, so cancelled events are
+ * seen when they leave the queue) and sampled over simulation time in a
+ * bounded buffer.  A top-N table is printed when the simulator is
+ * destroyed.
+ */
+class ProfilingSimulatorImpl : public SimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  ProfilingSimulatorImpl ();
+
+  virtual ~ProfilingSimulatorImpl ();
+
+  virtual void Destroy ();
+  virtual bool IsFinished (void) const;
+  virtual void Stop (void);
+  virtual void Stop (Time const &delay);
+  virtual EventId Schedule (Time const &delay, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, Time const &delay, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+  virtual EventId ScheduleDestroy (EventImpl *event);
+  virtual void Remove (const EventId &id);
+  virtual void Cancel (const EventId &id);
+  virtual bool IsExpired (const EventId &id) const;
+  virtual void Run (void);
+  virtual Time Now (void) const;
+  virtual Time GetDelayLeft (const EventId &id) const;
+  virtual Time GetMaximumSimulationTime (void) const;
+  virtual void SetScheduler (ObjectFactory schedulerFactory);
+  virtual uint32_t GetSystemId (void) const;
+  virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+
+  /**
+   * \brief Prints the event sources that took the most wall time
+   * \param os the output stream
+   * \param n the number of sources to print
+   * \return none
+   */
+  void PrintTopN (std::ostream &os, uint32_t n) const;
+
+  /**
+   * \brief Writes the statistics of every event source as CSV
+   * \param filename the file to (over)write
+   * \return none
+   */
+  void WriteSources (std::string filename) const;
+
+  /**
+   * \brief Writes the sampled event queue depth as CSV
+   * \param filename the file to (over)write
+   * \return none
+   */
+  void WriteQueueDepth (std::string filename) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct Source
+  {
+    std::string name;
+    uint64_t count;
+    int64_t nanoSeconds;
+  };
+
+  struct DepthSample
+  {
+    double time;
+    uint64_t depth;
+  };
+
+  struct TypeInfoLess
+  {
+    bool operator() (const std::type_info *a, const std::type_info *b) const
+    {
+      return a->before (*b);
+    }
+  };
+
+  class ProfiledEvent : public EventImpl
+  {
+  public:
+    ProfiledEvent (ProfilingSimulatorImpl *sim, EventImpl *event, uint32_t source);
+    bool IsDropped (void) const;
+    void Drop (void);
+  protected:
+    virtual void Notify (void);
+  private:
+    ProfilingSimulatorImpl *m_sim;
+    Ptr<EventImpl> m_event;
+    uint32_t m_source;
+    bool m_dropped;
+  };
+
+  EventImpl * Wrap (EventImpl *event);
+  uint32_t GetSource (EventImpl *event);
+  void EventDone (uint32_t source, int64_t nanoSeconds, bool executed);
+  static std::string GetSourceName (const std::type_info &type);
+
+  Ptr<SimulatorImpl> m_impl;
+  std::map<const std::type_info *, uint32_t, TypeInfoLess> m_sourceIndex;
+  std::vector<Source> m_sources;
+  uint64_t m_pending;
+  uint64_t m_maxPending;
+  uint64_t m_dequeued;
+  std::vector<DepthSample> m_depth;
+  uint64_t m_depthEvery;
+  uint32_t m_topN;
+  uint32_t m_maxDepthSamples;
+  bool m_reported;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingSimulatorImpl);
+
+TypeId
+ProfilingSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ProfilingSimulatorImpl")
+    .SetParent<SimulatorImpl> ()
+    .AddConstructor<ProfilingSimulatorImpl> ()
+    .AddAttribute ("TopN",
+                   "Number of event sources printed when the simulator is destroyed (0 for none)",
+                   UintegerValue (15),
+                   MakeUintegerAccessor (&ProfilingSimulatorImpl::m_topN),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxDepthSamples",
+                   "Number of queue depth samples kept; the sampling interval doubles when full",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&ProfilingSimulatorImpl::m_maxDepthSamples),
+                   MakeUintegerChecker<uint32_t> (2, 1u << 24))
+  ;
+  return tid;
+}
+
+ProfilingSimulatorImpl::ProfilingSimulatorImpl ()
+  : m_pending (0),
+    m_maxPending (0),
+    m_dequeued (0),
+    m_depthEvery (1),
+    m_topN (15),
+    m_maxDepthSamples (4096),
+    m_reported (false)
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::DefaultSimulatorImpl");
+  m_impl = factory.Create<SimulatorImpl> ();
+}
+
+ProfilingSimulatorImpl::~ProfilingSimulatorImpl ()
+{
+}
+
+void
+ProfilingSimulatorImpl::DoDispose (void)
+{
+  if (m_impl != 0)
+    {
+      m_impl->Dispose ();
+      m_impl = 0;
+    }
+  SimulatorImpl::DoDispose ();
+}
+
+ProfilingSimulatorImpl::ProfiledEvent::ProfiledEvent (ProfilingSimulatorImpl *sim, EventImpl *event, uint32_t source)
+  : m_sim (sim),
+    m_event (event, false),
+    m_source (source),
+    m_dropped (false)
+{
+}
+
+bool
+ProfilingSimulatorImpl::ProfiledEvent::IsDropped (void) const
+{
+  return m_dropped;
+}
+
+void
+ProfilingSimulatorImpl::ProfiledEvent::Drop (void)
+{
+  m_dropped = true;
+}
+
+void
+ProfilingSimulatorImpl::ProfiledEvent::Notify (void)
+{
+  if (m_dropped)
+    {
+      // cancelled: only leaves the queue
+      m_sim->EventDone (m_source, 0, false);
+      return;
+    }
+  struct timespec start;
+  struct timespec end;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  m_event->Invoke ();
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  m_sim->EventDone (m_source, (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec), true);
+}
+
+std::string
+ProfilingSimulatorImpl::GetSourceName (const std::type_info &type)
+{
+  int status = 0;
+  char *demangled = abi::__cxa_demangle (type.name (), 0, 0, &status);
+  std::string name = status == 0 && demangled != 0 ? demangled : type.name ();
+  std::free (demangled);
+  // "ns3::MakeEvent<void (Foo::*)(), Foo*>(...)::EventMemberImpl0": keep
+  // the template arguments, i.e. the member function and target types
+  std::string::size_type begin = name.find ("MakeEvent<");
+  std::string::size_type end = name.find (">(");
+  if (begin != std::string::npos && end != std::string::npos && end > begin)
+    {
+      begin += std::strlen ("MakeEvent<");
+      return name.substr (begin, end - begin);
+    }
+  return name;
+}
+
+uint32_t
+ProfilingSimulatorImpl::GetSource (EventImpl *event)
+{
+  const std::type_info &type = typeid (*event);
+  std::map<const std::type_info *, uint32_t, TypeInfoLess>::iterator it = m_sourceIndex.find (&type);
+  if (it != m_sourceIndex.end ())
+    {
+      return it->second;
+    }
+  Source source;
+  source.name = GetSourceName (type);
+  source.count = 0;
+  source.nanoSeconds = 0;
+  m_sources.push_back (source);
+  m_sourceIndex.insert (std::make_pair (&type, m_sources.size () - 1));
+  return m_sources.size () - 1;
+}
+
+EventImpl *
+ProfilingSimulatorImpl::Wrap (EventImpl *event)
+{
+  m_pending++;
+  m_maxPending = std::max (m_maxPending, m_pending);
+  return new ProfiledEvent (this, event, GetSource (event));
+}
+
+void
+ProfilingSimulatorImpl::EventDone (uint32_t source, int64_t nanoSeconds, bool executed)
+{
+  if (executed)
+    {
+      m_sources[source].count++;
+      m_sources[source].nanoSeconds += nanoSeconds;
+    }
+  m_pending--;
+  if (m_dequeued++ % m_depthEvery == 0)
+    {
+      if (m_depth.size () >= m_maxDepthSamples)
+        {
+          // keep every other sample and sample half as often
+          for (uint32_t i = 0; i < m_depth.size () / 2; i++)
+            {
+              m_depth[i] = m_depth[2 * i];
+            }
+          m_depth.resize (m_depth.size () / 2);
+          m_depthEvery *= 2;
+        }
+      DepthSample sample;
+      sample.time = m_impl->Now ().GetSeconds ();
+      sample.depth = m_pending;
+      m_depth.push_back (sample);
+    }
+}
+
+void
+ProfilingSimulatorImpl::Destroy ()
+{
+  if (m_topN > 0 && !m_reported)
+    {
+      PrintTopN (std::cout, m_topN);
+    }
+  m_reported = true;
+  m_impl->Destroy ();
+}
+
+bool
+ProfilingSimulatorImpl::IsFinished (void) const
+{
+  return m_impl->IsFinished ();
+}
+
+void
+ProfilingSimulatorImpl::Stop (void)
+{
+  m_impl->Stop ();
+}
+
+void
+ProfilingSimulatorImpl::Stop (Time const &delay)
+{
+  m_impl->Stop (delay);
+}
+
+EventId
+ProfilingSimulatorImpl::Schedule (Time const &delay, EventImpl *event)
+{
+  return m_impl->Schedule (delay, Wrap (event));
+}
+
+void
+ProfilingSimulatorImpl::ScheduleWithContext (uint32_t context, Time const &delay, EventImpl *event)
+{
+  m_impl->ScheduleWithContext (context, delay, Wrap (event));
+}
+
+EventId
+ProfilingSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  return m_impl->ScheduleNow (Wrap (event));
+}
+
+EventId
+ProfilingSimulatorImpl::ScheduleDestroy (EventImpl *event)
+{
+  // destroy events run after the loop; they are not profiled
+  return m_impl->ScheduleDestroy (event);
+}
+
+void
+ProfilingSimulatorImpl::Remove (const EventId &id)
+{
+  // the wrapped simulator does not know about cancelled events, so ask it
+  // whether the event is still queued
+  if (id.GetUid () > 2 && !m_impl->IsExpired (id))
+    {
+      // removed from the queue without being popped
+      m_pending--;
+    }
+  m_impl->Remove (id);
+}
+
+void
+ProfilingSimulatorImpl::Cancel (const EventId &id)
+{
+  if (id.GetUid () <= 2)
+    {
+      m_impl->Cancel (id);
+      return;
+    }
+  if (!m_impl->IsExpired (id))
+    {
+      // the event stays queued; the wrapper skips it and counts it out
+      // when the loop pops it
+      static_cast<ProfiledEvent *> (id.PeekEventImpl ())->Drop ();
+    }
+}
+
+bool
+ProfilingSimulatorImpl::IsExpired (const EventId &id) const
+{
+  if (id.GetUid () > 2 && id.PeekEventImpl () != 0
+      && static_cast<ProfiledEvent *> (id.PeekEventImpl ())->IsDropped ())
+    {
+      return true;
+    }
+  return m_impl->IsExpired (id);
+}
+
+void
+ProfilingSimulatorImpl::Run (void)
+{
+  m_impl->Run ();
+}
+
+Time
+ProfilingSimulatorImpl::Now (void) const
+{
+  return m_impl->Now ();
+}
+
+Time
+ProfilingSimulatorImpl::GetDelayLeft (const EventId &id) const
+{
+  return IsExpired (id) ? TimeStep (0) : m_impl->GetDelayLeft (id);
+}
+
+Time
+ProfilingSimulatorImpl::GetMaximumSimulationTime (void) const
+{
+  return m_impl->GetMaximumSimulationTime ();
+}
+
+void
+ProfilingSimulatorImpl::SetScheduler (ObjectFactory schedulerFactory)
+{
+  m_impl->SetScheduler (schedulerFactory);
+}
+
+uint32_t
+ProfilingSimulatorImpl::GetSystemId (void) const
+{
+  return m_impl->GetSystemId ();
+}
+
+uint32_t
+ProfilingSimulatorImpl::GetContext (void) const
+{
+  return m_impl->GetContext ();
+}
+
+uint64_t
+ProfilingSimulatorImpl::GetEventCount (void) const
+{
+  return m_impl->GetEventCount ();
+}
+
+static bool
+CompareSourceTime (const std::pair<int64_t, uint32_t> &a, const std::pair<int64_t, uint32_t> &b)
+{
+  return a.first > b.first;
+}
+
+void
+ProfilingSimulatorImpl::PrintTopN (std::ostream &os, uint32_t n) const
+{
+  uint64_t totalCount = 0;
+  int64_t totalTime = 0;
+  std::vector<std::pair<int64_t, uint32_t> > order;
+  for (uint32_t i = 0; i < m_sources.size (); i++)
+    {
+      totalCount += m_sources[i].count;
+      totalTime += m_sources[i].nanoSeconds;
+      order.push_back (std::make_pair (m_sources[i].nanoSeconds, i));
+    }
+  std::sort (order.begin (), order.end (), CompareSourceTime);
+
+  os << "---- Event sources by wall time (" << totalCount << " events, "
+     << totalTime * 1e-6 << " ms, max queue depth " << m_maxPending << ") ----\n";
+  os << "  events   %events   time(ms)   %time   ns/event  source\n";
+  for (uint32_t k = 0; k < order.size () && k < n; k++)
+    {
+      const Source &source = m_sources[order[k].second];
+      char line[96];
+      std::snprintf (line, sizeof (line), "%8llu %8.2f%% %10.3f %6.2f%% %10.1f  ",
+                     (unsigned long long) source.count,
+                     totalCount > 0 ? source.count * 100.0 / totalCount : 0.0,
+                     source.nanoSeconds * 1e-6,
+                     totalTime > 0 ? source.nanoSeconds * 100.0 / totalTime : 0.0,
+                     source.count > 0 ? (double) source.nanoSeconds / source.count : 0.0);
+      os << line << source.name << "\n";
+    }
+}
+
+void
+ProfilingSimulatorImpl::WriteSources (std::string filename) const
+{
+  FileHandle fh (filename);
+  fh.WriteHeader ("source,events,nanoseconds");
+  for (uint32_t i = 0; i < m_sources.size (); i++)
+    {
+      std::ostringstream oss;
+      // the source names contain commas
+      oss << "\"" << m_sources[i].name << "\"," << m_sources[i].count << "," << m_sources[i].nanoSeconds;
+      fh.WriteData (oss.str ());
+    }
+}
+
+void
+ProfilingSimulatorImpl::WriteQueueDepth (std::string filename) const
+{
+  FileHandle fh (filename);
+  fh.WriteHeader ("time,depth");
+  for (uint32_t i = 0; i < m_depth.size (); i++)
+    {
+      std::ostringstream oss;
+      oss << m_depth[i].time << "," << m_depth[i].depth;
+      fh.WriteData (oss.str ());
+    }
+}
+
+/**
+ * Connects per-node trace sources by walking node containers, instead of
+ * Config::Connect with wildcard paths.  Each trace source is bound to a
+ * preallocated slot holding the sink and the node/application index, so
+ * sinks get small integers rather than a string context copied on every
+ * event, and no path is resolved at startup.
+ */
+class TraceHookup
+{
+public:
+  /// sink of OnOffApplication Tx: node id, application index, packet
+  typedef Callback<void, uint32_t, uint32_t, Ptr<const Packet> > PacketSink;
+  /// sink of MobilityModel CourseChange: node id, mobility model
+  typedef Callback<void, uint32_t, Ptr<const MobilityModel> > CourseChangeSink;
+
+  /**
+   * \brief Connects the Tx trace of every OnOffApplication on the nodes
+   * \param c the nodes
+   * \param sink the sink
+   * \return the number of applications connected
+   */
+  uint32_t ConnectOnOffTx (NodeContainer &c, PacketSink sink);
+
+  /**
+   * \brief Connects the CourseChange trace of the mobility model of the nodes
+   * \param c the nodes
+   * \param sink the sink
+   * \return the number of mobility models connected
+   */
+  uint32_t ConnectCourseChange (NodeContainer &c, CourseChangeSink sink);
+
+private:
+  struct PacketSlot
+  {
+    PacketSink sink;
+    uint32_t node;
+    uint32_t app;
+  };
+
+  struct CourseChangeSlot
+  {
+    CourseChangeSink sink;
+    uint32_t node;
+  };
+
+  static void OnOffTx (PacketSlot *slot, Ptr<const Packet> packet);
+
+  static void CourseChange (CourseChangeSlot *slot, Ptr<const MobilityModel> mobility);
+
+  // the traces hold pointers into these, so they are only ever appended to
+  std::deque<PacketSlot> m_packetSlots;
+  std::deque<CourseChangeSlot> m_courseChangeSlots;
+};
+
+uint32_t
+TraceHookup::ConnectOnOffTx (NodeContainer &c, PacketSink sink)
+{
+  uint32_t n = 0;
+  for (NodeContainer::Iterator node = c.Begin (); node != c.End (); ++node)
+    {
+      for (uint32_t app = 0; app < (*node)->GetNApplications (); app++)
+        {
+          Ptr<OnOffApplication> onoff = DynamicCast<OnOffApplication> ((*node)->GetApplication (app));
+          if (onoff == 0)
+            {
+              continue;
+            }
+          PacketSlot slot;
+          slot.sink = sink;
+          slot.node = (*node)->GetId ();
+          slot.app = app;
+          m_packetSlots.push_back (slot);
+          onoff->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&TraceHookup::OnOffTx, &m_packetSlots.back ()));
+          n++;
+        }
+    }
+  return n;
+}
+
+uint32_t
+TraceHookup::ConnectCourseChange (NodeContainer &c, CourseChangeSink sink)
+{
+  uint32_t n = 0;
+  for (NodeContainer::Iterator node = c.Begin (); node != c.End (); ++node)
+    {
+      Ptr<MobilityModel> mobility = (*node)->GetObject<MobilityModel> ();
+      if (mobility == 0)
+        {
+          continue;
+        }
+      CourseChangeSlot slot;
+      slot.sink = sink;
+      slot.node = (*node)->GetId ();
+      m_courseChangeSlots.push_back (slot);
+      mobility->TraceConnectWithoutContext ("CourseChange",
+                                            MakeBoundCallback (&TraceHookup::CourseChange, &m_courseChangeSlots.back ()));
+      n++;
+    }
+  return n;
+}
+
+void
+TraceHookup::OnOffTx (PacketSlot *slot, Ptr<const Packet> packet)
+{
+  slot->sink (slot->node, slot->app, packet);
+}
+
+void
+TraceHookup::CourseChange (CourseChangeSlot *slot, Ptr<const MobilityModel> mobility)
+{
+  slot->sink (slot->node, mobility);
+}
+
+class WifiApp
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  WifiApp ();
+
+  /**
+   * \brief Destructor
+   * \return none
+   */
+  virtual ~WifiApp ();
+
+  /**
+   * \brief Enacts simulation of an ns-3 wifi application
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return none
+   */
+  void Simulate (int argc, char **argv);
+
+  /**
+   * \brief First half of Simulate: handles the program inputs and
+   * configures the topology, up to and including ConfigureTracing
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return none
+   */
+  void SetUp (int argc, char **argv);
+
+  /**
+   * \brief Second half of Simulate: runs the simulation set up by SetUp
+   * and processes its outputs.  May be called in a process forked after
+   * SetUp, once per forked process
+   * \return none
+   */
+  void Finish ();
+
+  /**
+   * \brief Returns the timing of the phases of the last Simulate call
+   * \return the phase profiler
+   */
+  const PhaseProfiler & GetProfiler () const;
+
+protected:
+  /**
+   * \brief Sets default attribute values
+   * \return none
+   */
+  virtual void SetDefaultAttributeValues ();
+
+  /**
+   * \brief Process command line arguments
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return none
+   */
+  virtual void ParseCommandLineArguments (int argc, char **argv);
+
+  /**
+   * \brief Configure nodes
+   * \return none
+   */
+  virtual void ConfigureNodes ();
+
+  /**
+   * \brief Configure channels
+   * \return none
+   */
+  virtual void ConfigureChannels ();
+
+  /**
+   * \brief Configure devices
+   * \return none
+   */
+  virtual void ConfigureDevices ();
+
+  /**
+   * \brief Configure mobility
+   * \return none
+   */
+  virtual void ConfigureMobility ();
+
+  /**
+   * \brief Configure applications
+   * \return none
+   */
+  virtual void ConfigureApplications ();
+
+  /**
+   * \brief Configure tracing
+   * \return none
+   */
+  virtual void ConfigureTracing ();
+
+  /**
+   * \brief Run the simulation
+   * \return none
+   */
+  virtual void RunSimulation ();
+
+  /**
+   * \brief Process outputs
+   * \return none
+   */
+  virtual void ProcessOutputs ();
+
+  /**
+   * \brief Called with the phase profile once Simulate has finished
+   * \return none
+   */
+  virtual void ProcessProfile ();
+
+  /**
+   * \brief Restores the outputs of a run that has been done before
+   * \return true if the outputs were restored, in which case Simulate
+   * skips the run
+   */
+  virtual bool RestoreOutputs ();
+
+  /**
+   * \brief Writes the phase profile as CSV
+   * \param filename the file to (over)write
+   * \return none
+   */
+  void WriteProfile (std::string filename) const;
+
+private:
+  PhaseProfiler m_profiler;
+};
+
+WifiApp::WifiApp ()
+{
+}
+
+WifiApp::~WifiApp ()
+{
+}
+
+void
+WifiApp::Simulate (int argc, char **argv)
+{
+  // Simulator Program Flow:
+  // (source:  NS-3 Annual Meeting, May, 2014, session 2 slides 6, 28)
+  //   (HandleProgramInputs:)
+  //   SetDefaultAttributeValues
+  //   ParseCommandLineArguments
+  //   (ConfigureTopology:)
+  //   ConfigureNodes
+  //   ConfigureChannels
+  //   ConfigureDevices
+  //   ConfigureMobility
+  //   ConfigureApplications
+  //     e.g AddInternetStackToNodes
+  //         ConfigureIpAddressingAndRouting
+  //         configureSendMessages
+  //   ConfigureTracing
+  //   RunSimulation
+  //   ProcessOutputs
+
+  if (RestoreOutputs ())
+    {
+      return;
+    }
+  SetUp (argc, argv);
+  Finish ();
+}
+
+void
+WifiApp::SetUp (int argc, char **argv)
+{
+  PhaseProfiler::SetActive (&m_profiler);
+  m_profiler.Begin ("Simulate");
+  m_profiler.Begin ("SetDefaultAttributeValues");
+  SetDefaultAttributeValues ();
+  m_profiler.End ();
+  m_profiler.Begin ("ParseCommandLineArguments");
+  ParseCommandLineArguments (argc, argv);
+  m_profiler.End ();
+  m_profiler.Begin ("ConfigureNodes");
+  ConfigureNodes ();
+  m_profiler.End ();
+  m_profiler.Begin ("ConfigureChannels");
+  ConfigureChannels ();
+  m_profiler.End ();
+  m_profiler.Begin ("ConfigureDevices");
+  ConfigureDevices ();
+  m_profiler.End ();
+  m_profiler.Begin ("ConfigureMobility");
+  ConfigureMobility ();
+  m_profiler.End ();
+  m_profiler.Begin ("ConfigureApplications");
+  ConfigureApplications ();
+  m_profiler.End ();
+  m_profiler.Begin ("ConfigureTracing");
+  ConfigureTracing ();
+  m_profiler.End ();
+}
+
+void
+WifiApp::Finish ()
+{
+  // after a fork the profiler object lives at the same address, but make
+  // sure the phases below are attributed to it
+  PhaseProfiler::SetActive (&m_profiler);
+  m_profiler.Begin ("RunSimulation");
+  RunSimulation ();
+  m_profiler.End ();
+  m_profiler.Begin ("ProcessOutputs");
+  ProcessOutputs ();
+  m_profiler.End ();
+  m_profiler.End ();
+  PhaseProfiler::SetActive (0);
+
+  ProcessProfile ();
+}
+
+void
+WifiApp::ProcessProfile ()
+{
+}
+
+bool
+WifiApp::RestoreOutputs ()
+{
+  return false;
+}
+
+const PhaseProfiler &
+WifiApp::GetProfiler () const
+{
+  return m_profiler;
+}
+
+void
+WifiApp::WriteProfile (std::string filename) const
+{
+  FileHandle fh (filename);
+  fh.WriteHeader ("phase,depth,wall,cpu,rssDeltaKb,events");
+  for (uint32_t i = 0; i < m_profiler.GetN (); i++)
+    {
+      const PhaseProfiler::Phase &phase = m_profiler.Get (i);
+      std::ostringstream oss;
+      oss << phase.name << "," << phase.depth << "," << phase.wallSeconds << ","
+          << phase.cpuSeconds << "," << phase.rssDeltaKb << "," << phase.events;
+      fh.WriteData (oss.str ());
+    }
+}
+
+void
+WifiApp::SetDefaultAttributeValues ()
+{
+}
+
+void
+WifiApp::ParseCommandLineArguments (int argc, char **argv)
+{
+}
+
+void
+WifiApp::ConfigureNodes ()
+{
+}
+
+void
+WifiApp::ConfigureChannels ()
+{
+}
+
+void
+WifiApp::ConfigureDevices ()
+{
+}
+
+void
+WifiApp::ConfigureMobility ()
+{
+}
+
+void
+WifiApp::ConfigureApplications ()
+{
+}
+
+void
+WifiApp::ConfigureTracing ()
+{
+}
+
+void
+WifiApp::RunSimulation ()
+{
+}
+
+void
+WifiApp::ProcessOutputs ()
+{
+}
+
+class Experiment : public WifiApp
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  Experiment ();
+  Experiment(double yDist,uint32_t mobility,uint32_t nodes,uint32_t macMode,uint32_t lossmodel,double txp,FileHandle* fh);
+  Experiment(FileHandle* fh,std::string rate,uint32_t nodes);
+  Experiment(FileHandle* fh,int slot,int guard);
+  Experiment(FileHandle* fh,uint32_t size,int slot);
+  ~Experiment();
+
+  /**
+   * \brief Returns the file the output row of this run is written to
+   * \return the output file handle
+   */
+  FileHandle* GetFileHandle ();
+
+  /**
+   * \brief Redirects the output row of this run to another file
+   * \param fh the output file handle
+   * \return none
+   */
+  void SetFileHandle (FileHandle* fh);
+
+  /**
+   * \brief Sets the NetAnim trace file written during the run
+   * \param animFile the animation file name (empty for no animation trace)
+   * \return none
+   */
+  void SetAnimFile (std::string animFile);
+
+  /**
+   * \brief Returns the routing helper, which holds the packet statistics
+   * of the run
+   * \return the routing helper
+   */
+  Ptr<RoutingHelper> GetRoutingHelper ();
+
+  /**
+   * \brief Returns the OnOff packet size of this run
+   * \return the packet size in bytes
+   */
+  uint32_t GetPacketSize ();
+
+  /**
+   * \brief Returns the OnOff data rate of this run
+   * \return the data rate, e.g. 2048bps
+   */
+  std::string GetRate ();
+
+  /**
+   * \brief Describes this run for the result cache: every parameter that
+   * can change the output row, one name=value line each
+   * \return the description
+   */
+  std::string GetCacheDescription ();
+
+  /**
+   * \brief Returns the lines of the cache description that hold the
+   * parameters of this run
+   * \return the description lines
+   */
+  std::string GetParameterDescription ();
+
+  /**
+   * \brief Returns the cache hit RestoreOutputs picked for verification
+   * \return the cached row, as CSV, or "" if there is none
+   */
+  std::string GetCachedRow ();
+
+  /**
+   * \brief Sets the cache hit the outputs of this run are checked against
+   * \param row the cached row, as CSV, or "" for none
+   * \return none
+   */
+  void SetCachedRow (std::string row);
+
+  /**
+   * \brief Changes the application parameters of this run.  If the
+   * applications are already installed (i.e. after SetUp) they are
+   * reconfigured in place, so one topology can serve several variants
+   * \param packetSize the OnOff packet size in bytes
+   * \param rate the OnOff data rate
+   * \return none
+   */
+  void SetApplicationVariant (uint32_t packetSize, std::string rate);
+
+  /**
+   * \brief Returns the layout of the output row of this run
+   * \return the schema of the run's scenario
+   */
+  ResultSchema GetSchema ();
+
+  /**
+   * \brief Writes the cached output row of this run, if the result cache
+   * has one (and the hit is not picked for verification)
+   * \return true if the row was written and the run can be skipped
+   */
+  virtual bool RestoreOutputs ();
+
+  /**
+   * \brief Returns a tag identifying the parameters of this run: the
+   * main ones, readable, and a hash of all of them
+   * \return the tag, usable in file names, e.g.
+   * s2-n20-mac1-slot50-guard10-size512-2048bps-h1a2b3c4d
+   */
+  std::string GetRunTag ();
+
+  /**
+   * \brief Sets a parameter by name, as in a scenario file
+   * \param name the parameter, one of nodes, sinks, protocol, lossModel,
+   * fading, mobility, rate, speed, pause, macMode, baseHeight, nodeHeight,
+   * baseGain, nodeGain, frequency, packetSize, totaltime, txp, yPos,
+   * slotTime, guardTime or scenario
+   * \param value the value
+   * \return false if the name is unknown or the value does not parse
+   */
+  bool SetParameter (std::string name, std::string value);
+
+  /**
+   * \brief Estimates the relative cost of this run from its size: the
+   * node-seconds simulated, weighted by the packets each node sends
+   * \return the cost, in arbitrary units
+   */
+  double EstimateCost ();
+
+  /**
+   * \brief Returns the parameters of this run that its cost depends on
+   * \return the features, as the cost model sees them
+   */
+  RunFeatures GetRunFeatures ();
+
+protected:
+  /**
+   * \brief Sets default attribute values
+   * \return none
+   */
+  virtual void SetDefaultAttributeValues ();
+
+  /**
+   * \brief Process command line arguments
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return none
+   */
+  virtual void ParseCommandLineArguments (int argc, char **argv);
+
+  /**
+   * \brief Configure nodes
+   * \return none
+   */
+  virtual void ConfigureNodes ();
+
+  /**
+   * \brief Configure channels
+   * \return none
+   */
+  virtual void ConfigureChannels ();
+
+  /**
+   * \brief Configure devices
+   * \return none
+   */
+  virtual void ConfigureDevices ();
+
+  /**
+   * \brief Configure mobility
+   * \return none
+   */
+  virtual void ConfigureMobility ();
+
+  /**
+   * \brief Configure applications
+   * \return none
+   */
+  virtual void ConfigureApplications ();
+
+  /**
+   * \brief Configure tracing
+   * \return none
+   */
+  virtual void ConfigureTracing ();
+
+  /**
+   * \brief Run the simulation
+   * \return none
+   */
+  virtual void RunSimulation ();
+
+  /**
+   * \brief Process outputs
+   * \return none
+   */
+  virtual void ProcessOutputs ();
+
+  /**
+   * \brief Writes the phase profile of the run
+   * \return none
+   */
+  virtual void ProcessProfile ();
+
+private:
+  /**
+   * \brief Run the simulation
+   * \return none
+   */
+  void Run ();
+
+  /**
+   * \brief Run the simulation
+   * \return none
+   */
+  void CommandSetup (int argc, char **argv);
+
+  /**
+   * \brief Samples and resets the interval counters of the routing stats.
+   * This is scheduled and called once per sampling window
+   * \return none
+   */
+  void CheckThroughput ();
+
+  /**
+   * \brief Adds a sample of the interval counters since the previous
+   * sample, if any time has passed, and resets them
+   * \return none
+   */
+  void SampleThroughput ();
+
+  /**
+   * \brief Returns whether the confidence intervals of throughput, delay
+   * and PDR have all reached the requested relative precision
+   * \return true if the run may stop
+   */
+  bool HasConverged ();
+
+  /**
+   * \brief Detects the warm-up on the sampled throughput and delay and
+   * recomputes the batch means from the sampling windows after it
+   * \return none
+   */
+  void EstimateSteadyState ();
+
+  /**
+   * \brief Returns the end of the detected warm-up
+   * \return the warm-up length in seconds, 0 if none was removed
+   */
+  double GetWarmupTime ();
+
+  /**
+   * \brief Returns a per-run output file name derived from a base name
+   * \param base the file name, e.g. experiment.output.csv
+   * \return the base name with the run tag inserted before ".csv"
+   */
+  std::string GetRunFileName (std::string base);
+
+  /**
+   * \brief Writes one CSV row per node that sent or delivered traffic
+   * \param filename the file to (over)write
+   * \return none
+   */
+  void WriteNodeReport (std::string filename);
+
+  /**
+   * \brief Set up log file
+   * \return none
+   */
+  void SetupLogFile ();
+
+  /**
+   * \brief Set up logging
+   * \return none
+   */
+  void SetupLogging ();
+
+  /**
+   * \brief Configure default attributes
+   * \return none
+   */
+  void ConfigureDefaults ();
+
+  /**CommandLine cmd;
+   * \brief Set up the adhoc mobility nodes
+   * \return none
+   */
+//   void SetupAdhocMobilityNodes ();
+
+  /**
+   * \brief Set up the adhoc devices
+   * \return none
+   */
+//   void SetupAdhocDevices ();
+
+  /**
+   * \brief Set up generation of IEEE 1609 WAVE messages,
+   * as a Basic Safety Message (BSM).  The BSM is typically
+   * a ~200-byte packets broadcast by all vehicles at a nominal
+   * rate of 10 Hz
+   * \return none
+   */
+//   void SetupWaveMessages ();
+
+  /**
+   * \brief Set up generation of packets to be routed
+   * through the vehicular network
+   * \return none
+   */
+  void SetupRoutingMessages ();
+
+  /**
+   * \brief Set up a prescribed scenario
+   * \return none
+   */
+  void SetupScenario ();
+
+  /**
+   * \brief Write the header line to the CSV file1
+   * \return none
+   */
+  void WriteCsvHeader ();
+
+  /**
+   * \brief Set up configuration parameter from the global variables
+   * \return none
+   */
+//   void SetConfigFromGlobals ();
+
+//   /**
+//    * \brief Set up the global variables from the configuration parameters
+//    * \return none
+//    */
+//   void SetGlobalsFromConfig ();
+
+  static void
+  CourseChange (Experiment *experiment, uint32_t node, Ptr<const MobilityModel> mobility);
+
+  uint32_t m_port;
+  std::string m_CSVfileName;
+  std::string m_CSVfileName2;
+  uint32_t m_nSinks;
+  std::string m_protocolName;
+  double m_txp;
+  bool m_traceMobility;
+  uint32_t m_protocol;
+
+  uint32_t m_lossModel;
+  uint32_t m_fading;
+  std::string m_lossModelName;
+
+  std::string m_logFile;
+  uint32_t m_mobility;
+  uint32_t m_nNodes;
+  uint32_t m_nBase; //no of Base stations
+  double m_TotalSimTime;
+  std::string m_rate;
+  std::string m_trName;
+  int m_nodeSpeed; //in m/s
+  int m_nodePause; //in s
+  int m_verbose;
+  std::ofstream m_os;
+  NetDeviceContainer m_TxDevices;
+  NetDeviceContainer m_baseDevices;
+  NetDeviceContainer m_allDevices;
+  Ipv4InterfaceContainer m_TxInterfaces;
+  Ipv4InterfaceContainer m_baseInterfaces;
+  Ipv4InterfaceContainer m_allInterfaces;
+  uint32_t m_macMode;
+  int m_routingTables;
+  int m_asciiTrace;
+  int m_pcap;
+  double m_freq; //0 5.8Ghz 1 2.4Ghz
+  double m_baseAntennaHeight; //Base station Height 
+  double m_baseAntennaGain;
+  double m_nodeAntennaGain;
+  double m_nodeAntennaHeight;
+  int m_guardTime;
+  int m_slotTime;
+  int m_interFrameTime;
+  uint32_t m_packetSize;
+  Ptr<RoutingHelper> m_routingHelper;
+  // Ptr<FlowMonitor> m_monitor;
+  int m_log;
+  // used to get consistent random numbers across scenarios
+  int64_t m_streamIndex;
+  NodeContainer m_TxNodes;
+  NodeContainer m_baseNodes;
+  NodeContainer m_allNodes;
+  std::string m_exp;
+  int m_cumulativeCaptureStart;
+  uint32_t m_scenario;
+  // FlowMonitorHelper m_flowmon;
+  double m_yPos;
+  std::string m_animFile;
+  Time m_sampleWindow;
+  ThroughputSeries m_throughputSeries;
+  std::string m_cachedRow; // cache hit being verified
+  double m_stopPrecision;
+  uint32_t m_stopBatches;
+  double m_stopTime;
+  uint64_t m_rssKb; // resident set size at the end of the run
+  bool m_warmupTrim;
+  uint32_t m_warmupSamples; // sampling windows in the warm-up
+  uint32_t m_nextConvergenceCheck; // number of windows
+  BatchMeans m_throughputMeans; // kbps
+  BatchMeans m_delayMeans; // seconds
+  BatchMeans m_pdrMeans; // %
+  TraceHookup m_traceHookup;
+  EventLog m_eventLog; // open during the run with --EventLog
+  MemoryReport m_memoryReport; // started during the run with --MemoryReport
+
+  FileHandle* m_fh;
+};
+
+Experiment::Experiment()
+ :m_port (9),
+    m_CSVfileName ("experiment.output.csv"),
+    m_CSVfileName2 ("experiment.output2.csv"),
+    m_nSinks (5),
+    m_protocolName ("protocol"),
+    m_traceMobility (false),
+    // Differnt Routing Protocls
+    m_protocol (0),
+    // Different Loss models
+    m_lossModel (4),
+    m_fading (0),
+    m_lossModelName (""),
+    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
+    m_mobility (2),
+    m_nNodes (10),
+    m_nBase(1),
+    m_TotalSimTime (300),
+    //OnoffApplication frequency
+    m_rate ("2048bps"),
+    m_trName ("experiment-compare"),
+    m_nodeSpeed (50),
+    m_nodePause (0),
+    m_verbose (0),
+    m_macMode (1),
+    m_routingTables (0),
+    m_asciiTrace (0),
+    m_pcap (0),
+    m_log (1),
+    m_streamIndex (0),
+    m_TxNodes (),
+    m_exp (""),
+    m_cumulativeCaptureStart (0),
+    m_freq(5.8e9),
+    m_baseAntennaHeight(50),
+    m_nodeAntennaHeight(9),
+    m_baseAntennaGain(18.6),
+    m_nodeAntennaGain(14.6),
+    m_allNodes(),
+    m_txp(40000),
+    m_guardTime(100),
+    m_interFrameTime(0),
+    m_slotTime(1100),
+    m_packetSize(64),
+    m_yPos(30000),
+    m_scenario(0),
+    m_animFile("experiment.xml"),
+    m_fh(0)
+{
+  m_routingHelper = CreateObject<RoutingHelper> ();
+  m_log = 1;
+}
+
+Experiment::Experiment(double yDist,uint32_t mobility,uint32_t nodes,uint32_t macMode,uint32_t lossmodel,double txp,FileHandle* fh)
+:m_port (9),
+    m_CSVfileName ("experiment.output.csv"),
+    m_CSVfileName2 ("experiment.output2.csv"),
+    m_nSinks (5),
+    m_protocolName ("protocol"),
+    m_traceMobility (false),
+    // Differnt Routing Protocls
+    m_protocol (0),
+    // Different Loss models
+    m_lossModel (1),
+    m_fading (0),
+    m_lossModelName (""),
+    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
+    m_mobility (2),
+    m_nNodes (50),
+    m_nBase(1),
+    m_TotalSimTime (300),
+    //OnoffApplication frequency
+    m_rate ("2048bps"),
+    m_trName ("experiment-compare"),
+    m_nodeSpeed (50),
+    m_nodePause (0),
+    m_verbose (0),
+    m_macMode (0),
+    m_routingTables (0),
+    m_asciiTrace (0),
+    m_pcap (0),
+    m_log (1),
+    m_streamIndex (0),
+    m_TxNodes (),
+    m_exp (""),
+    m_cumulativeCaptureStart (0),
+    m_freq(5.8e9),
+    m_baseAntennaHeight(50),
+    m_nodeAntennaHeight(9),
+    m_baseAntennaGain(18.6),
+    m_nodeAntennaGain(14.6),
+    m_allNodes(),
+    m_txp(4),
+    m_guardTime(100),
+    m_interFrameTime(0),
+    m_slotTime(1100),
+    m_packetSize(64),
+    m_yPos(0),
+    m_scenario(0),
+    m_animFile("experiment.xml")
+{
+  m_yPos = yDist;
+  m_mobility = mobility;
+  m_nNodes = nodes;
+  m_macMode = macMode;
+  m_lossModel = m_lossModel;
+  m_txp = txp;
+  m_routingHelper = CreateObject<RoutingHelper> ();
+  m_log = 1;
+  m_fh = fh;
+}
+
+Experiment::Experiment(FileHandle* fh,std::string rate,uint32_t nodes)
+:m_port (9),
+    m_CSVfileName ("experiment.output.csv"),
+    m_CSVfileName2 ("experiment.output2.csv"),
+    m_nSinks (5),
+    m_protocolName ("protocol"),
+    m_traceMobility (false),
+    // Differnt Routing Protocls
+    m_protocol (0),
+    // Different Loss models
+    m_lossModel (4),
+    m_fading (0),
+    m_lossModelName (""),
+    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
+    m_mobility (2),
+    m_nNodes (10),
+    m_nBase(1),
+    m_TotalSimTime (300),
+    //OnoffApplication frequency
+    m_rate ("2048bps"),
+    m_trName ("experiment-compare"),
+    m_nodeSpeed (50),
+    m_nodePause (0),
+    m_verbose (0),
+    m_macMode (1),
+    m_routingTables (0),
+    m_asciiTrace (0),
+    m_pcap (0),
+    m_log (1),
+    m_streamIndex (0),
+    m_TxNodes (),
+    m_exp (""),
+    m_cumulativeCaptureStart (0),
+    m_freq(5.8e9),
+    m_baseAntennaHeight(50),
+    m_nodeAntennaHeight(9),
+    m_baseAntennaGain(18.6),
+    m_nodeAntennaGain(14.6),
+    m_allNodes(),
+    m_txp(40000),
+    m_guardTime(100),
+    m_interFrameTime(0),
+    m_slotTime(1100),
+    m_packetSize(64),
+    m_yPos(30000),
+    m_scenario(0),
+    m_animFile("experiment.xml")
+{
+  m_nNodes = nodes;
+  m_routingHelper = CreateObject<RoutingHelper> ();
+  m_log = 1;
+  m_fh = fh;
+  m_rate = rate;
+  m_scenario = 1;
+}
+
+
+Experiment::Experiment(FileHandle* fh,int slot,int guard)
+:m_port (9),
+    m_CSVfileName ("experiment.output.csv"),
+    m_CSVfileName2 ("experiment.output2.csv"),
+    m_nSinks (5),
+    m_protocolName ("protocol"),
+    m_traceMobility (false),
+    // Differnt Routing Protocls
+    m_protocol (0),
+    // Different Loss models
+    m_lossModel (4),
+    m_fading (0),
+    m_lossModelName (""),
+    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
+    m_mobility (2),
+    m_nNodes (10),
+    m_nBase(1),
+    m_TotalSimTime (300),
+    //OnoffApplication frequency
+    m_rate ("2048bps"),
+    m_trName ("experiment-compare"),
+    m_nodeSpeed (50),
+    m_nodePause (0),
+    m_verbose (0),
+    m_macMode (1),
+    m_routingTables (0),
+    m_asciiTrace (0),
+    m_pcap (0),
+    m_log (1),
+    m_streamIndex (0),
+    m_TxNodes (),
+    m_exp (""),
+    m_cumulativeCaptureStart (0),
+    m_freq(5.8e9),
+    m_baseAntennaHeight(50),
+    m_nodeAntennaHeight(9),
+    m_baseAntennaGain(18.6),
+    m_nodeAntennaGain(14.6),
+    m_allNodes(),
+    m_txp(40000),
+    m_guardTime(100),
+    m_interFrameTime(0),
+    m_slotTime(1100),
+    m_packetSize(64),
+    m_yPos(30000),
+    m_scenario(0),
+    m_animFile("experiment.xml")
+{
+  
+  m_routingHelper = CreateObject<RoutingHelper> ();
+  m_log = 1;
+  m_fh = fh;
+  m_scenario = 2;
+  m_slotTime = slot;
+  m_guardTime = guard;
+}
+
+
+Experiment::Experiment(FileHandle* fh,uint32_t packet,int slot)
+:m_port (9),
+    m_CSVfileName ("experiment.output.csv"),
+    m_CSVfileName2 ("experiment.output2.csv"),
+    m_nSinks (5),
+    m_protocolName ("protocol"),
+    m_traceMobility (false),
+    // Differnt Routing Protocls
+    m_protocol (0),
+    // Different Loss models
+    m_lossModel (4),
+    m_fading (0),
+    m_lossModelName (""),
+    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
+    m_mobility (2),
+    m_nNodes (10),
     m_nBase(1),
     m_TotalSimTime (300),
     //OnoffApplication frequency
@@ -1251,548 +5904,3089 @@ Experiment::Experiment(FileHandle* fh,std::string rate,uint32_t nodes)
     m_slotTime(1100),
     m_packetSize(64),
     m_yPos(30000),
-    m_scenario(0)  
+    m_scenario(0),
+    m_animFile("experiment.xml")
+{
+  m_routingHelper = CreateObject<RoutingHelper> ();
+  m_log = 1;
+  m_fh = fh;
+  m_packetSize = packet;  
+  m_slotTime = slot;
+  m_scenario = 3;
+}
+
+
+Experiment::~Experiment ()
+{
+}
+
+FileHandle*
+Experiment::GetFileHandle ()
+{
+  return m_fh;
+}
+
+void
+Experiment::SetFileHandle (FileHandle* fh)
+{
+  m_fh = fh;
+}
+
+void
+Experiment::SetAnimFile (std::string animFile)
+{
+  m_animFile = animFile;
+}
+
+Ptr<RoutingHelper>
+Experiment::GetRoutingHelper ()
+{
+  return m_routingHelper;
+}
+
+uint32_t
+Experiment::GetPacketSize ()
+{
+  return m_packetSize;
+}
+
+std::string
+Experiment::GetRate ()
+{
+  return m_rate;
+}
+
+std::string
+Experiment::GetCachedRow ()
+{
+  return m_cachedRow;
+}
+
+void
+Experiment::SetCachedRow (std::string row)
+{
+  m_cachedRow = row;
+}
+
+ResultSchema
+Experiment::GetSchema ()
+{
+  return ResultSchema::ForScenario (m_scenario);
+}
+
+void
+Experiment::SetApplicationVariant (uint32_t packetSize, std::string rate)
+{
+  m_packetSize = packetSize;
+  m_rate = rate;
+  // a different run: a cache hit picked for verification was another point's
+  m_cachedRow = "";
+  Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (m_packetSize));
+  Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue (m_rate));
+  // the applications have not started yet, so the new values apply from
+  // the first packet on
+  for (uint32_t i = 0; i < m_allNodes.GetN (); i++)
+    {
+      Ptr<Node> node = m_allNodes.Get (i);
+      for (uint32_t j = 0; j < node->GetNApplications (); j++)
+        {
+          Ptr<OnOffApplication> onoff = DynamicCast<OnOffApplication> (node->GetApplication (j));
+          if (onoff != 0)
+            {
+              onoff->SetAttribute ("PacketSize", UintegerValue (m_packetSize));
+              onoff->SetAttribute ("DataRate", StringValue (m_rate));
+            }
+        }
+    }
+}
+void Experiment::ParseCommandLineArguments(int argc, char** argv){
+
+  CommandLine cmd;
+
+  cmd.AddValue ("totaltime", "Simulation end time", m_TotalSimTime);
+  cmd.AddValue ("nodes", "Number of nodes (i.e. vehicles)", m_nNodes);
+  cmd.AddValue ("sinks", "Number of routing sinks", m_nSinks);
+  cmd.AddValue ("traceMobility", "Enable mobility tracing", m_traceMobility);
+  cmd.AddValue ("protocol", "0=global routing;1=OLSR;2=AODV;3=DSDV;4=DSR;5=static single-hop cell", m_protocol);
+  cmd.AddValue ("lossModel", "1=Friis;2=ItuR1411Los;3=TwoRayGround;4=LogDistance", m_lossModel);
+  cmd.AddValue ("fading", "0=None;1=Nakagami;(buildings=1 overrides)", m_fading);
+  cmd.AddValue ("logFile", "Log file", m_logFile);
+  cmd.AddValue ("mobility", "1=RandomWalk2d;2=RandomWayPoint", m_mobility);
+  cmd.AddValue ("rate in bps", "Rate", m_rate);
+  cmd.AddValue ("speed", "Node speed (m/s)", m_nodeSpeed);
+  cmd.AddValue ("pause", "Node pause (s)", m_nodePause);
+  cmd.AddValue ("verbose", "0=quiet;1=verbose", m_verbose);
+  cmd.AddValue ("macMode", "0=CSMA, 1=TDMA", m_macMode);
+  cmd.AddValue("baseHeight","Antenna Height for base station in meters",m_baseAntennaHeight);
+  cmd.AddValue("nodeHeight","Antenna Height for Node in meters",m_nodeAntennaHeight);
+  cmd.AddValue("baseGain","Antenna Gain for base station",m_baseAntennaGain);
+  cmd.AddValue("nodeGain","Antenna Gain for ABE",m_nodeAntennaGain);
+  cmd.AddValue("frequency","Operating frequency in hz",m_freq);
+  cmd.AddValue("packetSize","Packet Size in bytes",m_packetSize);
+  SetupScenario();
+
+}
+
+void Experiment::ConfigureNodes(){
+  m_TxNodes.Create(m_nNodes);
+  m_baseNodes.Create(m_nBase);
+  for(uint32_t i=0;i<m_nBase;i++){
+    m_allNodes.Add(m_baseNodes.Get(i));
+  }
+  for(uint32_t i=0;i<m_nNodes;i++){
+    m_allNodes.Add(m_TxNodes.Get(i));
+  }
+}
+
+void Experiment::ConfigureChannels(){
+
+ 
+
+  //Configuring the mac_layer
+  if(m_macMode == 0){
+
+     if (m_lossModel == 1)
+    {
+      m_lossModelName = "ns3::FriisPropagationLossModel";
+    }
+    else if (m_lossModel == 2)
+      {
+        m_lossModelName = "ns3::ItuR1411LosPropagationLossModel";
+      }
+    else if (m_lossModel == 3)
+      {
+        m_lossModelName = "ns3::TwoRayGroundPropagationLossModel";
+      }
+    else if (m_lossModel == 4)
+      {
+        m_lossModelName = "ns3::LogDistancePropagationLossModel";
+      }
+    else
+      {
+        // Unsupported propagation loss model.
+        // Treating as ERROR
+        NS_LOG_ERROR ("Invalid propagation loss model specified.  Values must be [1-4], where 1=Friis;2=ItuR1411Los;3=TwoRayGround;4=LogDistance");
+      }
+    
+  //BaseStationChannel
+    YansWifiChannelHelper WifiChannel;
+    WifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
+
+    if (m_lossModel == 3)
+      {
+        // two-ray requires antenna height (else defaults to Friss)
+        WifiChannel.AddPropagationLoss (m_lossModelName, "Frequency", DoubleValue (m_freq), "HeightAboveZ", DoubleValue (m_baseAntennaHeight));
+      }
+    else
+      {
+        WifiChannel.AddPropagationLoss (m_lossModelName, "Frequency", DoubleValue (m_freq));
+      }
+
+
+    Ptr<YansWifiChannel> Channel = WifiChannel.Create ();
+    
+
+    YansWifiPhyHelper basePhy = YansWifiPhyHelper::Default();
+    basePhy.SetChannel(Channel);
+    
+    YansWifiPhyHelper nodePhy = YansWifiPhyHelper::Default();
+    nodePhy.SetChannel(Channel);
+
+    basePhy.SetPcapDataLinkType (YansWifiPhyHelper::DLT_IEEE802_11); //Tracing Stuff
+    nodePhy.SetPcapDataLinkType (YansWifiPhyHelper::DLT_IEEE802_11);
+
+    WifiHelper wifi;
+    if(m_verbose){
+      wifi.EnableLogComponents();
+    }
+
+
+    basePhy.Set("TxGain",DoubleValue(m_baseAntennaGain));
+    nodePhy.Set("TxGain",DoubleValue(m_nodeAntennaGain));
+
+    wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager");
+
+    NqosWifiMacHelper wifiMac = NqosWifiMacHelper::Default ();
+    Ssid ssid = Ssid("base-station");
+    wifiMac.SetType ("ns3::StaWifiMac",
+                "Ssid", SsidValue (ssid),
+                "ActiveProbing", BooleanValue (false));
+
+    m_TxDevices = wifi.Install(nodePhy,wifiMac,m_TxNodes);
+
+    wifiMac.SetType("ns3::ApWifiMac","Ssid",SsidValue(ssid));
+
+    m_baseDevices = wifi.Install(basePhy,wifiMac,m_baseNodes);
+
+    if (m_asciiTrace != 0)
+    {
+      AsciiTraceHelper ascii;
+      Ptr<OutputStreamWrapper> osw = ascii.CreateFileStream ( (m_trName +  "-base.tr").c_str ());
+      Ptr<OutputStreamWrapper> osw1 = ascii.CreateFileStream ( (m_trName +  "-sta.tr").c_str ());
+      basePhy.EnableAsciiAll (osw);
+      nodePhy.EnableAsciiAll (osw1);
+    }
+    if (m_pcap != 0)
+      {
+        basePhy.EnablePcapAll ("base-station-pcap");
+        nodePhy.EnablePcapAll ("node-pcap");
+      }
+
+    for(uint32_t i=0;i<m_nBase;i++){
+      m_allDevices.Add(m_baseDevices.Get(i));
+    }
+    for(uint32_t i=0;i<m_nNodes;i++){
+      m_allDevices.Add(m_TxDevices.Get(i));
+    }
+
+  }
+  else if(m_macMode == 1){
+    
+    //TBD STDMA / TDMA
+    TdmaHelper tdma = TdmaHelper(m_allNodes.GetN(),m_allNodes.GetN());
+    TdmaControllerHelper controller;
+    controller.Set ("SlotTime", TimeValue (MicroSeconds (m_slotTime)));
+    controller.Set ("GuardTime", TimeValue (MicroSeconds (m_guardTime)));
+    controller.Set ("InterFrameTime", TimeValue (MicroSeconds (m_interFrameTime)));
+    tdma.SetTdmaControllerHelper (controller);
+    m_allDevices = tdma.Install (m_allNodes);
+
+    if(m_asciiTrace != 0){
+      AsciiTraceHelper ascii;
+      Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream (m_trName + "-tdma.tr");
+      tdma.EnableAsciiAll (stream);
+    }
+  }
+
+  
+  
+ 
+
+}
+
+void Experiment::ConfigureMobility(){
+
+
+  //Stationary base stations
+  MobilityHelper mobility;
+
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+                                    "MinX", DoubleValue (50.0),
+                                    "MinY", DoubleValue (0.0),
+                                    "DeltaX", DoubleValue (1000.0),
+                                    "DeltaY", DoubleValue (0.0),
+                                    "GridWidth", UintegerValue (m_nBase),
+                                    "LayoutType", StringValue ("RowFirst"));
+  mobility.Install (m_baseNodes);
+
+  m_streamIndex += mobility.AssignStreams (m_baseNodes, m_streamIndex);
+
+
+  std::stringstream ssSpeed;
+  ssSpeed << "ns3::UniformRandomVariable[Min=0.0|Max=" << m_nodeSpeed << "]";
+  std::stringstream ssPause;
+  ssPause << "ns3::ConstantRandomVariable[Constant=" << m_nodePause << "]";
+
+
+  if(m_mobility == 0){
+    //Stationary
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                  "MinX",DoubleValue(50.0),
+                                  "MinY",DoubleValue(m_yPos),
+                                  "DeltaX",DoubleValue(100.0),
+                                  "GridWidth",UintegerValue(m_nNodes),
+                                  "LayoutType",StringValue("RowFirst"));
+    mobility.Install(m_TxNodes);
+  }
+  else if(m_mobility == 1){
+    //Random Walk
+    ObjectFactory pos2;
+    pos2.SetTypeId ("ns3::RandomBoxPositionAllocator");
+    pos2.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=1500.0]"));
+    pos2.Set ("Y", StringValue ("ns3::UniformRandomVariable[Min=10.0|Max=1500.0]"));
+    Ptr<PositionAllocator> nodePositionAlloc = pos2.Create ()->GetObject<PositionAllocator> ();
+    m_streamIndex += nodePositionAlloc->AssignStreams (m_streamIndex);
+
+    mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                            "Bounds", RectangleValue (Rectangle (0, 1500, 10, 38000)),
+                            "Speed",StringValue(ssSpeed.str()),
+                            "Distance",DoubleValue(10.0));
+
+    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                  "MinX",DoubleValue(50.0),
+                                  "MinY",DoubleValue(100.0),
+                                  "DeltaX",DoubleValue(100.0),
+                                  "GridWidth",UintegerValue(10),
+                                  "LayoutType",StringValue("RowFirst"));
+
+    mobility.Install(m_TxNodes);
+
+    m_streamIndex += mobility.AssignStreams (m_TxNodes, m_streamIndex);
+
+  
+  }
+  else if(m_mobility == 2){
+    //Random Way Point
+    
+    ObjectFactory pos;
+    pos.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+    pos.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=100.0]"));
+    pos.Set ("Y", StringValue ("ns3::UniformRandomVariable[Min=10.0|Max=30000.0]"));
+    Ptr<PositionAllocator> taPositionAlloc = pos.Create ()->GetObject<PositionAllocator> ();
+
+
+    mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
+                                      "Speed", StringValue (ssSpeed.str ()),
+                                      "Pause", StringValue (ssPause.str ()),
+                                      "PositionAllocator", PointerValue (taPositionAlloc));
+
+    
+    mobility.Install(m_TxNodes);
+
+    m_streamIndex += mobility.AssignStreams (m_TxNodes, m_streamIndex);
+  }
+ 
+
+
+  m_traceHookup.ConnectCourseChange (m_allNodes, MakeBoundCallback (&Experiment::CourseChange, this));
+}
+
+void Experiment::ConfigureApplications(){
+  m_routingHelper->Install (m_allNodes,
+                          m_allDevices,
+                          m_allInterfaces,
+                          m_TotalSimTime,
+                          m_protocol,
+                          m_nSinks,
+                          m_routingTables);
+
+  m_traceHookup.ConnectOnOffTx (m_allNodes, MakeCallback (&RoutingHelper::OnOffTrace, m_routingHelper));
+  m_routingHelper->SetEventLog (&m_eventLog);
+
+  // oss.str ("");
+  // oss << "/NodeList/*/ApplicationList/*/$ns3::UdpEchoServer/Rx";
+  // Config::Connect (oss.str (), MakeCallback (&RoutingHelper::EchoServerTrace, m_routingHelper));
+
+  // oss.str ("");
+  // oss << "/NodeList/*/ApplicationList/*/$ns3::UdpEchoClient/Tx";
+  // Config::Connect (oss.str (), MakeCallback (&RoutingHelper::EchoClientTxTrace, m_routingHelper));
+
+  // oss.str ("");
+  // oss << "/NodeList/*/ApplicationList/*/$ns3::UdpEchoClient/Tx";
+  // Config::Connect (oss.str (), MakeCallback (&RoutingHelper::EchoClientRxTrace, m_routingHelper));
+
+  //Config::Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/EnergyDetectionThreshold", DoubleValue(-82.0));
+
+}
+
+void Experiment::ConfigureTracing(){
+
+}
+
+void Experiment::RunSimulation(){
+  NS_LOG_INFO ("Run Simulation.");
+
+  TimeValue sampleWindow;
+  g_sampleWindow.GetValue (sampleWindow);
+  m_sampleWindow = sampleWindow.Get ();
+  DoubleValue stopPrecision;
+  g_stopPrecision.GetValue (stopPrecision);
+  m_stopPrecision = stopPrecision.Get ();
+  UintegerValue stopBatches;
+  g_stopBatches.GetValue (stopBatches);
+  m_stopBatches = stopBatches.Get ();
+  m_throughputMeans.Reset (m_stopBatches);
+  m_delayMeans.Reset (m_stopBatches);
+  m_pdrMeans.Reset (m_stopBatches);
+  BooleanValue warmupTrim;
+  g_warmupTrim.GetValue (warmupTrim);
+  m_warmupTrim = warmupTrim.Get ();
+  m_warmupSamples = 0;
+  m_nextConvergenceCheck = 2 * m_stopBatches;
+  if (m_sampleWindow.IsStrictlyPositive ())
+    {
+      // one more for the partial window the run stops in
+      m_throughputSeries.Reserve (m_TotalSimTime / m_sampleWindow.GetSeconds () + 2);
+      Simulator::Schedule (m_sampleWindow, &Experiment::CheckThroughput, this);
+    }
+
+  AnimationInterface *anim = 0;
+  if (!m_animFile.empty ())
+    {
+      anim = new AnimationInterface (m_animFile);
+      anim->SetMaxPktsPerTraceFile (50000000);
+    }
+
+  
+  BooleanValue eventLog;
+  g_eventLog.GetValue (eventLog);
+  if (eventLog.Get ())
+    {
+      // e.g. experiment.log-s2-n100-....bin
+      m_eventLog.Open ("experiment.log-" + GetRunTag () + ".bin", m_routingHelper->GetProtocolName ());
+    }
+
+  TimeValue memoryReport;
+  g_memoryReport.GetValue (memoryReport);
+  if (memoryReport.Get ().IsStrictlyPositive ())
+    {
+      // e.g. experiment.memory-s2-n100-...csv
+      m_memoryReport.Start (GetRunFileName ("experiment.memory.csv"), memoryReport.Get ());
+    }
+
+  // the hard limit; CheckThroughput may stop the run earlier
+  Simulator::Stop (Seconds (m_TotalSimTime));
+  Simulator::Run ();
+  m_eventLog.Close ();
+  m_stopTime = Simulator::Now ().GetSeconds ();
+  if (m_sampleWindow.IsStrictlyPositive ())
+    {
+      // the window the run stopped in; at the hard limit the stop event
+      // runs before the CheckThroughput due at the same time
+      SampleThroughput ();
+    }
+  EstimateSteadyState ();
+
+  
+  
+  std::cout<<"Tx Bytes: "<<m_routingHelper->GetRoutingStats().GetCumulativeTxBytes()<<"\n";
+  std::cout<<"Rx Bytes: "<<m_routingHelper->GetRoutingStats().GetCumulativeRxBytes()<<"\n";
+  std::cout<<"Stopped at: "<<m_stopTime<<" s\n";
+
+  if (m_sampleWindow.IsStrictlyPositive ())
+    {
+      // one time series per run, e.g. experiment.output-s2-n100-...csv
+      m_throughputSeries.WriteCsv (GetRunFileName (m_CSVfileName));
+    }
+  BooleanValue nodeReport;
+  g_nodeReport.GetValue (nodeReport);
+  if (nodeReport.Get ())
+    {
+      WriteNodeReport (GetRunFileName (m_CSVfileName2));
+    }
+  Ptr<ProfilingSimulatorImpl> eventProfile = DynamicCast<ProfilingSimulatorImpl> (Simulator::GetImplementation ());
+  if (eventProfile != 0)
+    {
+      eventProfile->WriteSources (GetRunFileName ("experiment.events.csv"));
+      eventProfile->WriteQueueDepth (GetRunFileName ("experiment.queue.csv"));
+    }
+  m_memoryReport.Stop ();
+  // before the simulator frees the nodes, for the cost history
+  m_rssKb = MemoryReport::GetRssKb ();
+  
+  Simulator::Destroy ();
+  delete anim;
+}
+
+void Experiment::ProcessOutputs(){
+
+
+  
+  double averageRoutingGoodputKbps = 0.0;
+  uint64_t totalBytesTotal = m_routingHelper->GetRoutingStats ().GetCumulativeRxBytes ();
+  uint64_t rxPkts = m_routingHelper->GetRoutingStats ().GetCumulativeRxPkts ();
+  uint64_t txPkts = m_routingHelper->GetRoutingStats ().GetCumulativeTxPkts ();
+  double delaySum = m_routingHelper->GetRoutingStats ().GetCumulativeDelaySum ();
+  double transimissionTime = (m_routingHelper->GetRoutingStats().GetLastRxTime() - m_routingHelper->GetRoutingStats().GetFirstTxTime()).ToDouble(Time::S);
+  averageRoutingGoodputKbps = ((double) totalBytesTotal * 8.0)/transimissionTime/1000;
+  double pdr = ((double)rxPkts * 100)/((double)txPkts);
+  int64_t packetLoss = (int64_t) txPkts - (int64_t) rxPkts;
+
+  double avgDelay = delaySum/(double)rxPkts;
+
+  // the steady state: the sampling windows after the warm-up, or the whole
+  // run if there is none
+  double steadyThroughputKbps = averageRoutingGoodputKbps;
+  double steadyPdr = pdr;
+  double steadyDelay = avgDelay;
+  if (m_sampleWindow.IsStrictlyPositive () && m_warmupTrim && m_warmupSamples > 0)
+    {
+      uint64_t steadyBytes = 0;
+      uint64_t steadyRxPkts = 0;
+      uint64_t steadyTxPkts = 0;
+      double steadyDelaySum = 0;
+      double steadyTime = 0;
+      for (uint32_t i = m_warmupSamples; i < m_throughputSeries.GetN (); i++)
+        {
+          const ThroughputSample &sample = m_throughputSeries.Get (i);
+          steadyBytes += sample.rxBytes;
+          steadyRxPkts += sample.rxPkts;
+          steadyTxPkts += sample.txPkts;
+          steadyDelaySum += sample.delaySum;
+          steadyTime += sample.window;
+        }
+      steadyThroughputKbps = steadyBytes * 8.0 / steadyTime / 1000;
+      steadyPdr = steadyRxPkts * 100.0 / steadyTxPkts;
+      steadyDelay = steadyDelaySum / steadyRxPkts;
+    }
+
+
+
+  std::cout<<"avgThroughput: "<<averageRoutingGoodputKbps<<" kbps\n";
+  std::cout<<"Packet Delivery Ratio: "<<pdr<<"%\n";
+  std::cout<<"Total Packets lost: "<<packetLoss<<"\n";
+  std::cout<<"average Delay: "<<avgDelay<<" seconds\n";
+  std::cout<<"Warm-up: "<<GetWarmupTime()<<" s; after it: "<<steadyThroughputKbps<<" kbps, "
+           <<steadyPdr<<"%, "<<steadyDelay<<" seconds\n";
+  std::cout<<"Delay p50/p95/p99/max: "
+           <<m_routingHelper->GetRoutingStats().GetDelaySketch().GetQuantile(0.50) * 1e-9<<"/"
+           <<m_routingHelper->GetRoutingStats().GetDelaySketch().GetQuantile(0.95) * 1e-9<<"/"
+           <<m_routingHelper->GetRoutingStats().GetDelaySketch().GetQuantile(0.99) * 1e-9<<"/"
+           <<m_routingHelper->GetRoutingStats().GetDelaySketch().GetMax() * 1e-9<<" seconds\n";
+
+  ResultRow row (ResultSchema::ForScenario (m_scenario));
+  row.SetUinteger ("n_nodes", m_nNodes);
+  row.SetDouble ("throughput", averageRoutingGoodputKbps);
+  row.SetDouble ("delay", avgDelay);
+  row.SetUinteger ("packetRx", rxPkts);
+  row.SetInteger ("packetLoss", packetLoss);
+  row.SetDataRate ("rate", m_rate);
+  row.SetInteger ("slotTime", m_slotTime);
+  row.SetInteger ("guardTime", m_guardTime);
+  row.SetUinteger ("packetSize", m_packetSize);
+  row.SetDouble ("pdr", pdr);
+  const QuantileSketch &delays = m_routingHelper->GetRoutingStats ().GetDelaySketch ();
+  row.SetDouble ("delayP50", delays.GetQuantile (0.50) * 1e-9);
+  row.SetDouble ("delayP95", delays.GetQuantile (0.95) * 1e-9);
+  row.SetDouble ("delayP99", delays.GetQuantile (0.99) * 1e-9);
+  row.SetDouble ("delayMax", delays.GetMax () * 1e-9);
+  const QuantileSketch &jitter = m_routingHelper->GetRoutingStats ().GetJitterSketch ();
+  row.SetDouble ("jitterP50", jitter.GetQuantile (0.50) * 1e-9);
+  row.SetDouble ("jitterP95", jitter.GetQuantile (0.95) * 1e-9);
+  row.SetDouble ("jitterP99", jitter.GetQuantile (0.99) * 1e-9);
+  row.SetDouble ("jitterMax", jitter.GetMax () * 1e-9);
+  row.SetUinteger ("seqGaps", m_routingHelper->GetRoutingStats ().GetSeqGaps ());
+  row.SetUinteger ("reordered", m_routingHelper->GetRoutingStats ().GetReordered ());
+  double minDelivery;
+  double maxDelivery;
+  m_routingHelper->GetNodeStats ().GetDeliveryRange (minDelivery, maxDelivery);
+  row.SetDouble ("jainIndex", m_routingHelper->GetNodeStats ().GetJainIndex ());
+  row.SetDouble ("minDelivery", minDelivery);
+  row.SetDouble ("maxDelivery", maxDelivery);
+  row.SetDouble ("warmupTime", GetWarmupTime ());
+  row.SetDouble ("throughputSteady", steadyThroughputKbps);
+  row.SetDouble ("delaySteady", steadyDelay);
+  row.SetDouble ("pdrSteady", steadyPdr);
+  row.SetDouble ("stopTime", m_stopTime);
+  row.SetDouble ("throughputCi", m_throughputMeans.GetHalfWidth ());
+  row.SetDouble ("delayCi", m_delayMeans.GetHalfWidth ());
+  row.SetDouble ("pdrCi", m_pdrMeans.GetHalfWidth ());
+  RoutingStats &routingStats = m_routingHelper->GetRoutingStats ();
+  row.SetUinteger ("protocol", m_protocol);
+  row.SetUinteger ("controlPkts", routingStats.GetControlTxPkts ());
+  row.SetUinteger ("controlBytes", routingStats.GetControlTxBytes ());
+  row.SetDouble ("overheadRatio", routingStats.GetCumulativeRxBytes () > 0
+                 ? (double) routingStats.GetControlTxBytes () / routingStats.GetCumulativeRxBytes () : 0.0);
+  row.SetDouble ("avgHops", routingStats.GetAverageHops ());
+  m_fh->WriteRow (row);
+
+  ResultCache *cache = ResultCache::Get ();
+  if (cache != 0)
+    {
+      if (m_cachedRow != "" && m_cachedRow != row.ToCsv ())
+        {
+          std::cerr << "ResultCache: run " << GetRunTag () << " does not reproduce its cached row\n"
+                    << "  cached: " << m_cachedRow << "\n  now:    " << row.ToCsv () << "\n";
+        }
+      m_cachedRow = "";
+      cache->Store (GetCacheDescription (), row.ToCsv ());
+    }
+}
+
+void Experiment::CourseChange (Experiment *experiment, uint32_t node, Ptr<const MobilityModel> mobility)
+{
+  Vector pos = mobility->GetPosition (); // Get position
+  Vector vel = mobility->GetVelocity (); // Get velocity
+
+  if (experiment->m_eventLog.IsOpen ())
+    {
+      experiment->m_eventLog.Append (EventLog::COURSE_CHANGE, node, 0, pos.x, pos.y, vel.x, vel.y);
+      return;
+    }
+  std::ostream *os = &experiment->m_os;
+
+
+  //NS_LOG_UNCOND ("Changing pos for node=" << node << " at " << Simulator::Now () );
+
+  // Prints position and velocities
+  *os << Simulator::Now () << " POS: x=" << pos.x << ", y=" << pos.y
+       << "; VEL:" << vel.x << ", y=" << vel.y << "\n";
+}
+
+void Experiment::SampleThroughput(){
+  uint32_t n = m_throughputSeries.GetN ();
+  double start = n > 0 ? m_throughputSeries.Get (n - 1).time : 0.0;
+  ThroughputSample sample;
+  sample.time = Simulator::Now ().GetSeconds ();
+  sample.window = sample.time - start;
+  if (sample.window <= 0)
+    {
+      return;
+    }
+  RoutingStats &stats = m_routingHelper->GetRoutingStats ();
+  sample.rxBytes = stats.GetRxBytes ();
+  sample.rxPkts = stats.GetRxPkts ();
+  sample.txBytes = stats.GetTxBytes ();
+  sample.txPkts = stats.GetTxPkts ();
+  sample.delaySum = stats.GetDelaySum ();
+  m_throughputSeries.Add (sample);
+
+  stats.SetRxBytes (0);
+  stats.SetRxPkts (0);
+  stats.SetTxBytes (0);
+  stats.SetTxPkts (0);
+  stats.SetDelaySum (0);
+}
+
+void Experiment::CheckThroughput(){
+  SampleThroughput ();
+  if (m_stopPrecision > 0 && m_throughputSeries.GetN () >= m_nextConvergenceCheck)
+    {
+      // the warm-up moves as the series grows, so the estimates are
+      // redone from scratch; doing so every 10% keeps the cost linear
+      EstimateSteadyState ();
+      if (HasConverged ())
+        {
+          Simulator::Stop ();
+          return;
+        }
+      m_nextConvergenceCheck = std::max (m_nextConvergenceCheck + 1, m_throughputSeries.GetN () * 11 / 10);
+    }
+  Simulator::Schedule (m_sampleWindow, &Experiment::CheckThroughput, this);
+}
+
+bool Experiment::HasConverged(){
+  BatchMeans *metrics[] = { &m_throughputMeans, &m_delayMeans, &m_pdrMeans };
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      // NaN (too few batches, empty batches) never passes
+      if (metrics[i]->GetNBatches () < m_stopBatches
+          || !(metrics[i]->GetRelativeHalfWidth () <= m_stopPrecision))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void Experiment::EstimateSteadyState(){
+  uint32_t n = m_throughputSeries.GetN ();
+  m_warmupSamples = 0;
+  if (m_warmupTrim)
+    {
+      std::vector<double> throughput;
+      std::vector<double> delay;
+      std::vector<uint32_t> delayWindow; // windows without receptions have no delay
+      throughput.reserve (n);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          const ThroughputSample &sample = m_throughputSeries.Get (i);
+          // a rate, as the last window may be partial
+          throughput.push_back (sample.rxBytes / sample.window);
+          if (sample.rxPkts > 0)
+            {
+              delay.push_back (sample.delaySum / sample.rxPkts);
+              delayWindow.push_back (i);
+            }
+        }
+      m_warmupSamples = Mser::Truncate (throughput, 5);
+      uint32_t delayWarmup = Mser::Truncate (delay, 5);
+      if (delayWarmup > 0)
+        {
+          m_warmupSamples = std::max (m_warmupSamples, delayWindow[delayWarmup]);
+        }
+    }
+
+  m_throughputMeans.Reset (m_stopBatches);
+  m_delayMeans.Reset (m_stopBatches);
+  m_pdrMeans.Reset (m_stopBatches);
+  for (uint32_t i = m_warmupSamples; i < n; i++)
+    {
+      const ThroughputSample &sample = m_throughputSeries.Get (i);
+      m_throughputMeans.Add (sample.rxBytes * 8.0 / 1000, sample.window);
+      m_delayMeans.Add (sample.delaySum, sample.rxPkts);
+      m_pdrMeans.Add (sample.rxPkts * 100.0, sample.txPkts);
+    }
+}
+
+double Experiment::GetWarmupTime(){
+  if (m_warmupSamples == 0)
+    {
+      return 0;
+    }
+  return m_throughputSeries.Get (m_warmupSamples - 1).time;
+}
+
+bool Experiment::RestoreOutputs(){
+  ResultCache *cache = ResultCache::Get ();
+  if (cache == 0)
+    {
+      return false;
+    }
+  // the parameters as ProcessOutputs will see them
+  SetupScenario ();
+  std::string cached;
+  if (!cache->Lookup (GetCacheDescription (), cached))
+    {
+      return false;
+    }
+  ResultRow row (GetSchema ());
+  if (!row.FromCsv (cached))
+    {
+      return false;
+    }
+  if (cache->ShouldVerify ())
+    {
+      m_cachedRow = cached;
+      return false;
+    }
+  std::cout << "Cached: " << GetRunTag () << "\n";
+  m_fh->WriteRow (row);
+  return true;
+}
+
+std::string Experiment::GetCacheDescription(){
+  return ResultCache::GetCommonDescription () + GetParameterDescription ();
+}
+
+std::string Experiment::GetParameterDescription(){
+  // m_streamIndex is left out: it only counts the streams assigned so far
+  std::ostringstream oss;
+  oss.precision (std::numeric_limits<double>::max_digits10);
+  oss << "m_scenario=" << m_scenario << "\n"
+      << "m_nNodes=" << m_nNodes << "\n"
+      << "m_nBase=" << m_nBase << "\n"
+      << "m_nSinks=" << m_nSinks << "\n"
+      << "m_port=" << m_port << "\n"
+      << "m_protocol=" << m_protocol << "\n"
+      << "m_routingTables=" << m_routingTables << "\n"
+      << "m_lossModel=" << m_lossModel << "\n"
+      << "m_fading=" << m_fading << "\n"
+      << "m_mobility=" << m_mobility << "\n"
+      << "m_nodeSpeed=" << m_nodeSpeed << "\n"
+      << "m_nodePause=" << m_nodePause << "\n"
+      << "m_yPos=" << m_yPos << "\n"
+      << "m_macMode=" << m_macMode << "\n"
+      << "m_txp=" << m_txp << "\n"
+      << "m_freq=" << m_freq << "\n"
+      << "m_baseAntennaHeight=" << m_baseAntennaHeight << "\n"
+      << "m_baseAntennaGain=" << m_baseAntennaGain << "\n"
+      << "m_nodeAntennaHeight=" << m_nodeAntennaHeight << "\n"
+      << "m_nodeAntennaGain=" << m_nodeAntennaGain << "\n"
+      << "m_slotTime=" << m_slotTime << "\n"
+      << "m_guardTime=" << m_guardTime << "\n"
+      << "m_interFrameTime=" << m_interFrameTime << "\n"
+      << "m_packetSize=" << m_packetSize << "\n"
+      << "m_rate=" << m_rate << "\n"
+      << "m_TotalSimTime=" << m_TotalSimTime << "\n"
+      << "m_traceMobility=" << m_traceMobility << "\n";
+  return oss.str ();
+}
+
+template <typename T>
+static bool
+ParseParameter (std::string value, T &parameter)
+{
+  std::istringstream iss (value);
+  T parsed;
+  if (!(iss >> parsed) || !(iss >> std::ws).eof ())
+    {
+      return false;
+    }
+  parameter = parsed;
+  return true;
+}
+
+bool Experiment::SetParameter(std::string name, std::string value){
+  if (name == "nodes") return ParseParameter (value, m_nNodes);
+  if (name == "sinks") return ParseParameter (value, m_nSinks);
+  if (name == "protocol") return ParseParameter (value, m_protocol);
+  if (name == "lossModel") return ParseParameter (value, m_lossModel);
+  if (name == "fading") return ParseParameter (value, m_fading);
+  if (name == "mobility") return ParseParameter (value, m_mobility);
+  if (name == "rate") return ParseParameter (value, m_rate);
+  if (name == "speed") return ParseParameter (value, m_nodeSpeed);
+  if (name == "pause") return ParseParameter (value, m_nodePause);
+  if (name == "macMode") return ParseParameter (value, m_macMode);
+  if (name == "baseHeight") return ParseParameter (value, m_baseAntennaHeight);
+  if (name == "nodeHeight") return ParseParameter (value, m_nodeAntennaHeight);
+  if (name == "baseGain") return ParseParameter (value, m_baseAntennaGain);
+  if (name == "nodeGain") return ParseParameter (value, m_nodeAntennaGain);
+  if (name == "frequency") return ParseParameter (value, m_freq);
+  if (name == "packetSize") return ParseParameter (value, m_packetSize);
+  if (name == "totaltime") return ParseParameter (value, m_TotalSimTime);
+  if (name == "txp") return ParseParameter (value, m_txp);
+  if (name == "yPos") return ParseParameter (value, m_yPos);
+  if (name == "slotTime") return ParseParameter (value, m_slotTime);
+  if (name == "guardTime") return ParseParameter (value, m_guardTime);
+  if (name == "scenario") return ParseParameter (value, m_scenario);
+  return false;
+}
+
+double Experiment::EstimateCost(){
+  double packetsPerSecond = DataRate (m_rate).GetBitRate () / (8.0 * std::max (m_packetSize, (uint32_t) 1));
+  // one for the per-node background work (TDMA slots, mobility, ...)
+  return m_TotalSimTime * GetRunFeatures ().nodes * (1.0 + packetsPerSecond);
+}
+
+RunFeatures Experiment::GetRunFeatures(){
+  // the parameters as the run will see them, without applying SetupScenario
+  // to them: that would change the run tag of a point not yet run
+  RunFeatures features;
+  features.nodes = (m_scenario == 2 ? 20 : m_nNodes) + m_nBase;
+  features.macMode = (m_scenario == 1 || m_scenario == 2) ? 1 : m_macMode;
+  features.mobility = (m_scenario == 1 || m_scenario == 2) ? 2 : m_mobility;
+  features.rateBps = DataRate (m_rate).GetBitRate ();
+  features.packetSize = m_packetSize;
+  features.slotTime = m_slotTime;
+  // the configured time, which is what a prediction knows about
+  features.simTime = m_TotalSimTime;
+  return features;
+}
+
+std::string Experiment::GetRunTag(){
+  std::ostringstream oss;
+  oss << "s" << m_scenario << "-n" << m_nNodes << "-mac" << m_macMode
+      << "-slot" << m_slotTime << "-guard" << m_guardTime
+      << "-size" << m_packetSize << "-" << m_rate;
+  if (RngSeedManager::GetRun () != 1)
+    {
+      // replications of the same point
+      oss << "-run" << RngSeedManager::GetRun ();
+    }
+  // the parameters the tag leaves out, but not the build, so per-run file
+  // names survive a rebuild
+  std::string description = ResultCache::GetSettingsDescription () + GetParameterDescription ();
+  char hash[16];
+  std::snprintf (hash, sizeof (hash), "-h%08x",
+                 (uint32_t) ResultCache::Hash (description.data (), description.size ()));
+  oss << hash;
+  return oss.str ();
+}
+
+std::string Experiment::GetRunFileName(std::string base){
+  std::string::size_type dot = base.rfind (".csv");
+  return base.substr (0, dot) + "-" + GetRunTag () + ".csv";
+}
+
+void Experiment::WriteNodeReport(std::string filename){
+  const NodeStatsTable &table = m_routingHelper->GetNodeStats ();
+  FileHandle fh (filename);
+  fh.WriteHeader ("node,txPkts,txBytes,rxPkts,rxBytes,pdr,delay");
+  for (uint32_t i = 0; i < table.GetN (); i++)
+    {
+      if (table.GetTxPkts (i) == 0 && table.GetRxPkts (i) == 0)
+        {
+          continue;
+        }
+      std::ostringstream oss;
+      oss << i << "," << table.GetTxPkts (i) << "," << table.GetTxBytes (i) << ","
+          << table.GetRxPkts (i) << "," << table.GetRxBytes (i) << ","
+          << table.GetDeliveryRatio (i) << ","
+          << (table.GetRxPkts (i) > 0 ? table.GetDelaySum (i) * 1e-9 / table.GetRxPkts (i) : 0.0);
+      fh.WriteData (oss.str ());
+    }
+}
+
+void Experiment::ProcessProfile(){
+  BooleanValue profileReport;
+  g_profileReport.GetValue (profileReport);
+  if (profileReport.Get ())
+    {
+      // e.g. experiment.profile-s2-n100-...csv
+      WriteProfile (GetRunFileName ("experiment.profile.csv"));
+    }
+  TimeValue memoryReport;
+  g_memoryReport.GetValue (memoryReport);
+  if (memoryReport.Get ().IsStrictlyPositive ())
+    {
+      // after Simulator::Destroy: what the run left behind
+      MemoryReport::RecordRunEnd (GetRunTag ());
+    }
+  StringValue costHistory;
+  g_costHistory.GetValue (costHistory);
+  if (costHistory.Get ().empty ())
+    {
+      return;
+    }
+  const PhaseProfiler &profiler = GetProfiler ();
+  for (uint32_t i = 0; i < profiler.GetN (); i++)
+    {
+      // the outermost phase covers the whole run
+      const PhaseProfiler::Phase &phase = profiler.Get (i);
+      if (phase.depth == 0)
+        {
+          struct rusage usage;
+          getrusage (RUSAGE_SELF, &usage);
+          CostModel::Append (costHistory.Get (), GetRunFeatures (), phase.wallSeconds,
+                             phase.events, m_rssKb, usage.ru_maxrss);
+          break;
+        }
+    }
+}
+
+void Experiment::SetupLogFile(){
+  m_os.open (m_logFile.c_str ());
+}
+
+void Experiment::SetDefaultAttributeValues(){
+
+
+  
+  Config::SetDefault ("ns3::OnOffApplication::PacketSize",StringValue(std::to_string(m_packetSize)));
+  Config::SetDefault ("ns3::OnOffApplication::DataRate",  StringValue (m_rate));
+  Config::SetDefault ("ns3::SimpleWirelessChannel::MaxRange", DoubleValue (m_txp));
+
+
+}
+
+void Experiment::ConfigureDevices(){
+ //Already done in ConfigureChannels
+}
+
+void Experiment::SetupScenario(){
+  // GetRunFeatures mirrors these overrides
+  if(m_scenario == 1){
+    //Tdma set no of nodes with different transmission rates
+    m_mobility = 2;
+    m_macMode = 1;
+
+  }
+
+  if(m_scenario == 2){
+    m_mobility = 2;
+    m_macMode = 1;
+    m_nNodes = 20;
+  }
+}
+
+
+
+/**
+ * Write-ahead journal of a sweep: one record per finished sweep point,
+ * holding the rows the point added to its sweep file.  A record is
+ * appended with a single write(2) and synced before the next point is
+ * merged, and it ends with a marker, so a record torn by a crash is
+ * recognized (and cut off) when the journal is reopened.  The key of a
+ * record identifies the point's configuration, so a changed sweep does not
+ * reuse stale rows.
+ */
+class SweepJournal
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  SweepJournal ();
+
+  /**
+   * \brief Destructor
+   * \return none
+   */
+  ~SweepJournal ();
+
+  /**
+   * \brief Opens the journal
+   * \param filename the journal file
+   * \param resume keep (and load) the records of an earlier run instead
+   * of starting an empty journal
+   * \return none
+   */
+  void Open (std::string filename, bool resume);
+
+  /**
+   * \brief Returns whether the journal is open
+   * \return true if records are kept
+   */
+  bool IsOpen () const;
+
+  /**
+   * \brief Looks up the record of a point
+   * \param index the point index
+   * \param key the key of the point's configuration
+   * \param rows set to the rows of the point
+   * \return true if the point has a record with that key
+   */
+  bool Lookup (uint32_t index, uint64_t key, std::string &rows) const;
+
+  /**
+   * \brief Durably records a finished point
+   * \param index the point index
+   * \param key the key of the point's configuration
+   * \param rows the rows the point added to its sweep file
+   * \return none
+   */
+  void Record (uint32_t index, uint64_t key, std::string rows);
+
+private:
+  struct Entry
+  {
+    uint64_t key;
+    std::string rows;
+  };
+
+  std::string m_filename;
+  std::map<uint32_t, Entry> m_entries;
+  int m_fd;
+};
+
+SweepJournal::SweepJournal ()
+  : m_fd (-1)
 {
-  m_nNodes = nodes;
-  m_routingHelper = CreateObject<RoutingHelper> ();
-  m_log = 1;
-  m_fh = fh;
-  m_rate = rate;
-  m_scenario = 1;
 }
 
+SweepJournal::~SweepJournal ()
+{
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+    }
+}
 
-Experiment::Experiment(FileHandle* fh,int slot,int guard)
-:m_port (9),
-    m_CSVfileName ("experiment.output.csv"),
-    m_CSVfileName2 ("experiment.output2.csv"),
-    m_nSinks (5),
-    m_protocolName ("protocol"),
-    m_traceMobility (false),
-    // Differnt Routing Protocls
-    m_protocol (2),
-    // Different Loss models
-    m_lossModel (4),
-    m_fading (0),
-    m_lossModelName (""),
-    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
-    m_mobility (2),
-    m_nNodes (10),
-    m_nBase(1),
-    m_TotalSimTime (300),
-    //OnoffApplication frequency
-    m_rate ("2048bps"),
-    m_trName ("experiment-compare"),
-    m_nodeSpeed (50),
-    m_nodePause (0),
-    m_verbose (0),
-    m_macMode (1),
-    m_routingTables (0),
-    m_asciiTrace (0),
-    m_pcap (0),
-    m_log (1),
-    m_streamIndex (0),
-    m_TxNodes (),
-    m_exp (""),
-    m_cumulativeCaptureStart (0),
-    m_freq(5.8e9),
-    m_baseAntennaHeight(50),
-    m_nodeAntennaHeight(9),
-    m_baseAntennaGain(18.6),
-    m_nodeAntennaGain(14.6),
-    m_allNodes(),
-    m_txp(40000),
-    m_guardTime(100),
-    m_interFrameTime(0),
-    m_slotTime(1100),
-    m_packetSize(64),
-    m_yPos(30000),
-    m_scenario(0)  
+void
+SweepJournal::Open (std::string filename, bool resume)
 {
-  
-  m_routingHelper = CreateObject<RoutingHelper> ();
-  m_log = 1;
-  m_fh = fh;
-  m_scenario = 2;
-  m_slotTime = slot;
-  m_guardTime = guard;
+  m_filename = filename;
+  m_entries.clear ();
+  off_t good = 0;
+  if (resume)
+    {
+      std::ifstream in (filename.c_str (), std::ios::binary);
+      std::string data ((std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+      // "point <index> <key> <size>\n<size bytes>end\n", repeated
+      while (good < (off_t) data.size ())
+        {
+          std::string::size_type eol = data.find ('\n', good);
+          if (eol == std::string::npos)
+            {
+              break;
+            }
+          std::istringstream header (data.substr (good, eol - good));
+          std::string tag;
+          uint32_t index;
+          Entry entry;
+          size_t size;
+          if (!(header >> tag >> index >> std::hex >> entry.key >> std::dec >> size) || tag != "point"
+              || eol + 1 + size + 4 > data.size () || data.compare (eol + 1 + size, 4, "end\n") != 0)
+            {
+              break;
+            }
+          entry.rows = data.substr (eol + 1, size);
+          // a point merged again (e.g. in a partly resumed unit) supersedes its old record
+          m_entries[index] = entry;
+          good = eol + 1 + size + 4;
+        }
+      if (good < (off_t) data.size ())
+        {
+          std::cerr << "SweepJournal: dropping " << data.size () - good
+                    << " bytes of an incomplete record at the end of " << filename << "\n";
+        }
+    }
+  m_fd = open (filename.c_str (), O_WRONLY | O_CREAT | O_APPEND | (resume ? 0 : O_TRUNC), 0644);
+  if (m_fd < 0 || (resume && ftruncate (m_fd, good) != 0))
+    {
+      NS_FATAL_ERROR ("SweepJournal: cannot open " << filename << ": " << std::strerror (errno));
+    }
+}
+
+bool
+SweepJournal::IsOpen () const
+{
+  return m_fd >= 0;
+}
+
+bool
+SweepJournal::Lookup (uint32_t index, uint64_t key, std::string &rows) const
+{
+  std::map<uint32_t, Entry>::const_iterator it = m_entries.find (index);
+  if (it == m_entries.end () || it->second.key != key)
+    {
+      return false;
+    }
+  rows = it->second.rows;
+  return true;
+}
+
+void
+SweepJournal::Record (uint32_t index, uint64_t key, std::string rows)
+{
+  if (m_fd < 0)
+    {
+      return;
+    }
+  std::ostringstream record;
+  record << "point " << index << " " << std::hex << key << std::dec << " " << rows.size () << "\n"
+         << rows << "end\n";
+  std::string data = record.str ();
+  // one write on an O_APPEND descriptor: the record is either all there or
+  // a torn tail that Open cuts off
+  if (write (m_fd, data.data (), data.size ()) != (ssize_t) data.size () || fdatasync (m_fd) != 0)
+    {
+      NS_LOG_ERROR ("SweepJournal: cannot record point " << index << " in " << m_filename);
+    }
+}
+
+/**
+ * Runs the points of the parameter sweeps in main().  With a single worker
+ * the points run one after another in this process; otherwise a pool of
+ * forked worker processes (the Simulator is a per-process singleton, so
+ * threads are not an option) pulls point indices from a shared counter, so
+ * a slow large-N point never holds up the points queued behind it.
+ *
+ * Every point writes its output row to a private part file.  The parent
+ * appends the part files to the sweep CSVs strictly in the order the points
+ * were added, so the merged files do not depend on scheduling.
+ *
+ * Consecutive points added with the same non-zero group only differ in
+ * their application parameters (packet size, rate).  With fork-after-setup
+ * enabled such a group is split into up to one unit of work per worker:
+ * each unit builds its topology once (WifiApp::SetUp) and forks a child
+ * process per point, one after the other, which applies the point's
+ * application parameters to the copy-on-write image and runs the
+ * simulation (WifiApp::Finish).  So a group takes one setup per worker it
+ * is spread over, and its points still run in parallel.
+ *
+ * With K > 1 replications every unit of work runs K times, each time in a
+ * child process forked from the pristine experiments with its own RngRun
+ * (the --RngRun value plus 0..K-1).  The replications of a unit are queued
+ * next to each other, so a pool of workers runs them in parallel.  The row
+ * merged into the sweep file then summarizes the K rows of the point (see
+ * ResultSchema::WithReplications).
+ *
+ * A pool of workers takes the units of work longest first (by the wall
+ * time a CostModel predicts, or Experiment::EstimateCost without one), so
+ * a large-N point is not left to run alone at the end; rows are still
+ * merged in the order the points were added.  PrintPlan shows that
+ * schedule and its predicted cost without running anything.
+ *
+ * With a journal, every merged point is recorded in it.  A resumed sweep
+ * takes the rows of the recorded points from the journal and only runs the
+ * units of work with points missing, so the rebuilt sweep files match
+ * those of an uninterrupted sweep.
+ */
+class SweepRunner
+{
+public:
+  /**
+   * \brief Constructor
+   * \param workers number of worker processes (<= 1 runs in-process)
+   * \param forkVariants build the topology of a group of points once per
+   * worker it is spread over and fork a process per point after setup
+   * \param replications number of independent replications of each point
+   * \return none
+   */
+  SweepRunner (uint32_t workers, bool forkVariants = false, uint32_t replications = 1);
+
+  /**
+   * \brief Destructor
+   * \return none
+   */
+  ~SweepRunner ();
+
+  /**
+   * \brief Queues a sweep point.  The runner takes ownership of the
+   * experiment and deletes it once it has run.
+   * \param experiment the configured experiment
+   * \param group non-zero if the point only differs from the preceding
+   * points of the same group in its application parameters
+   * \return none
+   */
+  void AddPoint (Experiment *experiment, uint32_t group = 0);
+
+  /**
+   * \brief Sets the model predicting the cost of the points added after
+   * this call
+   * \param model the model, which must outlive the runner; used only if
+   * fitted
+   * \return none
+   */
+  void SetCostModel (const CostModel *model);
+
+  /**
+   * \brief Prints the predicted wall time and memory of every point and
+   * of the whole sweep, scheduled as Run would schedule it
+   * \param os the stream to print to
+   * \return none
+   */
+  void PrintPlan (std::ostream &os);
+
+  /**
+   * \brief Records every finished point in a journal
+   * \param filename the journal file
+   * \param resume reuse the points recorded by an interrupted sweep
+   * \return none
+   */
+  void EnableJournal (std::string filename, bool resume);
+
+  /**
+   * \brief Runs all queued points and merges their rows into the sweep files
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return the number of points that failed to produce a row
+   */
+  uint32_t Run (int argc, char **argv);
+
+private:
+  /**
+   * \brief Runs one point, writing its row to the point's part file
+   * \param index the point index
+   * \param worker the worker running the point
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return none
+   */
+  void RunPoint (uint32_t index, uint32_t worker, int argc, char **argv);
+
+  /**
+   * \brief Runs a unit of work: a single point, or a group of points
+   * sharing one topology
+   * \param unit the unit index
+   * \param worker the worker running the unit
+   * \param doneFd pipe to report finished point indices on (-1 for none)
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return false if a finished point could not be reported
+   */
+  bool RunUnit (uint32_t unit, uint32_t worker, int doneFd, int argc, char **argv);
+
+  /**
+   * \brief Runs one replication of a unit of work, in a forked process if
+   * there is more than one replication
+   * \param task the unit index times the number of replications plus the
+   * replication index
+   * \param worker the worker running the task
+   * \param doneFd pipe to report finished point indices on (-1 for none)
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return false if a finished point could not be reported
+   */
+  bool RunTask (uint32_t task, uint32_t worker, int doneFd, int argc, char **argv);
+
+  /**
+   * \brief Summarizes the replications of a point: mean, standard
+   * deviation and 95% confidence interval of every measured column
+   * \param rows the rows of the replications
+   * \return the summary row
+   */
+  static ResultRow Summarize (const std::vector<ResultRow> &rows);
+
+  /**
+   * \brief Sets up the first point of a group once, then forks a process
+   * per point of the group that applies the point's application parameters
+   * and finishes the simulation
+   * \param first the index of the first point of the group
+   * \param n the number of points in the group
+   * \param worker the worker running the group
+   * \param doneFd pipe to report finished point indices on (-1 for none)
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return false if a finished point could not be reported
+   */
+  bool RunGroup (uint32_t first, uint32_t n, uint32_t worker, int doneFd, int argc, char **argv);
+
+  /**
+   * \brief Splits the points into units of work
+   * \return none
+   */
+  void BuildUnits ();
+
+  /**
+   * \brief Queues the tasks of the units of work not taken from the
+   * journal, longest first
+   * \param resumed filled with whether each unit was taken from the journal
+   * \return none
+   */
+  void QueueTasks (std::vector<bool> &resumed);
+
+  /**
+   * \brief Worker process main loop; never returns
+   * \param worker the worker index
+   * \param next shared counter holding the next task to run
+   * \param doneFd pipe to report finished point indices on
+   * \param argc program arguments count
+   * \param argv program arguments
+   * \return none
+   */
+  void RunWorker (uint32_t worker, uint32_t *next, int doneFd, int argc, char **argv);
+
+  /**
+   * \brief Appends the part file of a point to its sweep file (or the rows
+   * recorded in the journal) and records the point in the journal
+   * \param index the point index
+   * \return true if the point produced a row
+   */
+  bool MergePoint (uint32_t index);
+
+  /**
+   * \brief Returns the part file name used by a point
+   * \param index the point index
+   * \param replication the replication index
+   * \return the part file name
+   */
+  std::string GetPartFileName (uint32_t index, uint32_t replication);
+
+  uint32_t m_workers;
+  bool m_forkVariants;
+  uint32_t m_replications;
+  uint32_t m_replication; // the replication run by this process
+  uint32_t m_baseRun; // RngRun of replication 0
+  std::vector<Experiment *> m_points;
+  std::vector<FileHandle *> m_outputs; // sweep file of each point
+  std::vector<ResultSchema> m_schemas; // layout of the rows of each point
+  std::vector<uint32_t> m_groups; // group of each point, 0 for none
+  std::vector<uint32_t> m_unitStart; // first point of each unit of work
+  std::vector<uint32_t> m_tasks; // tasks left to run
+  std::vector<double> m_costs; // estimated cost of each point
+  std::vector<double> m_predictedRssKb; // 0 without a fitted cost model
+  const CostModel *m_costModel;
+  SweepJournal m_journal;
+  std::vector<uint64_t> m_keys; // journal key of each point
+};
+
+SweepRunner::SweepRunner (uint32_t workers, bool forkVariants, uint32_t replications)
+  : m_workers (workers),
+    m_forkVariants (forkVariants),
+    m_replications (std::max (replications, (uint32_t) 1)),
+    m_replication (0),
+    m_baseRun (1),
+    m_costModel (0)
+{
+}
+
+SweepRunner::~SweepRunner ()
+{
+  for (uint32_t i = 0; i < m_points.size (); i++)
+    {
+      delete m_points[i];
+    }
 }
 
-
-Experiment::Experiment(FileHandle* fh,uint32_t packet,int slot)
-:m_port (9),
-    m_CSVfileName ("experiment.output.csv"),
-    m_CSVfileName2 ("experiment.output2.csv"),
-    m_nSinks (5),
-    m_protocolName ("protocol"),
-    m_traceMobility (false),
-    // Differnt Routing Protocls
-    m_protocol (2),
-    // Different Loss models
-    m_lossModel (4),
-    m_fading (0),
-    m_lossModelName (""),
-    m_logFile ("low_ct-unterstrass-1day.filt.5.adj.log"),
-    m_mobility (2),
-    m_nNodes (10),
-    m_nBase(1),
-    m_TotalSimTime (300),
-    //OnoffApplication frequency
-    m_rate ("2048bps"),
-    m_trName ("experiment-compare"),
-    m_nodeSpeed (50),
-    m_nodePause (0),
-    m_verbose (0),
-    m_macMode (1),
-    m_routingTables (0),
-    m_asciiTrace (0),
-    m_pcap (0),
-    m_log (1),
-    m_streamIndex (0),
-    m_TxNodes (),
-    m_exp (""),
-    m_cumulativeCaptureStart (0),
-    m_freq(5.8e9),
-    m_baseAntennaHeight(50),
-    m_nodeAntennaHeight(9),
-    m_baseAntennaGain(18.6),
-    m_nodeAntennaGain(14.6),
-    m_allNodes(),
-    m_txp(40000),
-    m_guardTime(100),
-    m_interFrameTime(0),
-    m_slotTime(1100),
-    m_packetSize(64),
-    m_yPos(30000),
-    m_scenario(0)  
+void
+SweepRunner::AddPoint (Experiment *experiment, uint32_t group)
 {
-  m_routingHelper = CreateObject<RoutingHelper> ();
-  m_log = 1;
-  m_fh = fh;
-  m_packetSize = packet;  
-  m_slotTime = slot;
-  m_scenario = 3;
+  m_points.push_back (experiment);
+  m_outputs.push_back (experiment->GetFileHandle ());
+  m_schemas.push_back (experiment->GetSchema ());
+  m_groups.push_back (group);
+  if (m_costModel != 0 && m_costModel->IsFitted ())
+    {
+      RunFeatures features = experiment->GetRunFeatures ();
+      m_costs.push_back (m_costModel->PredictWallSeconds (features));
+      m_predictedRssKb.push_back (m_costModel->PredictRssKb (features));
+    }
+  else
+    {
+      m_costs.push_back (experiment->EstimateCost ());
+      m_predictedRssKb.push_back (0);
+    }
+  // the full parameter description: run tags leave parameters out
+  std::ostringstream key;
+  key << experiment->GetFileHandle ()->m_filename << "\n"
+      << experiment->GetCacheDescription () << m_replications;
+  m_keys.push_back (ResultCache::Hash (key.str ().data (), key.str ().size ()));
 }
 
-
-Experiment::~Experiment ()
+void
+SweepRunner::SetCostModel (const CostModel *model)
 {
+  m_costModel = model;
 }
-void Experiment::ParseCommandLineArguments(int argc, char** argv){
 
-  CommandLine cmd;
+void
+SweepRunner::PrintPlan (std::ostream &os)
+{
+  BuildUnits ();
+  std::vector<bool> resumed;
+  QueueTasks (resumed);
+  bool predicted = m_costModel != 0 && m_costModel->IsFitted ();
+  if (!predicted)
+    {
+      os << "SweepRunner: no cost history to predict from (at least 7 runs are needed); "
+         << "costs are relative estimates\n";
+    }
 
-  cmd.AddValue ("totaltime", "Simulation end time", m_TotalSimTime);
-  cmd.AddValue ("nodes", "Number of nodes (i.e. vehicles)", m_nNodes);
-  cmd.AddValue ("sinks", "Number of routing sinks", m_nSinks);
-  cmd.AddValue ("traceMobility", "Enable mobility tracing", m_traceMobility);
-  cmd.AddValue ("protocol", "1=OLSR;2=AODV;3=DSDV;4=DSR", m_protocol);
-  cmd.AddValue ("lossModel", "1=Friis;2=ItuR1411Los;3=TwoRayGround;4=LogDistance", m_lossModel);
-  cmd.AddValue ("fading", "0=None;1=Nakagami;(buildings=1 overrides)", m_fading);
-  cmd.AddValue ("logFile", "Log file", m_logFile);
-  cmd.AddValue ("mobility", "1=RandomWalk2d;2=RandomWayPoint", m_mobility);
-  cmd.AddValue ("rate in bps", "Rate", m_rate);
-  cmd.AddValue ("speed", "Node speed (m/s)", m_nodeSpeed);
-  cmd.AddValue ("pause", "Node pause (s)", m_nodePause);
-  cmd.AddValue ("verbose", "0=quiet;1=verbose", m_verbose);
-  cmd.AddValue ("macMode", "0=CSMA, 1=TDMA", m_macMode);
-  cmd.AddValue("baseHeight","Antenna Height for base station in meters",m_baseAntennaHeight);
-  cmd.AddValue("nodeHeight","Antenna Height for Node in meters",m_nodeAntennaHeight);
-  cmd.AddValue("baseGain","Antenna Gain for base station",m_baseAntennaGain);
-  cmd.AddValue("nodeGain","Antenna Gain for ABE",m_nodeAntennaGain);
-  cmd.AddValue("frequency","Operating frequency in hz",m_freq);
-  cmd.AddValue("packetSize","Packet Size in bytes",m_packetSize);
-  SetupScenario();
+  os << "point,file,tag,wallSeconds,rssMb,journaled\n";
+  double cpuSeconds = 0;
+  double maxRssKb = 0;
+  for (uint32_t u = 0; u + 1 < m_unitStart.size (); u++)
+    {
+      for (uint32_t i = m_unitStart[u]; i < m_unitStart[u + 1]; i++)
+        {
+          os << i << "," << m_outputs[i]->m_filename << "," << m_points[i]->GetRunTag () << ","
+             << m_costs[i] << "," << m_predictedRssKb[i] / 1024 << "," << resumed[u] << "\n";
+          if (!resumed[u])
+            {
+              cpuSeconds += m_costs[i] * m_replications;
+              maxRssKb = std::max (maxRssKb, m_predictedRssKb[i]);
+            }
+        }
+    }
 
+  // greedy longest-first assignment, as the worker pool takes the tasks
+  uint32_t nWorkers = std::max (std::min (m_workers, (uint32_t) m_tasks.size ()), (uint32_t) 1);
+  std::vector<double> load (nWorkers, 0.0);
+  for (uint32_t t = 0; t < m_tasks.size (); t++)
+    {
+      uint32_t unit = m_tasks[t] / m_replications;
+      double cost = 0;
+      for (uint32_t i = m_unitStart[unit]; i < m_unitStart[unit + 1]; i++)
+        {
+          cost += m_costs[i];
+        }
+      *std::min_element (load.begin (), load.end ()) += cost;
+    }
+  os << "SweepRunner: " << m_tasks.size () << " tasks on " << nWorkers << " workers, "
+     << (predicted ? "predicted " : "relative ") << "total " << cpuSeconds << ", makespan "
+     << *std::max_element (load.begin (), load.end ());
+  if (predicted)
+    {
+      os << " s (typically within a factor " << m_costModel->GetWallErrorFactor () << ", fitted on "
+         << m_costModel->GetNRuns () << " runs), peak RSS " << maxRssKb / 1024 << " MB per worker, "
+         << nWorkers * maxRssKb / 1024 << " MB at most in total";
+    }
+  os << "\n";
 }
 
-void Experiment::ConfigureNodes(){
-  m_TxNodes.Create(m_nNodes);
-  m_baseNodes.Create(m_nBase);
-  for(uint32_t i=0;i<m_nBase;i++){
-    m_allNodes.Add(m_baseNodes.Get(i));
-  }
-  for(uint32_t i=0;i<m_nNodes;i++){
-    m_allNodes.Add(m_TxNodes.Get(i));
-  }
+void
+SweepRunner::EnableJournal (std::string filename, bool resume)
+{
+  m_journal.Open (filename, resume);
 }
 
-void Experiment::ConfigureChannels(){
+void
+SweepRunner::BuildUnits ()
+{
+  m_unitStart.clear ();
+  uint32_t i = 0;
+  while (i < m_points.size ())
+    {
+      uint32_t end = i + 1;
+      while (m_forkVariants && end < m_points.size () && m_groups[end] != 0
+             && m_groups[end] == m_groups[i])
+        {
+          end++;
+        }
+      // a group in as many units as there are workers, so its points are
+      // not run one after the other by one worker
+      uint32_t nUnits = std::min (std::max (m_workers, (uint32_t) 1), end - i);
+      for (uint32_t u = 0; u < nUnits; u++)
+        {
+          m_unitStart.push_back (i + (uint64_t) (end - i) * u / nUnits);
+        }
+      i = end;
+    }
+  m_unitStart.push_back (m_points.size ());
+}
 
- 
+std::string
+SweepRunner::GetPartFileName (uint32_t index, uint32_t replication)
+{
+  std::ostringstream oss;
+  oss << m_outputs[index]->m_filename << ".part" << index;
+  if (m_replications > 1)
+    {
+      oss << ".r" << replication;
+    }
+  return oss.str ();
+}
 
-  //Configuring the mac_layer
-  if(m_macMode == 0){
+void
+SweepRunner::RunPoint (uint32_t index, uint32_t worker, int argc, char **argv)
+{
+  Experiment *experiment = m_points[index];
+  std::string partName = GetPartFileName (index, m_replication);
+  std::remove (partName.c_str ());
+  FileHandle part (partName);
+  experiment->SetFileHandle (&part);
+  if (m_workers > 1)
+    {
+      // workers would otherwise all write the same animation file
+      std::ostringstream anim;
+      anim << "experiment-w" << worker << ".xml";
+      experiment->SetAnimFile (anim.str ());
+    }
+  experiment->Simulate (argc, argv);
 
-     if (m_lossModel == 1)
+  // release the topology before the next point, as the old loops did
+  delete experiment;
+  m_points[index] = 0;
+}
+
+bool
+SweepRunner::RunUnit (uint32_t unit, uint32_t worker, int doneFd, int argc, char **argv)
+{
+  uint32_t first = m_unitStart[unit];
+  uint32_t n = m_unitStart[unit + 1] - first;
+  if (n > 1)
     {
-      m_lossModelName = "ns3::FriisPropagationLossModel";
+      return RunGroup (first, n, worker, doneFd, argc, argv);
     }
-    else if (m_lossModel == 2)
-      {
-        m_lossModelName = "ns3::ItuR1411LosPropagationLossModel";
-      }
-    else if (m_lossModel == 3)
-      {
-        m_lossModelName = "ns3::TwoRayGroundPropagationLossModel";
-      }
-    else if (m_lossModel == 4)
-      {
-        m_lossModelName = "ns3::LogDistancePropagationLossModel";
-      }
-    else
-      {
-        // Unsupported propagation loss model.
-        // Treating as ERROR
-        NS_LOG_ERROR ("Invalid propagation loss model specified.  Values must be [1-4], where 1=Friis;2=ItuR1411Los;3=TwoRayGround;4=LogDistance");
-      }
-    
-  //BaseStationChannel
-    YansWifiChannelHelper WifiChannel;
-    WifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
+  RunPoint (first, worker, argc, argv);
+  std::cout.flush ();
+  // a 4-byte write to a pipe is atomic, so reports never interleave
+  return doneFd < 0 || write (doneFd, &first, sizeof (first)) == sizeof (first);
+}
 
-    if (m_lossModel == 3)
-      {
-        // two-ray requires antenna height (else defaults to Friss)
-        WifiChannel.AddPropagationLoss (m_lossModelName, "Frequency", DoubleValue (m_freq), "HeightAboveZ", DoubleValue (m_baseAntennaHeight));
-      }
-    else
-      {
-        WifiChannel.AddPropagationLoss (m_lossModelName, "Frequency", DoubleValue (m_freq));
-      }
+bool
+SweepRunner::RunGroup (uint32_t first, uint32_t n, uint32_t worker, int doneFd, int argc, char **argv)
+{
+  Experiment *experiment = m_points[first];
+  if (m_workers > 1)
+    {
+      std::ostringstream anim;
+      anim << "experiment-w" << worker << ".xml";
+      experiment->SetAnimFile (anim.str ());
+    }
 
+  // points with a cached row need no process; none, no setup
+  std::vector<bool> cached (n, false);
+  uint32_t nCached = 0;
+  for (uint32_t index = first; index < first + n; index++)
+    {
+      std::string partName = GetPartFileName (index, m_replication);
+      std::remove (partName.c_str ());
+      FileHandle part (partName);
+      FileHandle *output = m_points[index]->GetFileHandle ();
+      m_points[index]->SetFileHandle (&part);
+      cached[index - first] = m_points[index]->RestoreOutputs ();
+      m_points[index]->SetFileHandle (output);
+      nCached += cached[index - first];
+    }
+  if (nCached < n)
+    {
+      experiment->SetUp (argc, argv);
+    }
 
-    Ptr<YansWifiChannel> Channel = WifiChannel.Create ();
-    
+  bool reported = true;
+  for (uint32_t index = first; index < first + n && reported; index++)
+    {
+      if (cached[index - first])
+        {
+          reported = doneFd < 0 || write (doneFd, &index, sizeof (index)) == sizeof (index);
+          continue;
+        }
+      std::string partName = GetPartFileName (index, m_replication);
+      std::cout.flush ();
+      std::cerr.flush ();
+      FileHandle::FlushAll ();
 
-    YansWifiPhyHelper basePhy = YansWifiPhyHelper::Default();
-    basePhy.SetChannel(Channel);
-    
-    YansWifiPhyHelper nodePhy = YansWifiPhyHelper::Default();
-    nodePhy.SetChannel(Channel);
+      pid_t pid = fork ();
+      if (pid == 0)
+        {
+          {
+            FileHandle part (partName);
+            // taken first: SetApplicationVariant clears it when the point is
+            // the one that was set up
+            std::string cachedRow = m_points[index]->GetCachedRow ();
+            experiment->SetFileHandle (&part);
+            experiment->SetApplicationVariant (m_points[index]->GetPacketSize (),
+                                               m_points[index]->GetRate ());
+            experiment->SetCachedRow (cachedRow);
+            experiment->Finish ();
+          }
+          std::cout.flush ();
+          _exit (0);
+        }
+      else if (pid < 0)
+        {
+          // the point is lost; MergePoint reports it
+          NS_LOG_ERROR ("SweepRunner: fork failed: " << std::strerror (errno));
+        }
+      else
+        {
+          int status = 0;
+          waitpid (pid, &status, 0);
+          if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+            {
+              std::cerr << "SweepRunner: variant process of point " << index
+                        << " (pid " << pid << ") terminated abnormally\n";
+            }
+        }
+      reported = doneFd < 0 || write (doneFd, &index, sizeof (index)) == sizeof (index);
+    }
 
-    basePhy.SetPcapDataLinkType (YansWifiPhyHelper::DLT_IEEE802_11); //Tracing Stuff
-    nodePhy.SetPcapDataLinkType (YansWifiPhyHelper::DLT_IEEE802_11);
+  // the set-up topology was never run here; release it before the next unit
+  PhaseProfiler::SetActive (0);
+  if (nCached < n)
+    {
+      Simulator::Destroy ();
+    }
+  for (uint32_t index = first; index < first + n; index++)
+    {
+      delete m_points[index];
+      m_points[index] = 0;
+    }
+  return reported;
+}
 
-    WifiHelper wifi;
-    if(m_verbose){
-      wifi.EnableLogComponents();
+bool
+SweepRunner::RunTask (uint32_t task, uint32_t worker, int doneFd, int argc, char **argv)
+{
+  uint32_t unit = task / m_replications;
+  if (m_replications <= 1)
+    {
+      return RunUnit (unit, worker, doneFd, argc, argv);
     }
 
+  m_replication = task % m_replications;
+  std::cout.flush ();
+  std::cerr.flush ();
+  FileHandle::FlushAll ();
+  pid_t pid = fork ();
+  if (pid == 0)
+    {
+      // the experiments of this process have not run yet, so the child
+      // gets a fresh copy of them
+      RngSeedManager::SetRun (m_baseRun + m_replication);
+      RunUnit (unit, worker, -1, argc, argv);
+      std::cout.flush ();
+      _exit (0);
+    }
+  else if (pid < 0)
+    {
+      // the replication is lost; MergePoint summarizes the others
+      NS_LOG_ERROR ("SweepRunner: fork failed: " << std::strerror (errno));
+    }
+  else
+    {
+      int status = 0;
+      waitpid (pid, &status, 0);
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        {
+          std::cerr << "SweepRunner: replication " << m_replication << " of unit " << unit
+                    << " (pid " << pid << ") terminated abnormally\n";
+        }
+    }
 
-    basePhy.Set("TxGain",DoubleValue(m_baseAntennaGain));
-    nodePhy.Set("TxGain",DoubleValue(m_nodeAntennaGain));
+  bool reported = true;
+  for (uint32_t index = m_unitStart[unit]; index < m_unitStart[unit + 1] && reported; index++)
+    {
+      reported = doneFd < 0 || write (doneFd, &index, sizeof (index)) == sizeof (index);
+    }
+  return reported;
+}
 
-    wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager");
+ResultRow
+SweepRunner::Summarize (const std::vector<ResultRow> &rows)
+{
+  const ResultSchema &schema = rows[0].GetSchema ();
+  ResultRow summary (ResultSchema::WithReplications (schema));
+  uint32_t n = rows.size ();
+  for (uint32_t i = 0; i < schema.GetN (); i++)
+    {
+      std::string name = schema.GetColumnName (i);
+      if (ResultSchema::IsParameter (name))
+        {
+          // the same in every replication
+          ResultRow::Value value = rows[0].Get (i);
+          std::ostringstream rate;
+          switch (schema.GetColumnType (i))
+            {
+            case ResultSchema::UINTEGER:
+              summary.SetUinteger (name, value.u);
+              break;
+            case ResultSchema::INTEGER:
+              summary.SetInteger (name, value.i);
+              break;
+            case ResultSchema::DOUBLE:
+              summary.SetDouble (name, value.d);
+              break;
+            case ResultSchema::DATARATE:
+              rate << value.u << "bps";
+              summary.SetDataRate (name, rate.str ());
+              break;
+            }
+          continue;
+        }
+      double sum = 0;
+      std::vector<double> values (n);
+      for (uint32_t j = 0; j < n; j++)
+        {
+          ResultRow::Value value = rows[j].Get (i);
+          switch (schema.GetColumnType (i))
+            {
+            case ResultSchema::UINTEGER:
+            case ResultSchema::DATARATE:
+              values[j] = value.u;
+              break;
+            case ResultSchema::INTEGER:
+              values[j] = value.i;
+              break;
+            case ResultSchema::DOUBLE:
+              values[j] = value.d;
+              break;
+            }
+          sum += values[j];
+        }
+      double mean = sum / n;
+      double sumSquares = 0;
+      for (uint32_t j = 0; j < n; j++)
+        {
+          sumSquares += (values[j] - mean) * (values[j] - mean);
+        }
+      // NaN with a single replication
+      double sd = n > 1 ? std::sqrt (sumSquares / (n - 1)) : std::numeric_limits<double>::quiet_NaN ();
+      if (schema.GetColumnType (i) == ResultSchema::DATARATE)
+        {
+          std::ostringstream rate;
+          rate << (uint64_t) (mean + 0.5) << "bps";
+          summary.SetDataRate (name, rate.str ());
+        }
+      else
+        {
+          summary.SetDouble (name, mean);
+        }
+      summary.SetDouble (name + "_sd", sd);
+      summary.SetDouble (name + "_ci95", BatchMeans::GetStudentT (n - 1) * sd / std::sqrt ((double) n));
+    }
+  summary.SetUinteger ("replications", n);
+  return summary;
+}
 
-    NqosWifiMacHelper wifiMac = NqosWifiMacHelper::Default ();
-    Ssid ssid = Ssid("base-station");
-    wifiMac.SetType ("ns3::StaWifiMac",
-                "Ssid", SsidValue (ssid),
-                "ActiveProbing", BooleanValue (false));
+bool
+SweepRunner::MergePoint (uint32_t index)
+{
+  std::string recorded;
+  if (m_journal.Lookup (index, m_keys[index], recorded))
+    {
+      // AppendFile also fills the columnar file, so go through a part file
+      std::string part = GetPartFileName (index, 0) + ".journal";
+      std::ofstream out (part.c_str ());
+      out << recorded;
+      out.close ();
+      bool ok = m_outputs[index]->AppendFile (part);
+      std::remove (part.c_str ());
+      // rows of a partly resumed unit that ran again are superseded
+      for (uint32_t r = 0; r < m_replications; r++)
+        {
+          std::remove (GetPartFileName (index, r).c_str ());
+        }
+      return ok;
+    }
+
+  if (m_replications <= 1)
+    {
+      std::string part = GetPartFileName (index, 0);
+      std::ifstream in (part.c_str ());
+      recorded.assign ((std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+      in.close ();
+      bool ok = m_outputs[index]->AppendFile (part);
+      std::remove (part.c_str ());
+      if (ok)
+        {
+          m_journal.Record (index, m_keys[index], recorded);
+        }
+      return ok;
+    }
+
+  std::vector<ResultRow> rows;
+  for (uint32_t r = 0; r < m_replications; r++)
+    {
+      std::string part = GetPartFileName (index, r);
+      std::ifstream in (part.c_str ());
+      std::string line;
+      while (std::getline (in, line))
+        {
+          ResultRow row (m_schemas[index]);
+          if (!line.empty () && row.FromCsv (line))
+            {
+              rows.push_back (row);
+            }
+        }
+      in.close ();
+      std::remove (part.c_str ());
+    }
+  if (rows.empty ())
+    {
+      return false;
+    }
+  if (rows.size () < m_replications)
+    {
+      std::cerr << "SweepRunner: point " << index << " of " << m_outputs[index]->m_filename
+                << " has " << rows.size () << " of " << m_replications << " replications\n";
+    }
+  ResultRow summary = Summarize (rows);
+  m_outputs[index]->WriteRow (summary);
+  m_journal.Record (index, m_keys[index], summary.ToCsv () + "\n");
+  return true;
+}
 
-    m_TxDevices = wifi.Install(nodePhy,wifiMac,m_TxNodes);
+void
+SweepRunner::QueueTasks (std::vector<bool> &resumed)
+{
+  // units whose points are all in the journal need not run again
+  uint32_t nUnits = m_unitStart.size () - 1;
+  resumed.assign (nUnits, true);
+  m_tasks.clear ();
+  for (uint32_t u = 0; u < nUnits; u++)
+    {
+      std::string rows;
+      for (uint32_t i = m_unitStart[u]; i < m_unitStart[u + 1] && resumed[u]; i++)
+        {
+          resumed[u] = m_journal.Lookup (i, m_keys[i], rows);
+        }
+      for (uint32_t r = 0; r < m_replications && !resumed[u]; r++)
+        {
+          m_tasks.push_back (u * m_replications + r);
+        }
+    }
+  uint32_t nTasks = m_tasks.size ();
 
-    wifiMac.SetType("ns3::ApWifiMac","Ssid",SsidValue(ssid));
+  // longest first; the replications of a unit stay next to each other
+  std::vector<std::pair<double, uint32_t> > order;
+  for (uint32_t t = 0; t < nTasks; t++)
+    {
+      uint32_t unit = m_tasks[t] / m_replications;
+      double cost = 0;
+      for (uint32_t i = m_unitStart[unit]; i < m_unitStart[unit + 1]; i++)
+        {
+          cost += m_costs[i];
+        }
+      order.push_back (std::make_pair (-cost, m_tasks[t]));
+    }
+  std::stable_sort (order.begin (), order.end ());
+  for (uint32_t t = 0; t < nTasks; t++)
+    {
+      m_tasks[t] = order[t].second;
+    }
+}
 
-    m_baseDevices = wifi.Install(basePhy,wifiMac,m_baseNodes);
+void
+SweepRunner::RunWorker (uint32_t worker, uint32_t *next, int doneFd, int argc, char **argv)
+{
+  uint32_t task;
+  while ((task = __sync_fetch_and_add (next, 1)) < m_tasks.size ())
+    {
+      if (!RunTask (m_tasks[task], worker, doneFd, argc, argv))
+        {
+          break;
+        }
+    }
+  close (doneFd);
+  // skip static destructors and atexit handlers inherited from the parent
+  _exit (0);
+}
 
-    if (m_asciiTrace != 0)
+uint32_t
+SweepRunner::Run (int argc, char **argv)
+{
+  uint32_t nPoints = m_points.size ();
+  std::vector<uint32_t> done (nPoints, 0); // finished replications
+  uint32_t merged = 0;
+  uint32_t failed = 0;
+  BuildUnits ();
+  uint32_t nUnits = m_unitStart.size () - 1;
+  m_baseRun = RngSeedManager::GetRun ();
+
+  std::vector<bool> resumed;
+  QueueTasks (resumed);
+  for (uint32_t u = 0; u < nUnits; u++)
     {
-      AsciiTraceHelper ascii;
-      Ptr<OutputStreamWrapper> osw = ascii.CreateFileStream ( (m_trName +  "-base.tr").c_str ());
-      Ptr<OutputStreamWrapper> osw1 = ascii.CreateFileStream ( (m_trName +  "-sta.tr").c_str ());
-      basePhy.EnableAsciiAll (osw);
-      nodePhy.EnableAsciiAll (osw1);
+      for (uint32_t i = m_unitStart[u]; i < m_unitStart[u + 1] && resumed[u]; i++)
+        {
+          done[i] = m_replications;
+        }
     }
-    if (m_pcap != 0)
-      {
-        basePhy.EnablePcapAll ("base-station-pcap");
-        nodePhy.EnablePcapAll ("node-pcap");
-      }
+  if (m_journal.IsOpen ())
+    {
+      std::cout << "SweepRunner: " << nPoints << " points, "
+                << std::count (resumed.begin (), resumed.end (), true) << " of "
+                << nUnits << " units of work taken from the journal\n";
+    }
+  uint32_t nTasks = m_tasks.size ();
 
-    for(uint32_t i=0;i<m_nBase;i++){
-      m_allDevices.Add(m_baseDevices.Get(i));
+  if (m_workers <= 1 || nTasks <= 1)
+    {
+      for (uint32_t u = 0; u < nUnits; u++)
+        {
+          for (uint32_t r = 0; r < m_replications && !resumed[u]; r++)
+            {
+              RunTask (u * m_replications + r, 0, -1, argc, argv);
+            }
+          for (uint32_t i = m_unitStart[u]; i < m_unitStart[u + 1]; i++)
+            {
+              if (!MergePoint (i))
+                {
+                  failed++;
+                }
+            }
+        }
+      return failed;
     }
-    for(uint32_t i=0;i<m_nNodes;i++){
-      m_allDevices.Add(m_TxDevices.Get(i));
+
+  uint32_t *next = (uint32_t *) mmap (0, sizeof (uint32_t), PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  int fds[2];
+  if (next == MAP_FAILED || pipe (fds) != 0)
+    {
+      NS_FATAL_ERROR ("SweepRunner: cannot set up the worker pool: " << std::strerror (errno));
     }
+  *next = 0;
 
-  }
-  else if(m_macMode == 1){
-    
-    //TBD STDMA / TDMA
-    TdmaHelper tdma = TdmaHelper(m_allNodes.GetN(),m_allNodes.GetN());
-    TdmaControllerHelper controller;
-    controller.Set ("SlotTime", TimeValue (MicroSeconds (m_slotTime)));
-    controller.Set ("GuardTime", TimeValue (MicroSeconds (m_guardTime)));
-    controller.Set ("InterFrameTime", TimeValue (MicroSeconds (m_interFrameTime)));
-    tdma.SetTdmaControllerHelper (controller);
-    m_allDevices = tdma.Install (m_allNodes);
+  // do not let the children inherit (and later repeat) buffered output
+  std::cout.flush ();
+  std::cerr.flush ();
+  FileHandle::FlushAll ();
 
-    if(m_asciiTrace != 0){
-      AsciiTraceHelper ascii;
-      Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream (m_trName + "-tdma.tr");
-      tdma.EnableAsciiAll (stream);
+  uint32_t nWorkers = std::min (m_workers, nTasks);
+  std::vector<pid_t> pids;
+  for (uint32_t w = 0; w < nWorkers; w++)
+    {
+      pid_t pid = fork ();
+      if (pid == 0)
+        {
+          close (fds[0]);
+          RunWorker (w, next, fds[1], argc, argv);
+        }
+      else if (pid < 0)
+        {
+          NS_LOG_ERROR ("SweepRunner: fork failed: " << std::strerror (errno));
+          break;
+        }
+      pids.push_back (pid);
+    }
+  close (fds[1]);
+  if (pids.empty ())
+    {
+      NS_FATAL_ERROR ("SweepRunner: no worker could be started");
     }
-  }
 
-  
-  
- 
+  // merge rows as soon as every point before them has finished
+  uint32_t index;
+  ssize_t n;
+  while ((n = read (fds[0], &index, sizeof (index))) != 0)
+    {
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n != sizeof (index) || index >= nPoints)
+        {
+          break;
+        }
+      done[index]++;
+      while (merged < nPoints && done[merged] == m_replications)
+        {
+          if (!MergePoint (merged))
+            {
+              failed++;
+            }
+          merged++;
+        }
+    }
+  close (fds[0]);
+
+  for (uint32_t w = 0; w < pids.size (); w++)
+    {
+      int status = 0;
+      waitpid (pids[w], &status, 0);
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        {
+          std::cerr << "SweepRunner: worker " << w << " (pid " << pids[w]
+                    << ") terminated abnormally; its current point is lost\n";
+        }
+    }
 
+  // points lost with a crashed worker leave a gap; merge the rest in order
+  for (; merged < nPoints; merged++)
+    {
+      if (done[merged] == 0 || !MergePoint (merged))
+        {
+          std::cerr << "SweepRunner: point " << merged << " of "
+                    << m_outputs[merged]->m_filename << " produced no row\n";
+          failed++;
+        }
+    }
+  munmap (next, sizeof (uint32_t));
+  return failed;
 }
 
-void Experiment::ConfigureMobility(){
+/**
+ * The sweeps of main(), described declaratively.  A scenario file is a list
+ * of sweeps, one keyword per line ('#' starts a comment):
+ *
+ *   sweep <csv file>           starts a sweep writing its rows to <csv file>
+ *     scenario <n>             the Experiment scenario; also selects the
+ *                              output schema (ResultSchema::ForScenario)
+ *     set <parameter> <value>  a fixed parameter of every point
+ *     grid <parameter> <values> an axis of the parameter grid: values and
+ *                              from:to:step ranges (inclusive)
+ *   end
+ *
+ * The points of a sweep are the Cartesian product of its grid axes, the
+ * first axis varying slowest.  Parameters are those of
+ * Experiment::SetParameter and start from the Experiment defaults.  A
+ * sweep whose axes are all application parameters (packetSize, rate) is
+ * one fork-after-setup group.  Overrides (e.g. --protocol) apply to every
+ * point, after the set lines of its sweep.
+ */
+class ScenarioMatrix
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  ScenarioMatrix ();
 
+  /**
+   * \brief Destructor; closes the sweep files
+   * \return none
+   */
+  ~ScenarioMatrix ();
 
-  //Stationary base stations
-  MobilityHelper mobility;
+  /**
+   * \brief Parses a scenario description
+   * \param is the description
+   * \param name the name of the description, for error messages
+   * \return false (after printing the error) if the description is invalid
+   */
+  bool Parse (std::istream &is, std::string name);
 
-  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
-  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
-                                    "MinX", DoubleValue (50.0),
-                                    "MinY", DoubleValue (0.0),
-                                    "DeltaX", DoubleValue (1000.0),
-                                    "DeltaY", DoubleValue (0.0),
-                                    "GridWidth", UintegerValue (m_nBase),
-                                    "LayoutType", StringValue ("RowFirst"));
-  mobility.Install (m_baseNodes);
+  /**
+   * \brief Sets a parameter of every point, after the set lines of its
+   * sweep and before its grid axes
+   * \param parameter the parameter, as for Experiment::SetParameter
+   * \param value the value
+   * \return false if the parameter or the value is invalid
+   */
+  bool AddOverride (std::string parameter, std::string value);
 
-  m_streamIndex += mobility.AssignStreams (m_baseNodes, m_streamIndex);
+  /**
+   * \brief Opens the sweep files and queues every point
+   * \param runner the sweep runner
+   * \param replications replications of every point (selects the schema)
+   * \param columnar also write columnar files
+   * \param truncate start the sweep files with their header (false to
+   * leave the files alone, e.g. to only plan the sweep)
+   * \return none
+   */
+  void AddPoints (SweepRunner &runner, uint32_t replications, bool columnar, bool truncate = true);
 
+  /**
+   * \brief Returns the scenario file equivalent to the built-in sweeps
+   * \return the scenario description
+   */
+  static std::string GetDefault ();
 
-  std::stringstream ssSpeed;
-  ssSpeed << "ns3::UniformRandomVariable[Min=0.0|Max=" << m_nodeSpeed << "]";
-  std::stringstream ssPause;
-  ssPause << "ns3::ConstantRandomVariable[Constant=" << m_nodePause << "]";
+private:
+  struct Axis
+  {
+    std::string parameter;
+    std::vector<std::string> values;
+  };
+
+  struct Sweep
+  {
+    std::string filename;
+    uint32_t scenario;
+    std::vector<std::pair<std::string, std::string> > fixed;
+    std::vector<Axis> grid;
+  };
 
+  /**
+   * \brief Expands a list of values and from:to:step ranges
+   * \param words the values
+   * \param values filled with the expanded values
+   * \return false if a range is invalid
+   */
+  static bool ExpandValues (const std::vector<std::string> &words, std::vector<std::string> &values);
 
-  if(m_mobility == 0){
-    //Stationary
-    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
-                                  "MinX",DoubleValue(50.0),
-                                  "MinY",DoubleValue(m_yPos),
-                                  "DeltaX",DoubleValue(100.0),
-                                  "GridWidth",UintegerValue(m_nNodes),
-                                  "LayoutType",StringValue("RowFirst"));
-    mobility.Install(m_TxNodes);
-  }
-  else if(m_mobility == 1){
-    //Random Walk
-    ObjectFactory pos2;
-    pos2.SetTypeId ("ns3::RandomBoxPositionAllocator");
-    pos2.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=1500.0]"));
-    pos2.Set ("Y", StringValue ("ns3::UniformRandomVariable[Min=10.0|Max=1500.0]"));
-    Ptr<PositionAllocator> nodePositionAlloc = pos2.Create ()->GetObject<PositionAllocator> ();
-    m_streamIndex += nodePositionAlloc->AssignStreams (m_streamIndex);
+  std::vector<Sweep> m_sweeps;
+  std::vector<std::pair<std::string, std::string> > m_overrides;
+  std::vector<FileHandle *> m_files;
+};
 
-    mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                            "Bounds", RectangleValue (Rectangle (0, 1500, 10, 38000)),
-                            "Speed",StringValue(ssSpeed.str()),
-                            "Distance",DoubleValue(10.0));
+ScenarioMatrix::ScenarioMatrix ()
+{
+}
 
-    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
-                                  "MinX",DoubleValue(50.0),
-                                  "MinY",DoubleValue(100.0),
-                                  "DeltaX",DoubleValue(100.0),
-                                  "GridWidth",UintegerValue(10),
-                                  "LayoutType",StringValue("RowFirst"));
+ScenarioMatrix::~ScenarioMatrix ()
+{
+  for (uint32_t i = 0; i < m_files.size (); i++)
+    {
+      delete m_files[i];
+    }
+}
 
-    mobility.Install(m_TxNodes);
+bool
+ScenarioMatrix::AddOverride (std::string parameter, std::string value)
+{
+  Experiment probe;
+  if (!probe.SetParameter (parameter, value))
+    {
+      return false;
+    }
+  m_overrides.push_back (std::make_pair (parameter, value));
+  return true;
+}
 
-    m_streamIndex += mobility.AssignStreams (m_TxNodes, m_streamIndex);
+std::string
+ScenarioMatrix::GetDefault ()
+{
+  return
+    "# stationary nodes, TDMA, txp = 40000; every node is one hop from the\n"
+    "# base, so static routing (protocol 5) skips the global route computation;\n"
+    "# --protocol overrides it for every sweep\n"
+    "sweep nNode_stats.csv\n"
+    "  scenario 0\n"
+    "  set protocol 5\n"
+    "  set lossModel 1\n"
+    "  grid nodes 10:90:10\n"
+    "end\n"
+    "sweep slotTime_stats.csv\n"
+    "  scenario 2\n"
+    "  set protocol 5\n"
+    "  set guardTime 100\n"
+    "  grid slotTime 1600:11100:500\n"
+    "end\n"
+    "sweep guardTime_stats.csv\n"
+    "  scenario 2\n"
+    "  set protocol 5\n"
+    "  set slotTime 1100\n"
+    "  grid guardTime 150:1100:50\n"
+    "end\n"
+    "sweep slotPacket_stats1100.csv\n"
+    "  scenario 3\n"
+    "  set protocol 5\n"
+    "  set slotTime 1100\n"
+    "  grid packetSize 64:1280:64\n"
+    "end\n"
+    "sweep slotPacket_stats3300.csv\n"
+    "  scenario 3\n"
+    "  set protocol 5\n"
+    "  set slotTime 3300\n"
+    "  grid packetSize 64:1280:64\n"
+    "end\n";
+}
 
-  
-  }
-  else if(m_mobility == 2){
-    //Random Way Point
-    
-    ObjectFactory pos;
-    pos.SetTypeId ("ns3::RandomRectanglePositionAllocator");
-    pos.Set ("X", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=100.0]"));
-    pos.Set ("Y", StringValue ("ns3::UniformRandomVariable[Min=10.0|Max=30000.0]"));
-    Ptr<PositionAllocator> taPositionAlloc = pos.Create ()->GetObject<PositionAllocator> ();
+bool
+ScenarioMatrix::ExpandValues (const std::vector<std::string> &words, std::vector<std::string> &values)
+{
+  for (uint32_t i = 0; i < words.size (); i++)
+    {
+      double from;
+      double to;
+      double step;
+      char colon1;
+      char colon2;
+      std::istringstream range (words[i]);
+      if (words[i].find (':') == std::string::npos)
+        {
+          values.push_back (words[i]);
+        }
+      else if (range >> from >> colon1 >> to >> colon2 >> step && colon1 == ':' && colon2 == ':'
+               && step > 0 && (range >> std::ws).eof ())
+        {
+          // count the steps rather than accumulate them, so no value drifts
+          for (uint32_t k = 0; from + k * step <= to + step * 1e-9; k++)
+            {
+              std::ostringstream value;
+              value.precision (15);
+              value << from + k * step;
+              values.push_back (value.str ());
+            }
+        }
+      else
+        {
+          return false;
+        }
+    }
+  return true;
+}
 
+bool
+ScenarioMatrix::Parse (std::istream &is, std::string name)
+{
+  std::string line;
+  uint32_t lineNumber = 0;
+  bool inSweep = false;
+  Experiment probe;
+  while (std::getline (is, line))
+    {
+      lineNumber++;
+      line = line.substr (0, line.find ('#'));
+      std::istringstream iss (line);
+      std::string keyword;
+      if (!(iss >> keyword))
+        {
+          continue;
+        }
+      std::vector<std::string> words;
+      std::string word;
+      while (iss >> word)
+        {
+          words.push_back (word);
+        }
 
-    mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
-                                      "Speed", StringValue (ssSpeed.str ()),
-                                      "Pause", StringValue (ssPause.str ()),
-                                      "PositionAllocator", PointerValue (taPositionAlloc));
+      std::string error = "";
+      if (keyword == "sweep")
+        {
+          if (inSweep || words.size () != 1)
+            {
+              error = "expected 'sweep <csv file>' outside of a sweep";
+            }
+          else
+            {
+              Sweep sweep;
+              sweep.filename = words[0];
+              sweep.scenario = 0;
+              m_sweeps.push_back (sweep);
+              inSweep = true;
+            }
+        }
+      else if (!inSweep)
+        {
+          error = "'" + keyword + "' outside of a sweep";
+        }
+      else if (keyword == "end")
+        {
+          inSweep = false;
+        }
+      else if (keyword == "scenario")
+        {
+          if (words.size () != 1 || !ParseParameter (words[0], m_sweeps.back ().scenario))
+            {
+              error = "expected 'scenario <n>'";
+            }
+        }
+      else if (keyword == "set")
+        {
+          if (words.size () != 2 || !probe.SetParameter (words[0], words[1]))
+            {
+              error = "expected 'set <parameter> <value>' with a known parameter";
+            }
+          else
+            {
+              m_sweeps.back ().fixed.push_back (std::make_pair (words[0], words[1]));
+            }
+        }
+      else if (keyword == "grid")
+        {
+          Axis axis;
+          axis.parameter = words.empty () ? "" : words[0];
+          words.erase (words.begin (), words.begin () + std::min (words.size (), (size_t) 1));
+          if (!ExpandValues (words, axis.values) || axis.values.empty ())
+            {
+              error = "expected 'grid <parameter> <values or from:to:step ranges>'";
+            }
+          for (uint32_t i = 0; i < axis.values.size () && error == ""; i++)
+            {
+              if (!probe.SetParameter (axis.parameter, axis.values[i]))
+                {
+                  error = "invalid grid value '" + axis.values[i] + "' of '" + axis.parameter + "'";
+                }
+            }
+          if (error == "")
+            {
+              m_sweeps.back ().grid.push_back (axis);
+            }
+        }
+      else
+        {
+          error = "unknown keyword '" + keyword + "'";
+        }
 
-    
-    mobility.Install(m_TxNodes);
+      if (error != "")
+        {
+          std::cerr << name << ":" << lineNumber << ": " << error << "\n";
+          return false;
+        }
+    }
+  if (inSweep)
+    {
+      std::cerr << name << ": missing 'end' of sweep " << m_sweeps.back ().filename << "\n";
+      return false;
+    }
+  return true;
+}
 
-    m_streamIndex += mobility.AssignStreams (m_TxNodes, m_streamIndex);
-  }
- 
+void
+ScenarioMatrix::AddPoints (SweepRunner &runner, uint32_t replications, bool columnar, bool truncate)
+{
+  for (uint32_t s = 0; s < m_sweeps.size (); s++)
+    {
+      const Sweep &sweep = m_sweeps[s];
+      FileHandle *fh = new FileHandle (sweep.filename);
+      m_files.push_back (fh);
+      ResultSchema schema = ResultSchema::ForScenario (sweep.scenario);
+      if (replications > 1)
+        {
+          schema = ResultSchema::WithReplications (schema);
+        }
+      if (truncate)
+        {
+          fh->WriteHeader (schema.GetCsvHeader ());
+        }
+      if (columnar && truncate)
+        {
+          fh->EnableColumnar (schema, fh->m_filename + ".col");
+        }
 
+      // only the applications change: one topology can serve the sweep
+      bool applicationOnly = !sweep.grid.empty ();
+      uint32_t nPoints = 1;
+      for (uint32_t a = 0; a < sweep.grid.size (); a++)
+        {
+          applicationOnly = applicationOnly && (sweep.grid[a].parameter == "packetSize"
+                                                || sweep.grid[a].parameter == "rate");
+          nPoints *= sweep.grid[a].values.size ();
+        }
 
-  Config::Connect ("/NodeList/*/$ns3::MobilityModel/CourseChange",
-                   MakeBoundCallback (&Experiment::CourseChange, &m_os));
+      for (uint32_t p = 0; p < nPoints; p++)
+        {
+          Experiment *experiment = new Experiment ();
+          std::ostringstream scenario;
+          scenario << sweep.scenario;
+          experiment->SetParameter ("scenario", scenario.str ());
+          for (uint32_t f = 0; f < sweep.fixed.size (); f++)
+            {
+              experiment->SetParameter (sweep.fixed[f].first, sweep.fixed[f].second);
+            }
+          for (uint32_t o = 0; o < m_overrides.size (); o++)
+            {
+              experiment->SetParameter (m_overrides[o].first, m_overrides[o].second);
+            }
+          // mixed radix, the last axis varying fastest
+          uint32_t rest = p;
+          for (uint32_t a = sweep.grid.size (); a-- > 0; )
+            {
+              const Axis &axis = sweep.grid[a];
+              experiment->SetParameter (axis.parameter, axis.values[rest % axis.values.size ()]);
+              rest /= axis.values.size ();
+            }
+          experiment->SetFileHandle (fh);
+          runner.AddPoint (experiment, applicationOnly ? s + 1 : 0);
+        }
+    }
 }
 
-void Experiment::ConfigureApplications(){
-  m_routingHelper->Install (m_allNodes,
-                          m_allDevices,
-                          m_allInterfaces,
-                          m_TotalSimTime,
-                          m_protocol,
-                          m_nSinks,
-                          m_routingTables);
 
-  std::ostringstream oss;
-  oss.str ("");
-  oss << "/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/Tx";
-  Config::Connect (oss.str (), MakeCallback (&RoutingHelper::OnOffTrace, m_routingHelper));
+/**
+ * Batched versions of the Friis, TwoRayGround and LogDistance propagation
+ * loss models for distance sweeps: one call fills a whole array of rx
+ * powers instead of moving a MobilityModel and making a virtual
+ * CalcRxPower call per point.
+ *
+ * The loops are branch-free and use a polynomial log10 (within ~1e-15 of
+ * std::log10) rather than libm, so the compiler can vectorize them without
+ * -ffast-math.  The formulas, defaults and distance cut-offs are the ones
+ * of the ns-3 models; distances are in metres and powers in dBm.
+ */
+class PathLossBatch
+{
+public:
+  /**
+   * \brief Friis free-space model
+   * \param txPowerDbm transmit power
+   * \param distance distances between transmitter and receivers
+   * \param n number of distances
+   * \param frequency carrier frequency in Hz
+   * \param rxPowerDbm filled with the n received powers
+   * \param systemLoss system loss (dimensionless)
+   * \param minLoss minimum loss in dB
+   * \return none
+   */
+  static void Friis (double txPowerDbm, const double *distance, uint32_t n,
+                     double frequency, double *rxPowerDbm,
+                     double systemLoss = 1.0, double minLoss = 0.0);
+
+  /**
+   * \brief Two-ray ground reflection model (Friis below the crossover
+   * distance)
+   * \param txPowerDbm transmit power
+   * \param distance distances between transmitter and receivers
+   * \param n number of distances
+   * \param frequency carrier frequency in Hz
+   * \param txHeight transmitter antenna height (z + HeightAboveZ)
+   * \param rxHeight receiver antenna height (z + HeightAboveZ)
+   * \param rxPowerDbm filled with the n received powers
+   * \param systemLoss system loss (dimensionless)
+   * \param minDistance distance at or below which no loss is applied
+   * \return none
+   */
+  static void TwoRayGround (double txPowerDbm, const double *distance, uint32_t n,
+                            double frequency, double txHeight, double rxHeight,
+                            double *rxPowerDbm, double systemLoss = 1.0,
+                            double minDistance = 0.5);
 
-  // oss.str ("");
-  // oss << "/NodeList/*/ApplicationList/*/$ns3::UdpEchoServer/Rx";
-  // Config::Connect (oss.str (), MakeCallback (&RoutingHelper::EchoServerTrace, m_routingHelper));
+  /**
+   * \brief Log-distance model
+   * \param txPowerDbm transmit power
+   * \param distance distances between transmitter and receivers
+   * \param n number of distances
+   * \param rxPowerDbm filled with the n received powers
+   * \param exponent path loss exponent
+   * \param referenceDistance reference distance in m
+   * \param referenceLoss loss at the reference distance in dB
+   * \return none
+   */
+  static void LogDistance (double txPowerDbm, const double *distance, uint32_t n,
+                           double *rxPowerDbm, double exponent = 3.0,
+                           double referenceDistance = 1.0,
+                           double referenceLoss = 46.6777);
 
-  // oss.str ("");
-  // oss << "/NodeList/*/ApplicationList/*/$ns3::UdpEchoClient/Tx";
-  // Config::Connect (oss.str (), MakeCallback (&RoutingHelper::EchoClientTxTrace, m_routingHelper));
+  /**
+   * \brief Branch-free log10 for positive, finite, normal arguments
+   * \param x the argument
+   * \return log10 (x)
+   */
+  static inline double Log10 (double x);
 
-  // oss.str ("");
-  // oss << "/NodeList/*/ApplicationList/*/$ns3::UdpEchoClient/Tx";
-  // Config::Connect (oss.str (), MakeCallback (&RoutingHelper::EchoClientRxTrace, m_routingHelper));
+private:
+  static const double SPEED_OF_LIGHT; // m/s, as used by the ns-3 models
+};
 
-  //Config::Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/EnergyDetectionThreshold", DoubleValue(-82.0));
+const double PathLossBatch::SPEED_OF_LIGHT = 299792458.0;
 
+inline double
+PathLossBatch::Log10 (double x)
+{
+  uint64_t bits;
+  std::memcpy (&bits, &x, sizeof (bits));
+  // unbiased exponent as a double, via the 2^52 trick (no int->fp convert)
+  uint64_t exponentBits = (bits >> 52) | 0x4330000000000000ULL;
+  double e;
+  std::memcpy (&e, &exponentBits, sizeof (e));
+  e -= 4503599627370496.0 + 1023.0;
+  // mantissa in [1, 2), folded into [sqrt(1/2), sqrt(2))
+  bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+  double m;
+  std::memcpy (&m, &bits, sizeof (m));
+  bool high = m > M_SQRT2;
+  m = high ? m * 0.5 : m;
+  e = high ? e + 1.0 : e;
+  // ln (m) = 2 atanh (s), |s| < 0.172, series truncated after s^19
+  double s = (m - 1.0) / (m + 1.0);
+  double s2 = s * s;
+  double p = 2.0 / 19;
+  p = p * s2 + 2.0 / 17;
+  p = p * s2 + 2.0 / 15;
+  p = p * s2 + 2.0 / 13;
+  p = p * s2 + 2.0 / 11;
+  p = p * s2 + 2.0 / 9;
+  p = p * s2 + 2.0 / 7;
+  p = p * s2 + 2.0 / 5;
+  p = p * s2 + 2.0 / 3;
+  p = p * s2 + 2.0;
+  return (e * M_LN2 + s * p) * M_LOG10E;
 }
 
-void Experiment::ConfigureTracing(){
+void
+PathLossBatch::Friis (double txPowerDbm, const double *__restrict__ distance, uint32_t n,
+                      double frequency, double *__restrict__ rxPowerDbm,
+                      double systemLoss, double minLoss)
+{
+  double lambda = SPEED_OF_LIGHT / frequency;
+  // -10 log10 (lambda^2 / (16 pi^2 d^2 L)) = c + 20 log10 (d)
+  double c = 10 * std::log10 (16 * M_PI * M_PI * systemLoss / (lambda * lambda));
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double d = distance[i];
+      double lossDb = c + 20 * Log10 (d);
+      lossDb = lossDb > minLoss ? lossDb : minLoss;
+      rxPowerDbm[i] = d > 0 ? txPowerDbm - lossDb : txPowerDbm - minLoss;
+    }
+}
 
+void
+PathLossBatch::TwoRayGround (double txPowerDbm, const double *__restrict__ distance, uint32_t n,
+                             double frequency, double txHeight, double rxHeight,
+                             double *__restrict__ rxPowerDbm, double systemLoss,
+                             double minDistance)
+{
+  double lambda = SPEED_OF_LIGHT / frequency;
+  double dCross = (4 * M_PI * txHeight * rxHeight) / lambda;
+  // Friis: 10 log10 (lambda^2 / (16 pi^2 d^2 L)) = friisC - 20 log10 (d)
+  double friisC = 10 * std::log10 (lambda * lambda / (16 * M_PI * M_PI * systemLoss));
+  // two-ray: 10 log10 ((ht hr)^2 / (d^4 L)) = rayC - 40 log10 (d)
+  double rayC = 10 * std::log10 (txHeight * txHeight * rxHeight * rxHeight / systemLoss);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double d = distance[i];
+      double lg = Log10 (d);
+      double pr = d <= dCross ? friisC - 20 * lg : rayC - 40 * lg;
+      rxPowerDbm[i] = d <= minDistance ? txPowerDbm : txPowerDbm + pr;
+    }
 }
 
-void Experiment::RunSimulation(){
-  NS_LOG_INFO ("Run Simulation.");
+void
+PathLossBatch::LogDistance (double txPowerDbm, const double *__restrict__ distance, uint32_t n,
+                            double *__restrict__ rxPowerDbm, double exponent,
+                            double referenceDistance, double referenceLoss)
+{
+  double lgRef = std::log10 (referenceDistance);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double d = distance[i];
+      double pathLossDb = 10 * exponent * (Log10 (d) - lgRef);
+      rxPowerDbm[i] = d <= referenceDistance ? txPowerDbm - referenceLoss
+        : txPowerDbm - referenceLoss - pathLossDb;
+    }
+}
 
-  CheckThroughput ();
+/**
+ * \brief Counts the heap allocations of the per-packet paths: the OnOff Tx
+ * trace callback on its own, which must not allocate at all, and a short
+ * default simulation (without animation trace), whose allocations per
+ * simulated packet (sent or received) must not exceed those recorded in a
+ * baseline file by more than 5%.  The baseline is only written on request;
+ * checking against a missing one fails.
+ * \param packets number of packets passed to the trace callback
+ * \param baselineFile the baseline file
+ * \param writeBaseline write the baseline instead of checking against it
+ * \param program the program name, for the experiment's command line
+ * \return false if the callback allocates, the simulation regressed or the
+ * baseline is missing
+ */
+static bool
+BenchmarkAllocations (uint32_t packets, std::string baselineFile, bool writeBaseline, char *program)
+{
+  Ptr<RoutingHelper> helper = CreateObject<RoutingHelper> ();
+  helper->GetNodeStats ().Reset (1);
+  Ptr<const Packet> packet = Create<Packet> (512);
+  // the first call creates the simulator
+  helper->OnOffTrace (0, 0, packet);
+  uint64_t start = g_heapAllocations;
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      helper->OnOffTrace (0, 0, packet);
+    }
+  uint64_t traceAllocations = g_heapAllocations - start;
+  Simulator::Destroy ();
 
-  AnimationInterface anim("experiment.xml");
-  anim.SetMaxPktsPerTraceFile(50000000);
+  // no cost history entry for the benchmark run
+  GlobalValue::Bind ("CostHistory", StringValue (""));
+  FileHandle fh ("bench-alloc.csv");
+  Experiment experiment;
+  experiment.SetParameter ("totaltime", "60");
+  experiment.SetFileHandle (&fh);
+  experiment.SetAnimFile ("");
+  char *args[] = { program, 0 };
+  experiment.SetUp (1, args);
+  start = g_heapAllocations;
+  experiment.Finish ();
+  uint64_t runAllocations = g_heapAllocations - start;
+  const NodeStatsTable &stats = experiment.GetRoutingHelper ()->GetNodeStats ();
+  uint64_t runPackets = 0;
+  for (uint32_t i = 0; i < stats.GetN (); i++)
+    {
+      runPackets += stats.GetTxPkts (i) + stats.GetRxPkts (i);
+    }
+  double perPacket = (double) runAllocations / std::max (runPackets, (uint64_t) 1);
 
-  
-  Simulator::Stop (Seconds (m_TotalSimTime));
-  Simulator::Run ();
+  std::cout << "path,allocations,packets,allocationsPerPacket\n"
+            << "OnOffTrace," << traceAllocations << "," << packets << ","
+            << (double) traceAllocations / std::max (packets, (uint32_t) 1) << "\n"
+            << "simulation," << runAllocations << "," << runPackets << "," << perPacket << "\n";
 
-  
-  
-  std::cout<<"Tx Bytes: "<<m_routingHelper->GetRoutingStats().GetCumulativeTxBytes()<<"\n";
-  std::cout<<"Rx Bytes: "<<m_routingHelper->GetRoutingStats().GetCumulativeRxBytes()<<"\n";
-  
-  Simulator::Destroy ();
+  bool ok = true;
+  if (traceAllocations != 0)
+    {
+      std::cerr << "BenchmarkAllocations: the OnOff trace callback allocates\n";
+      ok = false;
+    }
+  if (writeBaseline)
+    {
+      std::ofstream (baselineFile.c_str ()) << perPacket << "\n";
+      std::cout << "BenchmarkAllocations: baseline written to " << baselineFile << "\n";
+      return ok;
+    }
+  std::ifstream in (baselineFile.c_str ());
+  double baseline;
+  if (!(in >> baseline))
+    {
+      std::cerr << "BenchmarkAllocations: no baseline in " << baselineFile
+                << " (write one with --allocWriteBaseline)\n";
+      return false;
+    }
+  if (perPacket > baseline * 1.05)
+    {
+      std::cerr << "BenchmarkAllocations: " << perPacket << " allocations per packet, baseline "
+                << baseline << " (" << baselineFile << ")\n";
+      ok = false;
+    }
+  return ok;
 }
 
-void Experiment::ProcessOutputs(){
-
+/**
+ * \brief Micro-benchmark of FileHandle against the previous open-per-row
+ * writer, using rows shaped like the frissLoss.csv ones
+ * \param rows number of rows to write with each writer
+ * \return none
+ */
+static void
+BenchmarkFileHandle (uint32_t rows)
+{
+  std::string legacyName = "bench-legacy.csv";
+  std::string bufferedName = "bench-buffered.csv";
 
-  
-  double averageRoutingGoodputKbps = 0.0;
-  uint32_t totalBytesTotal = m_routingHelper->GetRoutingStats ().GetCumulativeRxBytes ();
-  double transimissionTime = (m_routingHelper->GetRoutingStats().GetLastRxTime() - m_routingHelper->GetRoutingStats().GetFirstTxTime()).ToDouble(Time::S);
-  averageRoutingGoodputKbps = ((double) totalBytesTotal * 8.0)/transimissionTime/1000;
-  double pdr = ((double)m_routingHelper->GetRoutingStats().GetCumulativeRxPkts() * 100)/((double)m_routingHelper->GetRoutingStats().GetCumulativeTxPkts());
-  double packetLoss = ((double)m_routingHelper->GetRoutingStats().GetCumulativeTxPkts() -  (double)m_routingHelper->GetRoutingStats().GetCumulativeRxPkts());
+  double start = WallClockSeconds ();
+  std::ofstream(legacyName.c_str ()) << "txpower,distance,rxpower" << std::endl;
+  for (uint32_t i = 0; i < rows; i++)
+    {
+      std::ostringstream oss;
+      oss << 21 << "," << i << "," << -40.0 - i * 1e-3 << std::endl;
+      // what FileHandle::WriteData used to do for every row
+      std::ofstream out (legacyName.c_str (), std::ios::app);
+      out << oss.str () << std::endl;
+      out.close ();
+    }
+  double legacySeconds = WallClockSeconds () - start;
 
-  double avgDelay = (m_routingHelper->GetRoutingStats().GetCumulativeDelaySum())/(double)m_routingHelper->GetRoutingStats().GetCumulativeRxPkts();
+  start = WallClockSeconds ();
+  {
+    FileHandle fh (bufferedName);
+    fh.WriteHeader ("txpower,distance,rxpower");
+    for (uint32_t i = 0; i < rows; i++)
+      {
+        std::ostringstream oss;
+        oss << 21 << "," << i << "," << -40.0 - i * 1e-3 << std::endl;
+        fh.WriteData (oss.str ());
+      }
+  }
+  double bufferedSeconds = WallClockSeconds () - start;
+
+  std::cout << "writer,rows,seconds,rows_per_sec\n";
+  std::cout << "open-per-row," << rows << "," << legacySeconds << ","
+            << rows / std::max (legacySeconds, 1e-9) << "\n";
+  std::cout << "buffered," << rows << "," << bufferedSeconds << ","
+            << rows / std::max (bufferedSeconds, 1e-9) << "\n";
+  std::remove (legacyName.c_str ());
+  std::remove (bufferedName.c_str ());
+}
 
+/**
+ * \brief Checks PathLossBatch against the per-call ns-3 models and compares
+ * their throughput (points/sec) on a one-metre distance sweep
+ * \param points number of distances in the sweep
+ * \return the largest absolute rx power difference in dB
+ */
+static double
+BenchmarkPathLoss (uint32_t points)
+{
+  double txPower = 21;
+  double frequency = 5.8e9;
+  double heightAboveZ = 50;
+  std::vector<double> distance (points);
+  for (uint32_t i = 0; i < points; i++)
+    {
+      distance[i] = 10.0 + i;
+    }
+  std::vector<double> scalar (points);
+  std::vector<double> batch (points);
 
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  a->SetPosition (Vector (0.0, 0.0, 0.0));
 
-  std::cout<<"avgThroughput: "<<averageRoutingGoodputKbps<<" kbps\n";
-  std::cout<<"Packet Delivery Ratio: "<<pdr<<"%\n";
-  std::cout<<"Total Packets lost: "<<packetLoss<<"\n";
-  std::cout<<"average Delay: "<<avgDelay<<" seconds\n";
+  Ptr<FriisPropagationLossModel> friis = CreateObject<FriisPropagationLossModel> ();
+  friis->SetFrequency (frequency);
+  Ptr<TwoRayGroundPropagationLossModel> twoRay = CreateObject<TwoRayGroundPropagationLossModel> ();
+  twoRay->SetFrequency (frequency);
+  twoRay->SetHeightAboveZ (heightAboveZ);
+  Ptr<LogDistancePropagationLossModel> logDistance = CreateObject<LogDistancePropagationLossModel> ();
+  Ptr<PropagationLossModel> models[] = { friis, twoRay, logDistance };
+  const char *names[] = { "Friis", "TwoRayGround", "LogDistance" };
+
+  double worst = 0;
+  std::cout << "model,points,scalar_pts_per_sec,batch_pts_per_sec,max_abs_diff_db\n";
+  for (uint32_t m = 0; m < 3; m++)
+    {
+      double start = WallClockSeconds ();
+      for (uint32_t i = 0; i < points; i++)
+        {
+          b->SetPosition (Vector (distance[i], 0.0, 0.0));
+          scalar[i] = models[m]->CalcRxPower (txPower, a, b);
+        }
+      double scalarSeconds = WallClockSeconds () - start;
 
-  std::ostringstream oss;
-  oss.str ("");
-  if(m_scenario == 1){
-    oss << m_nNodes << "," << averageRoutingGoodputKbps << "," << avgDelay << ","
-    << m_routingHelper->GetRoutingStats ().GetCumulativeRxPkts ()
-    << "," << m_rate << "," << pdr << std::endl;
-    m_fh->WriteData(oss.str());
-  }
-  else if(m_scenario == 2){
-    oss << m_nNodes << "," << averageRoutingGoodputKbps << "," << avgDelay << ","
-    << packetLoss
-    << "," <<m_slotTime<<","<< m_guardTime << "," << pdr << std::endl;
-    m_fh->WriteData(oss.str());
-  }
-  else if(m_scenario == 3){
-    oss << m_nNodes << "," << averageRoutingGoodputKbps << "," << avgDelay << ","
-    << m_slotTime 
-    << "," << m_packetSize << "," << pdr << std::endl;
-    m_fh->WriteData(oss.str());
-  }
-  else{
-    oss << m_nNodes << "," << averageRoutingGoodputKbps << "," << avgDelay << ","
-    << m_routingHelper->GetRoutingStats ().GetCumulativeRxPkts ()
-    << "," << packetLoss << "," << pdr << std::endl;
-    m_fh->WriteData(oss.str());
-  }
- 
-    
+      start = WallClockSeconds ();
+      if (m == 0)
+        {
+          PathLossBatch::Friis (txPower, &distance[0], points, frequency, &batch[0]);
+        }
+      else if (m == 1)
+        {
+          PathLossBatch::TwoRayGround (txPower, &distance[0], points, frequency,
+                                       heightAboveZ, heightAboveZ, &batch[0]);
+        }
+      else
+        {
+          PathLossBatch::LogDistance (txPower, &distance[0], points, &batch[0]);
+        }
+      double batchSeconds = WallClockSeconds () - start;
 
+      double diff = 0;
+      for (uint32_t i = 0; i < points; i++)
+        {
+          diff = std::max (diff, std::fabs (scalar[i] - batch[i]));
+        }
+      worst = std::max (worst, diff);
+      std::cout << names[m] << "," << points << ","
+                << points / std::max (scalarSeconds, 1e-9) << ","
+                << points / std::max (batchSeconds, 1e-9) << "," << diff << "\n";
+    }
+  return worst;
 }
 
-void Experiment::CourseChange (std::ostream *os, std::string foo, Ptr<const MobilityModel> mobility)
+static void
+CountContextCourseChange (uint64_t *count, std::string context, Ptr<const MobilityModel> mobility)
 {
-  Vector pos = mobility->GetPosition (); // Get position
-  Vector vel = mobility->GetVelocity (); // Get velocity
-
-
-  int nodeId = mobility->GetObject<Node> ()->GetId ();
-  double t = (Simulator::Now ()).GetSeconds ();
-  //NS_LOG_UNCOND ("Changing pos for node=" << nodeId << " at " << Simulator::Now () );
+  (*count)++;
+}
 
-  // Prints position and velocities
-  *os << Simulator::Now () << " POS: x=" << pos.x << ", y=" << pos.y
-       << "; VEL:" << vel.x << ", y=" << vel.y << std::endl;
+static void
+CountCourseChange (uint64_t *count, uint32_t node, Ptr<const MobilityModel> mobility)
+{
+  (*count)++;
 }
 
-void Experiment::CheckThroughput(){
-    
+static void
+CountContextOnOffTx (uint64_t *count, std::string context, Ptr<const Packet> packet)
+{
+  (*count)++;
 }
 
-void Experiment::SetupLogFile(){
-  m_os.open (m_logFile.c_str ());
+static void
+CountOnOffTx (uint64_t *count, uint32_t node, uint32_t app, Ptr<const Packet> packet)
+{
+  (*count)++;
 }
 
-void Experiment::SetDefaultAttributeValues(){
+/**
+ * One measurement of the scaling benchmark
+ */
+struct ScalingResult
+{
+  uint32_t macMode;
+  uint32_t mobility;
+  uint32_t nodes;
+  double wallSeconds; // the whole run, setup included
+  double eventsPerSecond; // while the simulation runs
+  double simPerWall; // simulated seconds per wall-clock second
+  uint64_t peakRssKb;
+};
 
+/**
+ * \brief Runs one point of the scaling benchmark in a forked process, so
+ * its peak RSS is its own
+ * \param result the point to run (macMode, mobility, nodes); filled with
+ * the measurements
+ * \param simTime simulated seconds
+ * \param program the program name, for the experiment's command line
+ * \return false if the run failed
+ */
+static bool
+RunScalingPoint (ScalingResult &result, double simTime, char *program)
+{
+  int fds[2];
+  if (pipe (fds) != 0)
+    {
+      return false;
+    }
+  std::cout.flush ();
+  FileHandle::FlushAll ();
+  pid_t pid = fork ();
+  if (pid == 0)
+    {
+      close (fds[0]);
+      std::ostringstream value;
+      FileHandle fh ("bench-scaling.csv");
+      Experiment experiment;
+      value << result.nodes;
+      experiment.SetParameter ("nodes", value.str ());
+      value.str ("");
+      value << result.macMode;
+      experiment.SetParameter ("macMode", value.str ());
+      value.str ("");
+      value << result.mobility;
+      experiment.SetParameter ("mobility", value.str ());
+      value.str ("");
+      value << simTime;
+      experiment.SetParameter ("totaltime", value.str ());
+      experiment.SetFileHandle (&fh);
+      experiment.SetAnimFile ("");
+      char *args[] = { program, 0 };
+      experiment.SetUp (1, args);
+      experiment.Finish ();
+
+      const PhaseProfiler &profiler = experiment.GetProfiler ();
+      for (uint32_t i = 0; i < profiler.GetN (); i++)
+        {
+          const PhaseProfiler::Phase &phase = profiler.Get (i);
+          if (phase.depth == 0)
+            {
+              result.wallSeconds = phase.wallSeconds;
+            }
+          else if (phase.name == "RunSimulation" && phase.wallSeconds > 0)
+            {
+              result.eventsPerSecond = phase.events / phase.wallSeconds;
+              result.simPerWall = simTime / phase.wallSeconds;
+            }
+        }
+      struct rusage usage;
+      getrusage (RUSAGE_SELF, &usage);
+      result.peakRssKb = usage.ru_maxrss;
+      bool ok = write (fds[1], &result, sizeof (result)) == sizeof (result);
+      FileHandle::FlushAll ();
+      _exit (ok ? 0 : 1);
+    }
+  close (fds[1]);
+  bool ok = pid > 0 && read (fds[0], &result, sizeof (result)) == sizeof (result);
+  close (fds[0]);
+  int status = 0;
+  if (pid > 0)
+    {
+      waitpid (pid, &status, 0);
+    }
+  return ok && WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
 
-  
-  Config::SetDefault ("ns3::OnOffApplication::PacketSize",StringValue(std::to_string(m_packetSize)));
-  Config::SetDefault ("ns3::OnOffApplication::DataRate",  StringValue (m_rate));
-  Config::SetDefault ("ns3::SimpleWirelessChannel::MaxRange", DoubleValue (m_txp));
+/**
+ * \brief Measures how Experiment scales with the node count: stationary
+ * and RandomWaypoint nodes under Wi-Fi (macMode 0) and TDMA (macMode 1),
+ * 10 to 10000 nodes, a short fixed simulated time, each run in its own
+ * process.  The results are written to a baseline file, or compared with
+ * it: a run whose wall time or peak RSS exceeds the baseline by more than
+ * the threshold is a regression
+ * \param maxNodes the largest node count measured
+ * \param baselineFile the baseline CSV file
+ * \param compare compare with the baseline instead of writing it
+ * \param threshold allowed relative increase, e.g. 0.2 for 20%
+ * \param program the program name, for the experiment's command line
+ * \return the number of regressions and failed runs
+ */
+static uint32_t
+BenchmarkScaling (uint32_t maxNodes, std::string baselineFile, bool compare, double threshold, char *program)
+{
+  uint32_t nodeCounts[] = { 10, 30, 100, 300, 1000, 3000, 10000 };
+  uint32_t mobilities[] = { 0, 2 };
+  const double simTime = 5.0;
+
+  std::map<std::string, ScalingResult> baseline;
+  if (compare)
+    {
+      std::ifstream in (baselineFile.c_str ());
+      std::string line;
+      while (std::getline (in, line))
+        {
+          std::istringstream iss (line);
+          ScalingResult r;
+          char c[6];
+          if (iss >> r.macMode >> c[0] >> r.mobility >> c[1] >> r.nodes >> c[2] >> r.wallSeconds >> c[3]
+              >> r.eventsPerSecond >> c[4] >> r.simPerWall >> c[5] >> r.peakRssKb)
+            {
+              std::ostringstream key;
+              key << r.macMode << "," << r.mobility << "," << r.nodes;
+              baseline[key.str ()] = r;
+            }
+        }
+      if (baseline.empty ())
+        {
+          NS_FATAL_ERROR ("No scaling baseline in " << baselineFile);
+        }
+    }
 
+  // no cost history entries, per-node or profile reports for the benchmark runs
+  GlobalValue::Bind ("CostHistory", StringValue (""));
+  GlobalValue::Bind ("NodeReport", BooleanValue (false));
+  GlobalValue::Bind ("ProfileReport", BooleanValue (false));
 
+  std::ostringstream results;
+  results << "macMode,mobility,nodes,wallSeconds,eventsPerSecond,simPerWall,peakRssKb\n";
+  std::cout << results.str ();
+  uint32_t failed = 0;
+  for (uint32_t mac = 0; mac < 2; mac++)
+    {
+      for (uint32_t m = 0; m < sizeof (mobilities) / sizeof (mobilities[0]); m++)
+        {
+          for (uint32_t k = 0; k < sizeof (nodeCounts) / sizeof (nodeCounts[0]) && nodeCounts[k] <= maxNodes; k++)
+            {
+              ScalingResult r;
+              r.macMode = mac;
+              r.mobility = mobilities[m];
+              r.nodes = nodeCounts[k];
+              r.wallSeconds = 0;
+              r.eventsPerSecond = 0;
+              r.simPerWall = 0;
+              r.peakRssKb = 0;
+              std::ostringstream key;
+              key << r.macMode << "," << r.mobility << "," << r.nodes;
+              if (!RunScalingPoint (r, simTime, program))
+                {
+                  std::cerr << "BenchmarkScaling: run " << key.str () << " failed\n";
+                  failed++;
+                  continue;
+                }
+              std::ostringstream line;
+              line << key.str () << "," << r.wallSeconds << "," << r.eventsPerSecond << ","
+                   << r.simPerWall << "," << r.peakRssKb << "\n";
+              std::cout << line.str () << std::flush;
+              results << line.str ();
+
+              std::map<std::string, ScalingResult>::iterator it = baseline.find (key.str ());
+              if (it == baseline.end ())
+                {
+                  continue;
+                }
+              if (r.wallSeconds > it->second.wallSeconds * (1 + threshold))
+                {
+                  std::cerr << "BenchmarkScaling: " << key.str () << " wall time " << r.wallSeconds
+                            << " s, baseline " << it->second.wallSeconds << " s\n";
+                  failed++;
+                }
+              if (r.peakRssKb > it->second.peakRssKb * (1 + threshold))
+                {
+                  std::cerr << "BenchmarkScaling: " << key.str () << " peak RSS " << r.peakRssKb
+                            << " kB, baseline " << it->second.peakRssKb << " kB\n";
+                  failed++;
+                }
+            }
+        }
+    }
+  if (!compare)
+    {
+      std::ofstream (baselineFile.c_str ()) << results.str ();
+      std::cout << "BenchmarkScaling: baseline written to " << baselineFile << "\n";
+    }
+  return failed;
 }
 
-void Experiment::ConfigureDevices(){
- //Already done in ConfigureChannels
+/**
+ * \brief Compares the startup of global routing with the static single-hop
+ * cell routing: the time RoutingHelper::Install takes (stack, routing,
+ * addresses and applications) for nodes on one shared channel
+ * \param maxNodes the largest node count measured
+ * \return none
+ */
+static void
+BenchmarkRoutingSetup (uint32_t maxNodes)
+{
+  uint32_t nodeCounts[] = { 100, 500, 1000, 2000, 5000, 10000 };
+  std::cout << "nodes,globalSeconds,staticSeconds\n";
+  for (uint32_t k = 0; k < sizeof (nodeCounts) / sizeof (nodeCounts[0]) && nodeCounts[k] <= maxNodes; k++)
+    {
+      double seconds[2];
+      uint32_t protocols[2] = { 0, 5 };
+      for (uint32_t p = 0; p < 2; p++)
+        {
+          NodeContainer nodes;
+          nodes.Create (nodeCounts[k]);
+          SimpleNetDeviceHelper devices;
+          NetDeviceContainer d = devices.Install (nodes);
+          Ipv4InterfaceContainer interfaces;
+          Ptr<RoutingHelper> helper = CreateObject<RoutingHelper> ();
+          double start = WallClockSeconds ();
+          helper->Install (nodes, d, interfaces, 10.0, protocols[p], 0, 0);
+          seconds[p] = WallClockSeconds () - start;
+          Simulator::Destroy ();
+        }
+      std::cout << nodeCounts[k] << "," << seconds[0] << "," << seconds[1] << "\n";
+    }
 }
 
-void Experiment::SetupScenario(){
-  if(m_scenario == 1){
-    //Tdma set no of nodes with different transmission rates
-    m_mobility = 2;
-    m_macMode = 1;
+/**
+ * \brief Compares Config::Connect with wildcard paths against TraceHookup:
+ * the time to connect the OnOffApplication Tx and CourseChange traces of
+ * 10, 1000 and 10000 nodes, the cost of one CourseChange event and that of
+ * one OnOffApplication packet sent (one simulated second of traffic per
+ * hookup; the sockets have no route, so a packet ends at the IP layer)
+ * \param events number of course changes fired, and about the number of
+ * packets sent, per node count and hookup
+ * \return none
+ */
+static void
+BenchmarkTraceHookup (uint32_t events)
+{
+  uint32_t nodeCounts[] = { 10, 1000, 10000 };
+  std::cout << "nodes,configConnectSeconds,hookupSeconds,configEventNs,hookupEventNs,configTxNs,hookupTxNs\n";
+  for (uint32_t k = 0; k < sizeof (nodeCounts) / sizeof (nodeCounts[0]); k++)
+    {
+      NodeContainer nodes;
+      nodes.Create (nodeCounts[k]);
+      MobilityHelper mobility;
+      mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+      mobility.Install (nodes);
+      InternetStackHelper stack;
+      stack.Install (nodes);
+      // about events packets per simulated second over all nodes
+      uint32_t packetsPerNode = std::max (events / nodeCounts[k], (uint32_t) 1);
+      OnOffHelper onoff ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address ("10.1.0.1"), 9));
+      onoff.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1000]"));
+      onoff.SetAttribute ("OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=0]"));
+      onoff.SetAttribute ("PacketSize", UintegerValue (64));
+      onoff.SetAttribute ("DataRate", DataRateValue (DataRate (packetsPerNode * 64 * 8)));
+      ApplicationContainer apps = onoff.Install (nodes);
+      apps.Start (Seconds (0));
+      apps.Stop (Seconds (2));
+      std::vector<Ptr<MobilityModel> > models;
+      for (uint32_t i = 0; i < nodes.GetN (); i++)
+        {
+          models.push_back (nodes.Get (i)->GetObject<MobilityModel> ());
+        }
 
-  }
+      // wildcard paths, string context per event
+      uint64_t count = 0;
+      uint64_t configTx = 0;
+      double start = WallClockSeconds ();
+      Config::Connect ("/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/Tx",
+                       MakeBoundCallback (&CountContextOnOffTx, &configTx));
+      Config::Connect ("/NodeList/*/$ns3::MobilityModel/CourseChange",
+                       MakeBoundCallback (&CountContextCourseChange, &count));
+      double configSeconds = WallClockSeconds () - start;
+      start = WallClockSeconds ();
+      for (uint32_t e = 0; e < events; e++)
+        {
+          models[e % models.size ()]->SetPosition (Vector (e, 0.0, 0.0));
+        }
+      double configEventSeconds = WallClockSeconds () - start;
+      Simulator::Stop (Seconds (1));
+      start = WallClockSeconds ();
+      Simulator::Run ();
+      double configTxSeconds = WallClockSeconds () - start;
+      Config::Disconnect ("/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/Tx",
+                          MakeBoundCallback (&CountContextOnOffTx, &configTx));
+      Config::Disconnect ("/NodeList/*/$ns3::MobilityModel/CourseChange",
+                          MakeBoundCallback (&CountContextCourseChange, &count));
+
+      // pre-resolved slots
+      uint64_t hookupTx = 0;
+      TraceHookup hookup;
+      start = WallClockSeconds ();
+      hookup.ConnectOnOffTx (nodes, MakeBoundCallback (&CountOnOffTx, &hookupTx));
+      hookup.ConnectCourseChange (nodes, MakeBoundCallback (&CountCourseChange, &count));
+      double hookupSeconds = WallClockSeconds () - start;
+      start = WallClockSeconds ();
+      for (uint32_t e = 0; e < events; e++)
+        {
+          models[e % models.size ()]->SetPosition (Vector (e, 0.0, 0.0));
+        }
+      double hookupEventSeconds = WallClockSeconds () - start;
+      Simulator::Stop (Seconds (1));
+      start = WallClockSeconds ();
+      Simulator::Run ();
+      double hookupTxSeconds = WallClockSeconds () - start;
 
-  if(m_scenario == 2){
-    m_mobility = 2;
-    m_macMode = 1;
-    m_nNodes = 20;
-  }
+      if (count != 2 * (uint64_t) events)
+        {
+          NS_FATAL_ERROR ("Trace benchmark counted " << count << " course changes, expected " << 2 * events);
+        }
+      if (configTx == 0 || hookupTx == 0)
+        {
+          NS_FATAL_ERROR ("Trace benchmark counted " << configTx << " and " << hookupTx << " packets sent");
+        }
+      std::cout << nodeCounts[k] << "," << configSeconds << "," << hookupSeconds << ","
+                << configEventSeconds * 1e9 / std::max (events, (uint32_t) 1) << ","
+                << hookupEventSeconds * 1e9 / std::max (events, (uint32_t) 1) << ","
+                << configTxSeconds * 1e9 / configTx << "," << hookupTxSeconds * 1e9 / hookupTx << "\n";
+      Simulator::Destroy ();
+    }
 }
 
-
-
 std::string filename = "exp_out.csv";
 std::ofstream out_file(filename.c_str());
 int main (int argc, char *argv[])
@@ -1801,78 +8995,204 @@ int main (int argc, char *argv[])
   // Experiment experiment;
   // experiment.Simulate (argc, argv);
 
-  // Running stationary node with tdma txp = 40000
+  uint32_t workers = 1;
+  std::string bench = "";
+  uint32_t benchSize = 49990;
+  bool columnar = false;
+  bool profileEvents = false;
+  bool forkVariants = false;
+  std::string scenarios = "";
+  bool printScenarios = false;
+  std::string invalidateCache = "";
+  std::string journal = "sweep.journal";
+  bool resume = false;
+  uint32_t replications = 1;
+  std::string toCsv = "";
+  std::string csvOut = "";
+  std::string allocBaseline = "alloc-baseline.txt";
+  bool allocWriteBaseline = false;
+  std::string decodeLog = "";
+  std::string scalingBaseline = "scaling-baseline.csv";
+  bool scalingCompare = false;
+  double scalingThreshold = 0.2;
+  bool dryRun = false;
+  int protocol = -1;
+  CommandLine cmd;
+  cmd.AddValue ("workers", "Number of worker processes running sweep points in parallel", workers);
+  cmd.AddValue ("forkVariants", "Build the topology shared by application-only sweep points once per worker and fork a process per point", forkVariants);
+  cmd.AddValue ("replications", "Independent replications (RngRun, RngRun+1, ...) of every sweep point, summarized as mean/sd/ci95", replications);
+  cmd.AddValue ("invalidateCache", "Remove the ResultCache entries whose parameters contain this text (e.g. m_scenario=2; * for all)", invalidateCache);
+  cmd.AddValue ("journal", "Journal recording every finished sweep point (empty for none)", journal);
+  cmd.AddValue ("resume", "Resume an interrupted sweep: take the points recorded in the journal from it", resume);
+  cmd.AddValue ("protocol", "Routing protocol of every sweep point, overriding the scenarios: 0=global routing;1=OLSR;2=AODV;3=DSDV;4=DSR;5=static single-hop cell (-1 keeps the scenarios' choice)", protocol);
+  cmd.AddValue ("scenarios", "Scenario file describing the sweeps (default: the built-in sweeps)", scenarios);
+  cmd.AddValue ("dryRun", "Print the predicted wall time and memory of the sweep (from the CostHistory runs) and exit", dryRun);
+  cmd.AddValue ("printScenarios", "Print the built-in sweeps as a scenario file and exit", printScenarios);
+  cmd.AddValue ("bench", "Run a micro-benchmark instead of the sweeps: filehandle|pathloss|tracehookup|alloc|routingsetup|scaling", bench);
+  cmd.AddValue ("benchSize", "Problem size of the micro-benchmark", benchSize);
+  cmd.AddValue ("scalingBaseline", "Baseline file the scaling benchmark writes, or compares with", scalingBaseline);
+  cmd.AddValue ("scalingCompare", "Compare the scaling benchmark with its baseline instead of writing it", scalingCompare);
+  cmd.AddValue ("scalingThreshold", "Relative wall time/peak RSS increase the scaling comparison flags", scalingThreshold);
+  cmd.AddValue ("allocBaseline", "File holding the allocations per packet the alloc benchmark must not exceed", allocBaseline);
+  cmd.AddValue ("allocWriteBaseline", "Write the alloc benchmark's baseline instead of checking against it", allocWriteBaseline);
+  cmd.AddValue ("columnar", "Also write each sweep to a columnar binary file (<csv>.col)", columnar);
+  cmd.AddValue ("profileEvents", "Run the simulations on the profiling simulator (per-event-source times, queue depth)", profileEvents);
+  cmd.AddValue ("decodeLog", "Print a binary event log (--EventLog) as text and exit", decodeLog);
+  cmd.AddValue ("toCsv", "Convert a columnar result file to CSV and exit", toCsv);
+  cmd.AddValue ("csvOut", "CSV file written by --toCsv (default: <toCsv>.csv)", csvOut);
+  cmd.Parse (argc, argv);
+
+  if (profileEvents)
+    {
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::ProfilingSimulatorImpl"));
+    }
+
+  if (printScenarios)
+    {
+      std::cout << ScenarioMatrix::GetDefault ();
+      return 0;
+    }
 
-  FileHandle fh = FileHandle("nNode_stats.csv");
-  fh.WriteHeader("n_nodes,throughput,delay,packetRx,packetLoss,pdr");
-  double txp = 40000;
-  for(int i=10;i<100;i+=10){
-    Experiment(30000,2,i,1,1,txp,&fh).Simulate(argc,argv);
-  }
+  if (invalidateCache != "")
+    {
+      if (ResultCache::Get () == 0)
+        {
+          NS_FATAL_ERROR ("--invalidateCache needs --ResultCache=<directory>");
+        }
+      std::cout << "ResultCache: removed " << ResultCache::Get ()->Invalidate (invalidateCache) << " entries\n";
+    }
 
-  FileHandle fh2 = FileHandle("slotTime_stats.csv");
-  fh2.WriteHeader("n_nodes,throughput,delay,packetLoss,slotTime,guardTime,pdr");
-  for(int i=0;i<20;i++){
-    int time = 1100+(500*(i+1));
-    Experiment(&fh2,time,100).Simulate(argc,argv);
-  }
+  if (decodeLog != "")
+    {
+      return EventLog::Decode (decodeLog, std::cout) ? 0 : 1;
+    }
 
+  if (toCsv != "")
+    {
+      return ColumnarWriter::ConvertToCsv (toCsv, csvOut != "" ? csvOut : toCsv + ".csv") ? 0 : 1;
+    }
 
-  FileHandle fh3 = FileHandle("guardTime_stats.csv");
-  fh3.WriteHeader("n_nodes,throughput,delay,packetLoss,slotTime,guardTime,pdr");
-  for(int i=1;i<=20;i++){
-    int time = 100+(i*50);
-    Experiment(&fh3,1100,time).Simulate(argc,argv);
-  }
+  if (bench == "filehandle")
+    {
+      BenchmarkFileHandle (benchSize);
+      return 0;
+    }
+  else if (bench == "pathloss")
+    {
+      // the batched kernels must agree with the models to well below 1e-6 dB
+      return BenchmarkPathLoss (benchSize) < 1e-9 ? 0 : 1;
+    }
+  else if (bench == "tracehookup")
+    {
+      BenchmarkTraceHookup (benchSize);
+      return 0;
+    }
+  else if (bench == "scaling")
+    {
+      // benchSize is the largest node count
+      return BenchmarkScaling (benchSize, scalingBaseline, scalingCompare, scalingThreshold, argv[0]) == 0 ? 0 : 1;
+    }
+  else if (bench == "routingsetup")
+    {
+      // benchSize is the largest node count
+      BenchmarkRoutingSetup (benchSize);
+      return 0;
+    }
+  else if (bench == "alloc")
+    {
+      return BenchmarkAllocations (benchSize, allocBaseline, allocWriteBaseline, argv[0]) ? 0 : 1;
+    }
+  else if (bench != "")
+    {
+      NS_FATAL_ERROR ("Unknown benchmark " << bench);
+    }
 
-  FileHandle fh5 = FileHandle("slotPacket_stats1100.csv");
-  fh5.WriteHeader("n_nodes,throughput,delay,slotTime,packetSize,pdr");
-  for(int i=0;i<20;i++){
-    int size = 64*(i+1);
-    Experiment(&fh5,size,1100).Simulate(argc,argv);
-  }
+  SweepRunner runner (workers, forkVariants, replications);
+  CostModel costModel;
+  StringValue costHistory;
+  g_costHistory.GetValue (costHistory);
+  if (costHistory.Get () != "")
+    {
+      costModel.Load (costHistory.Get ());
+    }
+  runner.SetCostModel (&costModel);
+  // a dry run must not truncate the journal of a sweep it plans to resume
+  if (journal != "" && (!dryRun || resume))
+    {
+      runner.EnableJournal (journal, resume);
+    }
 
-  FileHandle fh6 = FileHandle("slotPacket_stats3300.csv");
-  fh6.WriteHeader("n_nodes,throughput,delay,slotTime,packetSize,pdr");
-  for(int i=0;i<20;i++){
-    int size = 64*(i+1);
-    Experiment(&fh6,size,3300).Simulate(argc,argv);
-  }
+  ScenarioMatrix matrix;
+  if (scenarios != "")
+    {
+      std::ifstream in (scenarios.c_str ());
+      if (!in)
+        {
+          NS_FATAL_ERROR ("Cannot open scenario file " << scenarios);
+        }
+      if (!matrix.Parse (in, scenarios))
+        {
+          return 1;
+        }
+    }
+  else
+    {
+      std::istringstream in (ScenarioMatrix::GetDefault ());
+      matrix.Parse (in, "built-in scenarios");
+    }
+  if (protocol >= 0)
+    {
+      std::ostringstream value;
+      value << protocol;
+      if (protocol > 5 || !matrix.AddOverride ("protocol", value.str ()))
+        {
+          std::cerr << "Invalid --protocol " << protocol << "\n";
+          return 1;
+        }
+    }
+  matrix.AddPoints (runner, replications, columnar, !dryRun);
 
-  
-  FileHandle fh4 = FileHandle("frissLoss.csv");
+  if (dryRun)
+    {
+      runner.PrintPlan (std::cout);
+      return 0;
+    }
+  uint32_t failed = runner.Run(argc,argv);
+
+  FileHandle fh4("frissLoss.csv");
   fh4.WriteHeader("txpower,distance,rxpower");
   double txPower = 21;
-  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
-  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
-  a->SetPosition (Vector (0.0, 0.0, 0.0));
-  Ptr<FriisPropagationLossModel> friss = CreateObject <FriisPropagationLossModel>();
+  std::vector<double> distance;
   for(int i=10;i<50000;i++){
-    
-    b->SetPosition(Vector((double)i,0.0,0.0));
-    double rxPowerDbm = friss->CalcRxPower (txPower, a, b);
+    distance.push_back((double)i);
+  }
+  std::vector<double> rxPowerDbm(distance.size());
+  Ptr<FriisPropagationLossModel> friss = CreateObject <FriisPropagationLossModel>();
+  PathLossBatch::Friis(txPower, &distance[0], distance.size(), friss->GetFrequency(),
+                       &rxPowerDbm[0], friss->GetSystemLoss(), friss->GetMinLoss());
+  for(uint32_t i=0;i<distance.size();i++){
     std::ostringstream oss;
     oss.str ("");
-    oss << txPower << "," << i << "," << rxPowerDbm << std::endl;
+    oss << txPower << "," << distance[i] << "," << rxPowerDbm[i] << std::endl;
     fh4.WriteData(oss.str());
   }
 
-  FileHandle fh7 = FileHandle("TwoRayLoss.csv");
+  FileHandle fh7("TwoRayLoss.csv");
   fh7.WriteHeader("txpower,distance,rxpower");
-  a->SetPosition (Vector (0.0, 0.0, 0.0));
   Ptr<TwoRayGroundPropagationLossModel> tworay = CreateObject <TwoRayGroundPropagationLossModel>();
-  tworay->SetHeightAboveZ(56000);
-  for(int i=10;i<50000;i++){
-    
-    b->SetPosition(Vector((double)i,0.0,0.0));
-    double rxPowerDbm = tworay->CalcRxPower (txPower, a, b);
+  double heightAboveZ = 56000;
+  tworay->SetHeightAboveZ(heightAboveZ);
+  // both antennas sit at z=0, so their heights are just HeightAboveZ
+  PathLossBatch::TwoRayGround(txPower, &distance[0], distance.size(), tworay->GetFrequency(),
+                              heightAboveZ, heightAboveZ, &rxPowerDbm[0],
+                              tworay->GetSystemLoss(), tworay->GetMinDistance());
+  for(uint32_t i=0;i<distance.size();i++){
     std::ostringstream oss;
     oss.str ("");
-    oss << txPower << "," << i << "," << rxPowerDbm << std::endl;
+    oss << txPower << "," << distance[i] << "," << rxPowerDbm[i] << std::endl;
     fh7.WriteData(oss.str());
   }
 
-  
-  
-  
+  // points lost with a crashed worker fail the sweep for scripts
+  return failed > 0 ? 1 : 0;
 }
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
 #include "ns3/core-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/network-module.h"
@@ -8,7 +13,6 @@
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/ssid.h"
 #include "ns3/netanim-module.h"
-#include "ns3/flow-monitor-module.h"
 #include "ns3/wifi-module.h"
 
 
@@ -16,18 +20,586 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("wifi-seven");
 
+/**
+ * Five-tuple of a UDP/TCP flow, as Ipv4FlowClassifier defines it.
+ */
+struct FlowKey {
+    uint32_t sourceAddress;
+    uint32_t destinationAddress;
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint8_t protocol;
+
+    bool operator==(const FlowKey &o) const {
+        return sourceAddress == o.sourceAddress && destinationAddress == o.destinationAddress
+            && sourcePort == o.sourcePort && destinationPort == o.destinationPort
+            && protocol == o.protocol;
+    }
+
+    bool operator<(const FlowKey &o) const {
+        if (sourceAddress != o.sourceAddress) return sourceAddress < o.sourceAddress;
+        if (destinationAddress != o.destinationAddress) return destinationAddress < o.destinationAddress;
+        if (sourcePort != o.sourcePort) return sourcePort < o.sourcePort;
+        if (destinationPort != o.destinationPort) return destinationPort < o.destinationPort;
+        return protocol < o.protocol;
+    }
+};
+
+/**
+ * Fixed-size per-flow counters: the FlowMonitor::FlowStats fields the
+ * summary uses.  Times are in nanoseconds; flowId 0 marks an empty slot.
+ */
+struct FlowRecord {
+    FlowKey key;
+    uint32_t flowId;
+    uint32_t txPackets;
+    uint32_t rxPackets;
+    uint32_t droppedPackets;
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    int64_t timeFirstTxPacket;
+    int64_t timeLastRxPacket;
+    int64_t delaySum;
+    int64_t lastActivity;
+    int64_t timeLastSeen; // last send or forward of a packet of the flow
+
+    /**
+     * \brief Packets neither received nor dropped that FlowMonitor's
+     * CheckForLostPackets would count as lost: those not seen for
+     * maxPerHopDelay.  Packets in flight are taken to be as old as the
+     * flow's last send or forward, so a flow still sending when the check
+     * runs has none
+     * \param now the current time, in nanoseconds
+     * \param maxPerHopDelay FlowMonitor's MaxPerHopDelay, in nanoseconds
+     * \return the number of lost packets
+     */
+    uint32_t GetLostPackets(int64_t now, int64_t maxPerHopDelay) const {
+        uint32_t done = rxPackets + droppedPackets;
+        if (txPackets <= done || now - timeLastSeen < maxPerHopDelay) {
+            return 0;
+        }
+        return txPackets - done;
+    }
+};
+
+/**
+ * Packet tag carrying the flow id, five-tuple and send time of a packet
+ * from its source to the node it is delivered to.  The five-tuple
+ * attributes drops in device queues, where the IPv4 header is not at hand.
+ */
+class FlowStatsTag : public Tag {
+public:
+    static TypeId GetTypeId();
+
+    FlowStatsTag();
+
+    FlowStatsTag(uint32_t flowId, const FlowKey &key, int64_t txTime);
+
+    virtual TypeId GetInstanceTypeId() const;
+
+    virtual uint32_t GetSerializedSize() const;
+
+    virtual void Serialize(TagBuffer buf) const;
+
+    virtual void Deserialize(TagBuffer buf);
+
+    virtual void Print(std::ostream &os) const;
+
+    uint32_t GetFlowId() const;
+
+    const FlowKey & GetKey() const;
+
+    int64_t GetTxTime() const;
+
+private:
+    uint32_t m_flowId;
+    FlowKey m_key;
+    int64_t m_txTime;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FlowStatsTag);
+
+TypeId FlowStatsTag::GetTypeId() {
+    static TypeId tid = TypeId("FlowStatsTag")
+        .SetParent<Tag>()
+        .AddConstructor<FlowStatsTag>();
+    return tid;
+}
+
+FlowStatsTag::FlowStatsTag()
+    : m_flowId(0),
+      m_txTime(0) {
+    std::memset(&m_key, 0, sizeof(m_key));
+}
+
+FlowStatsTag::FlowStatsTag(uint32_t flowId, const FlowKey &key, int64_t txTime)
+    : m_flowId(flowId),
+      m_key(key),
+      m_txTime(txTime) {
+}
+
+TypeId FlowStatsTag::GetInstanceTypeId() const {
+    return GetTypeId();
+}
+
+uint32_t FlowStatsTag::GetSerializedSize() const {
+    return 4 + 13 + 8;
+}
+
+void FlowStatsTag::Serialize(TagBuffer buf) const {
+    buf.WriteU32(m_flowId);
+    buf.WriteU32(m_key.sourceAddress);
+    buf.WriteU32(m_key.destinationAddress);
+    buf.WriteU16(m_key.sourcePort);
+    buf.WriteU16(m_key.destinationPort);
+    buf.WriteU8(m_key.protocol);
+    buf.WriteU64(m_txTime);
+}
+
+void FlowStatsTag::Deserialize(TagBuffer buf) {
+    m_flowId = buf.ReadU32();
+    std::memset(&m_key, 0, sizeof(m_key));
+    m_key.sourceAddress = buf.ReadU32();
+    m_key.destinationAddress = buf.ReadU32();
+    m_key.sourcePort = buf.ReadU16();
+    m_key.destinationPort = buf.ReadU16();
+    m_key.protocol = buf.ReadU8();
+    m_txTime = buf.ReadU64();
+}
+
+void FlowStatsTag::Print(std::ostream &os) const {
+    os << "FlowId=" << m_flowId << " TxTime=" << m_txTime << "ns";
+}
+
+uint32_t FlowStatsTag::GetFlowId() const {
+    return m_flowId;
+}
+
+const FlowKey & FlowStatsTag::GetKey() const {
+    return m_key;
+}
+
+int64_t FlowStatsTag::GetTxTime() const {
+    return m_txTime;
+}
+
+/**
+ * Slim replacement for FlowMonitor.  Packets are classified on their
+ * five-tuple into a flat open-addressing (linear probing) hash table of
+ * fixed-size FlowRecords; the send time travels with the packet in a
+ * FlowStatsTag, so no per-packet state is kept.
+ *
+ * With a flow limit the table never grows: when it is full, flows idle for
+ * longer than the idle timeout (or, failing that, the least recently active
+ * one) are evicted to a spill file and merged back by GetFlowStats.  A flow
+ * that becomes active again after eviction gets a new record, which is
+ * merged with the spilled one under the first flow id.
+ */
+class FlowStatsEngine {
+public:
+    /**
+     * \brief Constructor
+     * \param maxFlows flows kept in memory (0 for no limit)
+     * \param idleTimeout inactivity after which a flow may be evicted
+     * \param spillFile file evicted flows are written to
+     * \return none
+     */
+    FlowStatsEngine(uint32_t maxFlows = 0, Time idleTimeout = Seconds(10.0),
+                    std::string spillFile = "flow-stats.spill");
+
+    ~FlowStatsEngine();
+
+    /**
+     * \brief Connects to the IPv4 traces and the queue drop traces (device
+     * queues and queue discs, as FlowMonitor does) of every node with an
+     * internet stack
+     * \return none
+     */
+    void InstallAll();
+
+    /**
+     * \brief Returns the statistics of every flow, spilled ones included
+     * \return the flow records ordered by flow id
+     */
+    std::vector<FlowRecord> GetFlowStats();
+
+    /**
+     * \brief Returns how many flow records were evicted to the spill file
+     * \return the number of evicted records
+     */
+    uint32_t GetNEvicted() const;
+
+private:
+    FlowStatsEngine(const FlowStatsEngine &);
+    FlowStatsEngine & operator=(const FlowStatsEngine &);
+
+    void SendOutgoing(const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface);
+
+    void LocalDeliver(const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface);
+
+    void UnicastForward(const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface);
+
+    void Drop(const Ipv4Header &header, Ptr<const Packet> packet,
+              Ipv4L3Protocol::DropReason reason, Ptr<Ipv4> ipv4, uint32_t interface);
+
+    void QueueDrop(Ptr<const Packet> packet);
+
+    void QueueDiscDrop(Ptr<const QueueItem> item);
+
+    /**
+     * \brief Extracts the five-tuple of a UDP or TCP packet
+     * \param header the IPv4 header
+     * \param packet the IPv4 payload
+     * \param key filled with the five-tuple
+     * \return false if the packet is not UDP/TCP
+     */
+    static bool Classify(const Ipv4Header &header, Ptr<const Packet> packet, FlowKey &key);
+
+    static uint32_t Hash(const FlowKey &key);
+
+    /**
+     * \brief Looks up a flow, creating its record if needed
+     * \param key the five-tuple
+     * \param flowId the id of a new record (0 assigns the next free id)
+     * \return the record
+     */
+    FlowRecord* Lookup(const FlowKey &key, uint32_t flowId);
+
+    uint32_t FindSlot(const FlowKey &key) const;
+
+    void Remove(uint32_t slot);
+
+    void Resize(uint32_t capacity);
+
+    void EvictIdle();
+
+    std::vector<FlowRecord> m_table; // power-of-two capacity
+    uint32_t m_nFlows;
+    uint32_t m_nextFlowId;
+    uint32_t m_maxFlows;
+    int64_t m_idleTimeout;
+    std::string m_spillFile;
+    FILE* m_spill;
+    uint32_t m_nEvicted;
+};
+
+FlowStatsEngine::FlowStatsEngine(uint32_t maxFlows, Time idleTimeout, std::string spillFile)
+    : m_nFlows(0),
+      m_nextFlowId(1),
+      m_maxFlows(maxFlows),
+      m_idleTimeout(idleTimeout.GetNanoSeconds()),
+      m_spillFile(spillFile),
+      m_spill(0),
+      m_nEvicted(0) {
+    uint32_t capacity = 64;
+    while (m_maxFlows > 0 && capacity < 2 * m_maxFlows) {
+        capacity *= 2;
+    }
+    Resize(capacity);
+}
+
+FlowStatsEngine::~FlowStatsEngine() {
+    if (m_spill != 0) {
+        std::fclose(m_spill);
+        std::remove(m_spillFile.c_str());
+    }
+}
+
+void FlowStatsEngine::InstallAll() {
+    for (NodeList::Iterator i = NodeList::Begin(); i != NodeList::End(); ++i) {
+        Ptr<Ipv4L3Protocol> ipv4 = (*i)->GetObject<Ipv4L3Protocol>();
+        if (ipv4 == 0) {
+            continue;
+        }
+        ipv4->TraceConnectWithoutContext("SendOutgoing", MakeCallback(&FlowStatsEngine::SendOutgoing, this));
+        ipv4->TraceConnectWithoutContext("LocalDeliver", MakeCallback(&FlowStatsEngine::LocalDeliver, this));
+        ipv4->TraceConnectWithoutContext("UnicastForward", MakeCallback(&FlowStatsEngine::UnicastForward, this));
+        ipv4->TraceConnectWithoutContext("Drop", MakeCallback(&FlowStatsEngine::Drop, this));
+        std::ostringstream node;
+        node << "/NodeList/" << (*i)->GetId();
+        Config::ConnectWithoutContext(node.str() + "/DeviceList/*/TxQueue/Drop",
+                                      MakeCallback(&FlowStatsEngine::QueueDrop, this));
+        Config::ConnectWithoutContext(node.str() + "/$ns3::TrafficControlLayer/RootQueueDiscList/*/Drop",
+                                      MakeCallback(&FlowStatsEngine::QueueDiscDrop, this));
+    }
+}
+
+bool FlowStatsEngine::Classify(const Ipv4Header &header, Ptr<const Packet> packet, FlowKey &key) {
+    if ((header.GetProtocol() != 6 && header.GetProtocol() != 17) || packet->GetSize() < 4) {
+        return false;
+    }
+    // UDP and TCP headers both start with the source and destination ports
+    uint8_t ports[4];
+    packet->CopyData(ports, 4);
+    std::memset(&key, 0, sizeof(key));
+    key.sourceAddress = header.GetSource().Get();
+    key.destinationAddress = header.GetDestination().Get();
+    key.sourcePort = (ports[0] << 8) | ports[1];
+    key.destinationPort = (ports[2] << 8) | ports[3];
+    key.protocol = header.GetProtocol();
+    return true;
+}
+
+uint32_t FlowStatsEngine::Hash(const FlowKey &key) {
+    uint64_t h = key.sourceAddress;
+    h = h * 0x9e3779b97f4a7c15ULL + key.destinationAddress;
+    h = h * 0x9e3779b97f4a7c15ULL + (((uint32_t) key.sourcePort << 16) | key.destinationPort);
+    h = h * 0x9e3779b97f4a7c15ULL + key.protocol;
+    return (uint32_t) (h ^ (h >> 29) ^ (h >> 47));
+}
+
+uint32_t FlowStatsEngine::FindSlot(const FlowKey &key) const {
+    uint32_t mask = m_table.size() - 1;
+    uint32_t slot = Hash(key) & mask;
+    while (m_table[slot].flowId != 0 && !(m_table[slot].key == key)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void FlowStatsEngine::Resize(uint32_t capacity) {
+    std::vector<FlowRecord> old;
+    old.swap(m_table);
+    FlowRecord empty;
+    std::memset(&empty, 0, sizeof(empty));
+    m_table.assign(capacity, empty);
+    for (uint32_t i = 0; i < old.size(); i++) {
+        if (old[i].flowId != 0) {
+            m_table[FindSlot(old[i].key)] = old[i];
+        }
+    }
+}
+
+void FlowStatsEngine::Remove(uint32_t slot) {
+    // backward-shift deletion keeps every probe sequence unbroken
+    uint32_t mask = m_table.size() - 1;
+    uint32_t hole = slot;
+    uint32_t next = slot;
+    while (true) {
+        next = (next + 1) & mask;
+        if (m_table[next].flowId == 0) {
+            break;
+        }
+        uint32_t home = Hash(m_table[next].key) & mask;
+        bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            m_table[hole] = m_table[next];
+            hole = next;
+        }
+    }
+    m_table[hole].flowId = 0;
+    m_nFlows--;
+}
+
+void FlowStatsEngine::EvictIdle() {
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    std::vector<FlowKey> victims;
+    uint32_t oldest = m_table.size();
+    for (uint32_t i = 0; i < m_table.size(); i++) {
+        if (m_table[i].flowId == 0) {
+            continue;
+        }
+        if (now - m_table[i].lastActivity > m_idleTimeout) {
+            victims.push_back(m_table[i].key);
+        }
+        if (oldest == m_table.size() || m_table[i].lastActivity < m_table[oldest].lastActivity) {
+            oldest = i;
+        }
+    }
+    if (victims.empty() && oldest < m_table.size()) {
+        victims.push_back(m_table[oldest].key);
+    }
+
+    if (m_spill == 0) {
+        m_spill = std::fopen(m_spillFile.c_str(), "w+b");
+        if (m_spill == 0) {
+            NS_FATAL_ERROR("Cannot create flow spill file " << m_spillFile);
+        }
+    }
+    for (uint32_t i = 0; i < victims.size(); i++) {
+        uint32_t slot = FindSlot(victims[i]);
+        if (std::fwrite(&m_table[slot], sizeof(FlowRecord), 1, m_spill) != 1) {
+            NS_FATAL_ERROR("Cannot write flow spill file " << m_spillFile);
+        }
+        Remove(slot);
+        m_nEvicted++;
+    }
+}
+
+FlowRecord* FlowStatsEngine::Lookup(const FlowKey &key, uint32_t flowId) {
+    uint32_t slot = FindSlot(key);
+    if (m_table[slot].flowId != 0) {
+        return &m_table[slot];
+    }
+    if (m_maxFlows > 0 && m_nFlows >= m_maxFlows) {
+        EvictIdle();
+        slot = FindSlot(key);
+    }
+    else if (m_maxFlows == 0 && 2 * (m_nFlows + 1) > m_table.size()) {
+        Resize(m_table.size() * 2);
+        slot = FindSlot(key);
+    }
+    FlowRecord &record = m_table[slot];
+    std::memset(&record, 0, sizeof(record));
+    record.key = key;
+    record.flowId = flowId != 0 ? flowId : m_nextFlowId++;
+    record.timeFirstTxPacket = Simulator::Now().GetNanoSeconds();
+    m_nFlows++;
+    return &record;
+}
+
+void FlowStatsEngine::SendOutgoing(const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface) {
+    FlowKey key;
+    if (!Classify(header, packet, key)) {
+        return;
+    }
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    FlowRecord* record = Lookup(key, 0);
+    if (record->txPackets == 0) {
+        record->timeFirstTxPacket = now;
+    }
+    record->txPackets++;
+    record->txBytes += header.GetSerializedSize() + packet->GetSize();
+    record->lastActivity = now;
+    record->timeLastSeen = now;
+
+    // the tag is the only per-packet state; FlowMonitor's probes do the same
+    Packet* p = const_cast<Packet*>(PeekPointer(packet));
+    FlowStatsTag tag;
+    p->RemovePacketTag(tag);
+    p->AddPacketTag(FlowStatsTag(record->flowId, key, now));
+}
+
+void FlowStatsEngine::UnicastForward(const Ipv4Header &, Ptr<const Packet> packet, uint32_t) {
+    FlowStatsTag tag;
+    if (!packet->PeekPacketTag(tag)) {
+        return;
+    }
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    FlowRecord* record = Lookup(tag.GetKey(), tag.GetFlowId());
+    record->timeLastSeen = now;
+    record->lastActivity = now;
+}
+
+void FlowStatsEngine::LocalDeliver(const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface) {
+    FlowStatsTag tag;
+    FlowKey key;
+    // removed so that a packet sent back (e.g. by an echo server) is a new packet
+    if (!const_cast<Packet*>(PeekPointer(packet))->RemovePacketTag(tag) || !Classify(header, packet, key)) {
+        return;
+    }
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    FlowRecord* record = Lookup(key, tag.GetFlowId());
+    record->rxPackets++;
+    record->rxBytes += header.GetSerializedSize() + packet->GetSize();
+    record->delaySum += now - tag.GetTxTime();
+    record->timeLastRxPacket = now;
+    record->lastActivity = now;
+}
+
+void FlowStatsEngine::Drop(const Ipv4Header &header, Ptr<const Packet> packet,
+                           Ipv4L3Protocol::DropReason reason, Ptr<Ipv4> ipv4, uint32_t interface) {
+    FlowStatsTag tag;
+    FlowKey key;
+    if (!packet->PeekPacketTag(tag) || !Classify(header, packet, key)) {
+        return;
+    }
+    FlowRecord* record = Lookup(key, tag.GetFlowId());
+    record->droppedPackets++;
+    record->lastActivity = Simulator::Now().GetNanoSeconds();
+}
+
+void FlowStatsEngine::QueueDrop(Ptr<const Packet> packet) {
+    // below IPv4 the packet carries link headers, so the tag names the flow
+    FlowStatsTag tag;
+    if (!packet->PeekPacketTag(tag)) {
+        return;
+    }
+    FlowRecord* record = Lookup(tag.GetKey(), tag.GetFlowId());
+    record->droppedPackets++;
+    record->lastActivity = Simulator::Now().GetNanoSeconds();
+}
+
+void FlowStatsEngine::QueueDiscDrop(Ptr<const QueueItem> item) {
+    QueueDrop(item->GetPacket());
+}
+
+static bool CompareFlowId(const FlowRecord &a, const FlowRecord &b) {
+    return a.flowId < b.flowId;
+}
+
+std::vector<FlowRecord> FlowStatsEngine::GetFlowStats() {
+    std::vector<FlowRecord> records;
+    for (uint32_t i = 0; i < m_table.size(); i++) {
+        if (m_table[i].flowId != 0) {
+            records.push_back(m_table[i]);
+        }
+    }
+    if (m_spill == 0) {
+        std::sort(records.begin(), records.end(), CompareFlowId);
+        return records;
+    }
+
+    // fold the spilled records back into one record per five-tuple
+    std::map<FlowKey, FlowRecord> merged;
+    std::rewind(m_spill);
+    FlowRecord spilled;
+    while (std::fread(&spilled, sizeof(spilled), 1, m_spill) == 1) {
+        records.push_back(spilled);
+    }
+    std::fseek(m_spill, 0, SEEK_END);
+    for (uint32_t i = 0; i < records.size(); i++) {
+        std::map<FlowKey, FlowRecord>::iterator it = merged.find(records[i].key);
+        if (it == merged.end()) {
+            merged.insert(std::make_pair(records[i].key, records[i]));
+            continue;
+        }
+        FlowRecord &r = it->second;
+        const FlowRecord &o = records[i];
+        if (o.txPackets > 0 && (r.txPackets == 0 || o.timeFirstTxPacket < r.timeFirstTxPacket)) {
+            r.timeFirstTxPacket = o.timeFirstTxPacket;
+        }
+        r.flowId = std::min(r.flowId, o.flowId);
+        r.txPackets += o.txPackets;
+        r.rxPackets += o.rxPackets;
+        r.droppedPackets += o.droppedPackets;
+        r.txBytes += o.txBytes;
+        r.rxBytes += o.rxBytes;
+        r.timeLastRxPacket = std::max(r.timeLastRxPacket, o.timeLastRxPacket);
+        r.delaySum += o.delaySum;
+        r.lastActivity = std::max(r.lastActivity, o.lastActivity);
+        r.timeLastSeen = std::max(r.timeLastSeen, o.timeLastSeen);
+    }
+    records.clear();
+    for (std::map<FlowKey, FlowRecord>::const_iterator it = merged.begin(); it != merged.end(); ++it) {
+        records.push_back(it->second);
+    }
+    std::sort(records.begin(), records.end(), CompareFlowId);
+    return records;
+}
+
+uint32_t FlowStatsEngine::GetNEvicted() const {
+    return m_nEvicted;
+}
+
 int main(int argc, char* argv[]){
     
     uint32_t nWifi = 6;
     uint32_t nPackets = 1;
     uint32_t packetSize = 1024;
     bool verbose = false;
+    uint32_t maxFlows = 0;
+    double flowIdleTimeout = 10.0;
+    std::string flowSpill = "wifi-seven-flows.spill";
     CommandLine cmd;
 
     cmd.AddValue ("Wifi", "Number of Wifi STA devices", nWifi);
     cmd.AddValue ("nPackets", "Number of packets to be sent from each station device", nPackets);
     cmd.AddValue ("packetSize", "Size of Each packet",packetSize);
     cmd.AddValue ("verbose","Enable Applcation Logging",verbose);
+    cmd.AddValue ("maxFlows","Flows kept in memory by the flow stats (0 = no limit)",maxFlows);
+    cmd.AddValue ("flowIdleTimeout","Seconds of inactivity after which a flow may be spilled",flowIdleTimeout);
+    cmd.AddValue ("flowSpill","File that flows evicted from memory are spilled to",flowSpill);
     cmd.Parse (argc,argv);
 
     
@@ -129,8 +701,8 @@ int main(int argc, char* argv[]){
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
     //Throughput creation
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+    FlowStatsEngine flowStats(maxFlows, Seconds(flowIdleTimeout), flowSpill);
+    flowStats.InstallAll();
 
     //Tracing stuff
     
@@ -143,25 +715,27 @@ int main(int argc, char* argv[]){
     
     Simulator::Run ();
 
-    monitor->CheckForLostPackets();
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-    std::map<FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats ();
+    std::vector<FlowRecord> stats = flowStats.GetFlowStats ();
+    // as FlowMonitor::CheckForLostPackets with its default MaxPerHopDelay
+    int64_t now = Simulator::Now ().GetNanoSeconds ();
+    int64_t maxPerHopDelay = Seconds (10.0).GetNanoSeconds ();
     float avgThroughput = 0;
     float totalflows = 0;
     int lostPackets = 0;
-    for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    for (std::vector<FlowRecord>::const_iterator i = stats.begin (); i != stats.end (); ++i)
     {
-	    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-        std::cout << "---- Flow " << i->first  << " (" << t.sourceAddress << " -> " << t.destinationAddress << ") ---- \n";
-        std::cout << "  Tx Bytes:   " << i->second.txBytes << "\n";
-        std::cout << "  Rx Bytes:   " << i->second.rxBytes << "\n";
-        std::cout << " Lost packets: " << i->second.lostPackets << "\n";
-        std::cout << "  Throughput: " << i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds())/1024/1024  << " Mbps\n";
-        std::cout << " Delay: " << i->second.delaySum << "\n";
-        avgThroughput += i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds())/1024/1024 ;
+        Time timeFirstTxPacket = NanoSeconds (i->timeFirstTxPacket);
+        Time timeLastRxPacket = NanoSeconds (i->timeLastRxPacket);
+        std::cout << "---- Flow " << i->flowId  << " (" << Ipv4Address (i->key.sourceAddress) << " -> " << Ipv4Address (i->key.destinationAddress) << ") ---- \n";
+        std::cout << "  Tx Bytes:   " << i->txBytes << "\n";
+        std::cout << "  Rx Bytes:   " << i->rxBytes << "\n";
+        std::cout << " Lost packets: " << i->GetLostPackets (now, maxPerHopDelay) << "\n";
+        std::cout << "  Throughput: " << i->rxBytes * 8.0 / (timeLastRxPacket.GetSeconds() - timeFirstTxPacket.GetSeconds())/1024/1024  << " Mbps\n";
+        std::cout << " Delay: " << NanoSeconds (i->delaySum) << "\n";
+        avgThroughput += i->rxBytes * 8.0 / (timeLastRxPacket.GetSeconds() - timeFirstTxPacket.GetSeconds())/1024/1024 ;
         totalflows++;
 
-        lostPackets += i->second.lostPackets;
+        lostPackets += i->GetLostPackets (now, maxPerHopDelay);
     }
 
     std::cout << "------- Summary -----" << "\n";